@@ -0,0 +1,9 @@
+// Per-frame values shared by every shader program, uploaded once per
+// frame by MyGL. ShaderProgram::create inserts this block after the
+// #version line of every shader. Must match FrameData in shaderprogram.h.
+layout(std140) uniform FrameData {
+    mat4 u_ViewProj;    // The matrix that defines the camera's transformation
+    mat4 u_InvViewProj; // Its inverse, used to cast rays from the screen
+    vec3 u_Eye;         // Camera pos
+    int u_Time;         // Frame counter, used to animate LAVA and WATER and the sky
+};
@@ -13,12 +13,8 @@
 
 uniform sampler2D u_Texture; // An addition to lambert.frag.glsl that makes use of a sampler2D to apply texture colors to a surface.
 
-uniform int u_Time; // An alteration to lambert.frag.glsl so that it includes a time variable as in Homework 5's OpenGL Fun,
-                    // and uses this variable to animate the UVs on a LAVA block and WATER block.
-
 uniform ivec2 u_Dimensions; // Screen dimensions
-
-uniform vec3 u_Eye; // Camera pos
+uniform float u_FogDistance; // Where the distance fog is opaque, past the render distance
 
 // These are the interpolated values out of the rasterizer, so you can't know
 // their specific values without knowing the vertices that contributed to them
@@ -153,7 +149,7 @@ void main()
 
     // Distance fog feature
     vec3 toEye = fs_Pos.xyz - u_Eye;
-    float fog = smoothstep(0.9, 1.f, min(1.f, length(toEye.xz / 192.f)));
+    float fog = smoothstep(0.9, 1.f, min(1.f, length(toEye.xz / u_FogDistance)));
     vec2 screenSpaceUVs = gl_FragCoord.xy / vec2(u_Dimensions);
     vec4 textureColor = vec4(texture(u_Texture, screenSpaceUVs).rgb, 1.f);
     diffuseColor = mix(diffuseColor, textureColor, fog);
@@ -0,0 +1,18 @@
+#version 400
+
+// Lambertian shading of a mob's flat color, with the same light
+// direction as the terrain
+
+in vec4 fs_Col;
+in vec4 fs_Nor;
+
+out vec4 out_Col;
+
+const vec3 lightDir = normalize(vec3(0.5, 1, 0.75));
+
+void main()
+{
+    float diffuse = clamp(dot(normalize(fs_Nor.xyz), lightDir), 0, 1);
+    float ambient = 0.5;
+    out_Col = vec4(fs_Col.rgb * min(diffuse + ambient, 1), 1);
+}
@@ -0,0 +1,21 @@
+#version 400
+
+// Draws every mob as one instance of a unit cube, see MobSystem
+
+in vec4 vs_Pos;             // Corner of the unit cube
+in vec4 vs_Nor;
+in vec3 vs_ColInstanced;    // The mob's color
+in vec3 vs_OffsetInstanced; // The bottom corner of the mob's box
+
+out vec4 fs_Col;
+out vec4 fs_Nor;
+
+// Must match MobSystem::SIZE
+const float MOB_SIZE = 0.8;
+
+void main()
+{
+    fs_Col = vec4(vs_ColInstanced, 1);
+    fs_Nor = vs_Nor;
+    gl_Position = u_ViewProj * vec4(vs_Pos.xyz * MOB_SIZE + vs_OffsetInstanced, 1);
+}
@@ -3,19 +3,23 @@
 
 // Refer to the lambert shader files for useful comments
 
+// Every screen effect of PostChain in one shader. PostChain compiles it
+// once per combination of effects, defining the name of each active one
+// after the #version line.
+
 in vec2 fs_UV;
 out vec4 out_Col;
 uniform sampler2D u_Texture;
-uniform int u_Case;
 
 void main()
 {
     vec3 col = texture(u_Texture, fs_UV).rgb;
 
-    if (u_Case == 1) {
-        col += vec3(0, 0, 1);// in the water
-    } else if (u_Case == 2) {
-        col += vec3(1, 0, 0);// in the lava
-    }
+#ifdef UNDERWATER
+    col += vec3(0, 0, 1);// in the water
+#endif
+#ifdef LAVA
+    col += vec3(1, 0, 0);// in the lava
+#endif
     out_Col = vec4(col, 1);
 }
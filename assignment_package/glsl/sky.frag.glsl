@@ -1,15 +1,7 @@
 #version 150
 
-uniform mat4 u_ViewProj;    // We're actually passing the inverse of the viewproj
-                            // from our CPU, but it's named u_ViewProj so we don't
-                            // have to bother rewriting our ShaderProgram class
-
 uniform ivec2 u_Dimensions; // Screen dimensions
 
-uniform vec3 u_Eye; // Camera pos
-
-uniform float u_Time;
-
 out vec3 outColor;
 
 const float PI = 3.14159265359;
@@ -358,7 +350,7 @@ void main()
     // transform to unhomogenized screen space
     p *= 1000.0; // Times far clip plane value (far clip plane distance)
     // transform to world space
-    p = /*Inverse of*/ u_ViewProj * p; // Convert from unhomogenized screen to world
+    p = u_InvViewProj * p; // Convert from unhomogenized screen to world
 
     // rayDir is a unit vector pointing from eye to fragCoord (in world space)
     vec3 rayDir = normalize(p.xyz - u_Eye);
@@ -0,0 +1,23 @@
+#version 150
+
+// Draws the quarter-resolution sky rendered by sky.frag.glsl at full
+// resolution. The texture may have been rendered a few frames ago from
+// a slightly different view, so every pixel looks up where its ray
+// direction landed in that view instead of using its own screen position.
+
+uniform ivec2 u_Dimensions;  // Screen dimensions, in pixels
+uniform mat4 u_SkyViewProj;  // View-projection the sky texture was rendered with, eye at the origin
+uniform sampler2D u_Texture; // The sky texture
+
+out vec4 outColor;
+
+void main()
+{
+    vec2 ndc = (gl_FragCoord.xy / vec2(u_Dimensions)) * 2.0 - 1.0;
+    vec4 p = u_InvViewProj * vec4(ndc, 1, 1); // Pixel at the far clip plane
+    vec3 rayDir = normalize(p.xyz / p.w - u_Eye);
+
+    vec4 skyPos = u_SkyViewProj * vec4(rayDir, 1);
+    vec2 uv = (skyPos.xy / skyPos.w) * 0.5 + 0.5;
+    outColor = vec4(texture(u_Texture, uv).rgb, 1);
+}
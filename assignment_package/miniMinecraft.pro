@@ -1,4 +1,4 @@
-QT += core widgets openglwidgets multimedia
+QT += core widgets opengl openglwidgets multimedia
 
 TARGET = MiniMinecraft
 TEMPLATE = app
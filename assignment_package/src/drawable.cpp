@@ -4,7 +4,7 @@
 Drawable::Drawable(OpenGLContext* context)
     : m_count(-1), m_bufIdx(), m_bufPos(), m_bufNor(), m_bufCol(),m_bufuv(),
       m_idxGenerated(false), m_posGenerated(false), m_norGenerated(false), m_colGenerated(false),
-      mp_context(context)
+      m_uvGenerated(false), mp_context(context)
 {}
 
 Drawable::~Drawable()
@@ -13,11 +13,12 @@ Drawable::~Drawable()
 
 void Drawable::destroyVBOdata()
 {
-    mp_context->glDeleteBuffers(1, &m_bufIdx);
-    mp_context->glDeleteBuffers(1, &m_bufPos);
-    mp_context->glDeleteBuffers(1, &m_bufNor);
-    mp_context->glDeleteBuffers(1, &m_bufCol);
-    m_idxGenerated = m_posGenerated = m_norGenerated = m_colGenerated = false;
+    if (m_idxGenerated) mp_context->glDeleteBuffers(1, &m_bufIdx);
+    if (m_posGenerated) mp_context->glDeleteBuffers(1, &m_bufPos);
+    if (m_norGenerated) mp_context->glDeleteBuffers(1, &m_bufNor);
+    if (m_colGenerated) mp_context->glDeleteBuffers(1, &m_bufCol);
+    if (m_uvGenerated) mp_context->glDeleteBuffers(1, &m_bufuv);
+    m_idxGenerated = m_posGenerated = m_norGenerated = m_colGenerated = m_uvGenerated = false;
     m_count = -1;
 }
 
@@ -39,6 +40,11 @@ int Drawable::elemCount()
 
 void Drawable::generateIdx()
 {
+    // Calling createVBOdata again reuses the existing VBO
+    // instead of leaking it
+    if (m_idxGenerated) {
+        return;
+    }
     m_idxGenerated = true;
     // Create a VBO on our GPU and store its handle in bufIdx
     mp_context->glGenBuffers(1, &m_bufIdx);
@@ -46,6 +52,9 @@ void Drawable::generateIdx()
 
 void Drawable::generatePos()
 {
+    if (m_posGenerated) {
+        return;
+    }
     m_posGenerated = true;
     // Create a VBO on our GPU and store its handle in bufPos
     mp_context->glGenBuffers(1, &m_bufPos);
@@ -53,6 +62,9 @@ void Drawable::generatePos()
 
 void Drawable::generateNor()
 {
+    if (m_norGenerated) {
+        return;
+    }
     m_norGenerated = true;
     // Create a VBO on our GPU and store its handle in bufNor
     mp_context->glGenBuffers(1, &m_bufNor);
@@ -60,6 +72,9 @@ void Drawable::generateNor()
 
 void Drawable::generateCol()
 {
+    if (m_colGenerated) {
+        return;
+    }
     m_colGenerated = true;
     // Create a VBO on our GPU and store its handle in bufCol
     mp_context->glGenBuffers(1, &m_bufCol);
@@ -67,6 +82,9 @@ void Drawable::generateCol()
 
 void Drawable::generateUV()
 {
+    if (m_uvGenerated) {
+        return;
+    }
     m_uvGenerated = true;
     mp_context->glGenBuffers(1, &m_bufuv);
 }
@@ -123,6 +141,9 @@ int InstancedDrawable::instanceCount() const {
 }
 
 void InstancedDrawable::generateOffsetBuf() {
+    if (m_offsetGenerated) {
+        return;
+    }
     m_offsetGenerated = true;
     mp_context->glGenBuffers(1, &m_bufPosOffset);
 }
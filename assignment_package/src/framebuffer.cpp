@@ -5,7 +5,8 @@ FrameBuffer::FrameBuffer(OpenGLContext *context,
                          unsigned int width, unsigned int height, unsigned int devicePixelRatio)
     : mp_context(context), m_frameBuffer(-1),
       m_outputTexture(-1), m_depthRenderBuffer(-1),
-      m_width(width), m_height(height), m_devicePixelRatio(devicePixelRatio), m_created(false)
+      m_width(width), m_height(height), m_devicePixelRatio(devicePixelRatio), m_created(false),
+      m_textureSlot(0), m_filter(GL_NEAREST)
 {}
 
 void FrameBuffer::resize(unsigned int width, unsigned int height, unsigned int devicePixelRatio) {
@@ -14,6 +15,10 @@ void FrameBuffer::resize(unsigned int width, unsigned int height, unsigned int d
     m_devicePixelRatio = devicePixelRatio;
 }
 
+void FrameBuffer::setFilter(GLenum filter) {
+    m_filter = filter;
+}
+
 void FrameBuffer::create() {
     // Initialize the frame buffers and render textures
     mp_context->glGenFramebuffers(1, &m_frameBuffer);
@@ -27,9 +32,9 @@ void FrameBuffer::create() {
     mp_context->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width * m_devicePixelRatio, m_height * m_devicePixelRatio, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
 
     // Set the render settings for the texture we've just created.
-    // Essentially zero filtering on the "texture" so it appears exactly as rendered
-    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    // By default, zero filtering on the "texture" so it appears exactly as rendered
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, m_filter);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_filter);
     // Clamp the colors at the edge of our texture
     mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
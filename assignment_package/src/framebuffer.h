@@ -23,12 +23,17 @@ private:
     bool m_created;
 
     unsigned int m_textureSlot;
+    // GL_NEAREST or GL_LINEAR, for both minification and magnification
+    GLenum m_filter;
 
 public:
     FrameBuffer(OpenGLContext *context, unsigned int width, unsigned int height, unsigned int devicePixelRatio);
     // Make sure to call resize from MyGL::resizeGL to keep your frame buffer up to date with
     // your screen dimensions
     void resize(unsigned int width, unsigned int height, unsigned int devicePixelRatio);
+    // How the output texture is filtered when read at another resolution.
+    // Takes effect at the next create().
+    void setFilter(GLenum filter);
     // Initialize all GPU-side data required
     void create();
     // Deallocate all GPU-side data
@@ -0,0 +1,60 @@
+#include "framegraph.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <algorithm>
+
+// Top of the graph, in milliseconds
+static const float GRAPH_MAX_MS = 50.f;
+
+FrameGraph::FrameGraph(QWidget *parent)
+    : QWidget(parent), m_frameMs(), m_gpuMs()
+{}
+
+void FrameGraph::setTimes(const QList<float> &frameMs, const QList<float> &gpuMs) {
+    m_frameMs = frameMs;
+    m_gpuMs = gpuMs;
+    update();
+}
+
+void FrameGraph::paintEvent(QPaintEvent *e) {
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+    float w = width(), h = height();
+    auto toY = [h](float ms) {
+        return h - h * std::min(ms, GRAPH_MAX_MS) / GRAPH_MAX_MS;
+    };
+
+    // 60 and 30 FPS budgets
+    painter.setPen(QPen(Qt::darkGreen, 1, Qt::DashLine));
+    painter.drawLine(QPointF(0, toY(1000.f / 60.f)), QPointF(w, toY(1000.f / 60.f)));
+    painter.setPen(QPen(Qt::darkRed, 1, Qt::DashLine));
+    painter.drawLine(QPointF(0, toY(1000.f / 30.f)), QPointF(w, toY(1000.f / 30.f)));
+
+    // Newest frame on the right
+    auto drawTimes = [&](const QList<float> &times, const QColor &color) {
+        QPainterPath path;
+        bool drawing = false;
+        float step = times.size() > 1 ? w / (times.size() - 1) : w;
+        for (int i = 0; i < times.size(); i++) {
+            if (times[i] < 0.f) {
+                drawing = false;
+                continue;
+            }
+            QPointF p(i * step, toY(times[i]));
+            if (drawing) {
+                path.lineTo(p);
+            } else {
+                path.moveTo(p);
+                drawing = true;
+            }
+        }
+        painter.setPen(QPen(color, 1));
+        painter.drawPath(path);
+    };
+    drawTimes(m_frameMs, Qt::white);
+    drawTimes(m_gpuMs, Qt::cyan);
+
+    painter.setPen(Qt::gray);
+    painter.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignTop | Qt::AlignRight,
+                     QString("frame / gpu ms, top = %1").arg(GRAPH_MAX_MS));
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <QWidget>
+#include <QList>
+
+// Rolling graph of the last frames' frame and GPU times in the
+// PlayerInfo window, with lines at the 60 and 30 FPS budgets
+class FrameGraph : public QWidget {
+    Q_OBJECT
+private:
+    QList<float> m_frameMs, m_gpuMs;
+
+protected:
+    void paintEvent(QPaintEvent *e) override;
+
+public:
+    explicit FrameGraph(QWidget *parent = nullptr);
+
+    // Both oldest first. GPU times below zero are unknown and not drawn.
+    void setTimes(const QList<float> &frameMs, const QList<float> &gpuMs);
+};
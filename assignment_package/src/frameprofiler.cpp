@@ -0,0 +1,271 @@
+#include "frameprofiler.h"
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+// Not part of the OpenGL ES headers QOpenGLExtraFunctions is modeled on,
+// but core since OpenGL 3.3
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+static bool isGPUStage(int stage) {
+    return stage > PROFILE_PAINT && stage < PROFILE_STAGE_COUNT;
+}
+
+static bool isTopLevelStage(int stage) {
+    return stage <= PROFILE_PAINT;
+}
+
+const char* profileStageName(ProfileStage stage) {
+    switch (stage) {
+    case PROFILE_SIMULATION:        return "simulation";
+    case PROFILE_TERRAIN_STREAMING: return "terrain streaming";
+    case PROFILE_TRANSPARENT_SORT:  return "transparent sort";
+    case PROFILE_PAINT:             return "paint";
+    case PROFILE_TERRAIN_DRAW:      return "terrain draw";
+    case PROFILE_MOB_DRAW:          return "mob draw";
+    case PROFILE_SKY:               return "sky";
+    case PROFILE_TRANSPARENT_DRAW:  return "transparent draw";
+    case PROFILE_POST:              return "post";
+    default:                        return "unknown";
+    }
+}
+
+float percentile(std::vector<float> samples, float fraction) {
+    if (samples.empty()) {
+        return 0.f;
+    }
+    // Nearest rank
+    size_t rank = size_t(std::ceil(std::min(std::max(fraction, 0.f), 1.f) * samples.size()));
+    size_t i = rank > 0 ? rank - 1 : 0;
+    std::nth_element(samples.begin(), samples.begin() + i, samples.end());
+    return samples[i];
+}
+
+ProfileSample::ProfileSample()
+    : frame(-1), frameMs(0.f), cpuMs{}, gpuMs{}
+{
+    gpuMs.fill(-1.f);
+}
+
+float ProfileSample::cpuTotal() const {
+    float total = 0.f;
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        if (isTopLevelStage(i)) {
+            total += cpuMs[i];
+        }
+    }
+    return total;
+}
+
+float ProfileSample::gpuTotal() const {
+    float total = -1.f;
+    for (float ms : gpuMs) {
+        if (ms >= 0.f) {
+            total = std::max(total, 0.f) + ms;
+        }
+    }
+    return total;
+}
+
+FrameProfiler::FrameProfiler(OpenGLContext *context)
+    : mp_context(context), m_clock(), m_samples(), m_frame(-1), m_frameStart(0),
+      m_cpuStart{}, m_queries{}, m_queryPending{}, m_queryFrame{}, m_queriesCreated(false), m_gpuStage(-1)
+{
+    m_clock.start();
+}
+
+void FrameProfiler::create() {
+    if (m_queriesCreated) {
+        return;
+    }
+    for (auto &queries : m_queries) {
+        mp_context->glGenQueries(PROFILE_STAGE_COUNT, queries.data());
+    }
+    for (auto &pending : m_queryPending) {
+        pending.fill(false);
+    }
+    m_queriesCreated = true;
+}
+
+void FrameProfiler::destroy() {
+    if (!m_queriesCreated) {
+        return;
+    }
+    for (auto &queries : m_queries) {
+        mp_context->glDeleteQueries(PROFILE_STAGE_COUNT, queries.data());
+    }
+    m_queriesCreated = false;
+}
+
+ProfileSample& FrameProfiler::current() {
+    return m_samples[std::max(m_frame, qint64(0)) % HISTORY];
+}
+
+void FrameProfiler::collect(int slot) {
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        if (!m_queryPending[slot][i]) {
+            continue;
+        }
+        GLuint available = GL_FALSE;
+        mp_context->glGetQueryObjectuiv(m_queries[slot][i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            continue;
+        }
+        GLuint ns = 0;
+        mp_context->glGetQueryObjectuiv(m_queries[slot][i], GL_QUERY_RESULT, &ns);
+        m_queryPending[slot][i] = false;
+        // The frame may have dropped out of the history by now
+        qint64 frame = m_queryFrame[slot][i];
+        ProfileSample &sample = m_samples[frame % HISTORY];
+        if (sample.frame == frame) {
+            sample.gpuMs[i] = ns * 1e-6f;
+        }
+    }
+}
+
+void FrameProfiler::beginFrame() {
+    qint64 now = m_clock.nsecsElapsed();
+    m_frame++;
+    ProfileSample &sample = current();
+    sample = ProfileSample();
+    sample.frame = m_frame;
+    sample.frameMs = m_frame == 0 ? 0.f : (now - m_frameStart) * 1e-6f;
+    m_frameStart = now;
+    collectGPUTimes();
+}
+
+void FrameProfiler::collectGPUTimes() {
+    if (!m_queriesCreated) {
+        return;
+    }
+    // Results of older frames in every slot have had the most time to arrive
+    for (int slot = 0; slot < QUERY_FRAMES; slot++) {
+        collect(slot);
+    }
+}
+
+void FrameProfiler::beginCPU(ProfileStage stage) {
+    m_cpuStart[stage] = m_clock.nsecsElapsed();
+}
+
+void FrameProfiler::endCPU(ProfileStage stage) {
+    // Stages that run more than once a frame add up
+    current().cpuMs[stage] += (m_clock.nsecsElapsed() - m_cpuStart[stage]) * 1e-6f;
+}
+
+void FrameProfiler::beginGPU(ProfileStage stage) {
+    int slot = std::max(m_frame, qint64(0)) % QUERY_FRAMES;
+    // Reusing a query that hasn't finished would make GL wait for it
+    if (!m_queriesCreated || !isGPUStage(stage) || m_gpuStage >= 0 || m_queryPending[slot][stage]) {
+        return;
+    }
+    mp_context->glBeginQuery(GL_TIME_ELAPSED, m_queries[slot][stage]);
+    m_queryPending[slot][stage] = true;
+    m_queryFrame[slot][stage] = m_frame;
+    m_gpuStage = stage;
+}
+
+void FrameProfiler::endGPU(ProfileStage stage) {
+    if (m_gpuStage != stage) {
+        return;
+    }
+    mp_context->glEndQuery(GL_TIME_ELAPSED);
+    m_gpuStage = -1;
+}
+
+std::vector<ProfileSample> FrameProfiler::history() const {
+    std::vector<ProfileSample> samples;
+    qint64 first = std::max(m_frame - HISTORY + 1, qint64(0));
+    for (qint64 f = first; f <= m_frame; f++) {
+        samples.push_back(m_samples[f % HISTORY]);
+    }
+    return samples;
+}
+
+const ProfileSample& FrameProfiler::latest() const {
+    return m_samples[std::max(m_frame, qint64(0)) % HISTORY];
+}
+
+ProfileSample FrameProfiler::average(int frames) const {
+    ProfileSample mean;
+    std::array<int, PROFILE_STAGE_COUNT> gpuCounts{};
+    int count = 0;
+    for (qint64 f = m_frame; f >= 0 && f > m_frame - std::min(frames, HISTORY); f--) {
+        const ProfileSample &sample = m_samples[f % HISTORY];
+        mean.frameMs += sample.frameMs;
+        for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+            mean.cpuMs[i] += sample.cpuMs[i];
+            if (sample.gpuMs[i] >= 0.f) {
+                mean.gpuMs[i] = std::max(mean.gpuMs[i], 0.f) + sample.gpuMs[i];
+                gpuCounts[i]++;
+            }
+        }
+        count++;
+    }
+    if (count == 0) {
+        return mean;
+    }
+    mean.frame = m_frame;
+    mean.frameMs /= count;
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        mean.cpuMs[i] /= count;
+        if (gpuCounts[i] > 0) {
+            mean.gpuMs[i] /= gpuCounts[i];
+        }
+    }
+    return mean;
+}
+
+bool FrameProfiler::writeCSV(const QString &path) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    out << "frame,frame_ms";
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        out << "," << QString(profileStageName(ProfileStage(i))).replace(' ', '_') << "_cpu_ms";
+    }
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        if (isGPUStage(i)) {
+            out << "," << QString(profileStageName(ProfileStage(i))).replace(' ', '_') << "_gpu_ms";
+        }
+    }
+    out << "\n";
+    for (const ProfileSample &sample : history()) {
+        out << sample.frame << "," << sample.frameMs;
+        for (float ms : sample.cpuMs) {
+            out << "," << ms;
+        }
+        // Left empty if the result never arrived
+        for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+            if (isGPUStage(i)) {
+                out << ",";
+                if (sample.gpuMs[i] >= 0.f) {
+                    out << sample.gpuMs[i];
+                }
+            }
+        }
+        out << "\n";
+    }
+    return true;
+}
+
+ProfileScope::ProfileScope(FrameProfiler &profiler, ProfileStage stage, bool gpu)
+    : mr_profiler(profiler), m_stage(stage), m_gpu(gpu)
+{
+    mr_profiler.beginCPU(m_stage);
+    if (m_gpu) {
+        mr_profiler.beginGPU(m_stage);
+    }
+}
+
+ProfileScope::~ProfileScope() {
+    if (m_gpu) {
+        mr_profiler.endGPU(m_stage);
+    }
+    mr_profiler.endCPU(m_stage);
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "openglcontext.h"
+#include <QElapsedTimer>
+#include <QString>
+#include <array>
+#include <vector>
+
+// The parts of a frame the profiler times. The stages after PROFILE_PAINT
+// happen inside it and are the ones also timed on the GPU.
+enum ProfileStage : unsigned char {
+    PROFILE_SIMULATION,        // Fixed simulation steps in MyGL::tick
+    PROFILE_TERRAIN_STREAMING, // Terrain::multithreadedWork, including mesh uploads
+    PROFILE_TRANSPARENT_SORT,  // Terrain::sortTransparentFaces
+    PROFILE_PAINT,             // All of MyGL::paintGL
+    PROFILE_TERRAIN_DRAW,      // Opaque terrain
+    PROFILE_MOB_DRAW,
+    PROFILE_SKY,
+    PROFILE_TRANSPARENT_DRAW,  // Transparent terrain, drawn over the sky
+    PROFILE_POST,
+    PROFILE_STAGE_COUNT
+};
+
+const char* profileStageName(ProfileStage stage);
+
+// The smallest sample that at least fraction of the samples are less than
+// or equal to, or 0 if there are none
+float percentile(std::vector<float> samples, float fraction);
+
+// Timings of one frame in milliseconds. GPU times are -1 until the
+// timer query results have come back, and for stages that aren't
+// timed on the GPU.
+struct ProfileSample {
+    qint64 frame;
+    float frameMs; // Time since the previous frame began
+    std::array<float, PROFILE_STAGE_COUNT> cpuMs;
+    std::array<float, PROFILE_STAGE_COUNT> gpuMs;
+
+    ProfileSample();
+    // CPU time of the top level stages
+    float cpuTotal() const;
+    // GPU time of every stage whose result is known, -1 if none is
+    float gpuTotal() const;
+};
+
+// Per-stage CPU timers and GL_TIME_ELAPSED queries kept for the last
+// HISTORY frames. Each frame's queries are only read QUERY_FRAMES frames
+// later, once GL reports them available, so the profiler never waits on
+// the GPU. A stage whose previous query is still pending is not timed
+// on the GPU that frame.
+class FrameProfiler {
+public:
+    static constexpr int HISTORY = 240;
+    static constexpr int QUERY_FRAMES = 3;
+
+private:
+    OpenGLContext *mp_context;
+    QElapsedTimer m_clock;
+    std::array<ProfileSample, HISTORY> m_samples;
+    qint64 m_frame;
+    qint64 m_frameStart;
+    std::array<qint64, PROFILE_STAGE_COUNT> m_cpuStart;
+
+    // One query per GPU stage for each of the last QUERY_FRAMES frames
+    std::array<std::array<GLuint, PROFILE_STAGE_COUNT>, QUERY_FRAMES> m_queries;
+    std::array<std::array<bool, PROFILE_STAGE_COUNT>, QUERY_FRAMES> m_queryPending;
+    // The frame each query was issued in
+    std::array<std::array<qint64, PROFILE_STAGE_COUNT>, QUERY_FRAMES> m_queryFrame;
+    bool m_queriesCreated;
+    // The stage whose query is running, -1 if none is
+    int m_gpuStage;
+
+    ProfileSample& current();
+    // Reads back every finished query of the given slot
+    void collect(int slot);
+
+public:
+    FrameProfiler(OpenGLContext *context);
+
+    // Generates the timer queries. Needs a current GL context.
+    void create();
+    void destroy();
+
+    // Starts a new frame and collects the GPU times that have arrived
+    void beginFrame();
+    // Collects the GPU times that have arrived without starting a frame.
+    // After glFinish() that is all of them.
+    void collectGPUTimes();
+
+    void beginCPU(ProfileStage stage);
+    void endCPU(ProfileStage stage);
+    // Only one GPU stage can be timed at a time, they can't nest
+    void beginGPU(ProfileStage stage);
+    void endGPU(ProfileStage stage);
+
+    // The most recent frames, oldest first. Only frames that happened
+    // are included, so there are fewer than HISTORY early on.
+    std::vector<ProfileSample> history() const;
+    // The current frame, or the last one if none has begun since
+    const ProfileSample& latest() const;
+    // Mean of the last frames, using only the known GPU times
+    ProfileSample average(int frames) const;
+
+    // Writes history() with one row per frame and one column per
+    // stage. Returns false if the file can't be written.
+    bool writeCSV(const QString &path) const;
+};
+
+// Times the enclosing block as stage on the CPU and, if gpu is set,
+// on the GPU
+class ProfileScope {
+private:
+    FrameProfiler &mr_profiler;
+    ProfileStage m_stage;
+    bool m_gpu;
+
+public:
+    ProfileScope(FrameProfiler &profiler, ProfileStage stage, bool gpu = false);
+    ~ProfileScope();
+};
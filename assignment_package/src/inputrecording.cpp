@@ -0,0 +1,130 @@
+#include "inputrecording.h"
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <cstring>
+#include <iterator>
+
+namespace {
+// The order of the flags in the file. Append new ones at the end.
+bool InputBundle::* const FLAGS[] = {
+    &InputBundle::wPressed, &InputBundle::aPressed, &InputBundle::sPressed,
+    &InputBundle::dPressed, &InputBundle::qPressed, &InputBundle::ePressed,
+    &InputBundle::spacePressed, &InputBundle::focused,
+    &InputBundle::flightToggled, &InputBundle::leftClicked, &InputBundle::rightClicked
+};
+
+quint16 inputFlags(const InputBundle &input) {
+    quint16 flags = 0;
+    for (size_t i = 0; i < std::size(FLAGS); i++) {
+        if (input.*FLAGS[i]) {
+            flags |= 1 << i;
+        }
+    }
+    return flags;
+}
+
+void setInputFlags(InputBundle *input, quint16 flags) {
+    for (size_t i = 0; i < std::size(FLAGS); i++) {
+        input->*FLAGS[i] = (flags >> i) & 1;
+    }
+}
+}
+
+InputRecording::InputRecording()
+    : m_seed(0), m_mobCount(0), m_endPosition(0.f), m_steps()
+{}
+
+void InputRecording::reset(unsigned int seed, int mobCount) {
+    m_seed = seed;
+    m_mobCount = mobCount;
+    m_endPosition = glm::vec3(0.f);
+    m_steps.clear();
+}
+
+void InputRecording::append(float dT, const InputBundle &input) {
+    m_steps.push_back({dT, input});
+}
+
+void InputRecording::setEndPosition(glm::vec3 pos) {
+    m_endPosition = pos;
+}
+
+unsigned int InputRecording::getSeed() const {
+    return m_seed;
+}
+
+int InputRecording::getMobCount() const {
+    return m_mobCount;
+}
+
+glm::vec3 InputRecording::getEndPosition() const {
+    return m_endPosition;
+}
+
+int InputRecording::size() const {
+    return static_cast<int>(m_steps.size());
+}
+
+const InputRecording::Step& InputRecording::getStep(int i) const {
+    return m_steps[i];
+}
+
+bool InputRecording::save(const QString &path) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream out(&file);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    out.writeRawData(INPUT_FILE_MAGIC, 4);
+    out << quint32(INPUT_FILE_VERSION) << quint32(m_seed) << quint32(m_mobCount)
+        << m_endPosition.x << m_endPosition.y << m_endPosition.z << quint32(m_steps.size());
+    for (const Step &step : m_steps) {
+        // Mouse movement is a whole number of pixels
+        out << step.dT << inputFlags(step.input)
+            << qint16(glm::clamp(step.input.mouseX, -32768.f, 32767.f))
+            << qint16(glm::clamp(step.input.mouseY, -32768.f, 32767.f));
+    }
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+bool InputRecording::load(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    char magic[4];
+    quint32 version, seed, mobCount, count;
+    glm::vec3 endPosition;
+    in.readRawData(magic, 4);
+    in >> version >> seed >> mobCount >> endPosition.x >> endPosition.y >> endPosition.z >> count;
+    if (in.status() != QDataStream::Ok || std::memcmp(magic, INPUT_FILE_MAGIC, 4) != 0 ||
+            version != INPUT_FILE_VERSION) {
+        return false;
+    }
+
+    // Decode everything first so a corrupt file leaves the recording untouched
+    std::vector<Step> steps;
+    steps.reserve(glm::min(count, 1u << 20));
+    for (quint32 i = 0; i < count; i++) {
+        Step step;
+        quint16 flags;
+        qint16 mouseX, mouseY;
+        in >> step.dT >> flags >> mouseX >> mouseY;
+        if (in.status() != QDataStream::Ok) {
+            return false;
+        }
+        setInputFlags(&step.input, flags);
+        step.input.mouseX = mouseX;
+        step.input.mouseY = mouseY;
+        steps.push_back(step);
+    }
+    m_seed = seed;
+    m_mobCount = static_cast<int>(mobCount);
+    m_endPosition = endPosition;
+    m_steps = std::move(steps);
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "scene/entity.h"
+#include <QString>
+#include <vector>
+
+// Magic number and version at the start of every input recording.
+// Bump INPUT_FILE_VERSION whenever the layout below changes.
+#define INPUT_FILE_MAGIC "MMIR"
+#define INPUT_FILE_VERSION 1
+
+// The InputBundle of every simulation step of a session, so the same
+// flythrough can be replayed to compare builds. Replays start from the
+// same seed, mob count and Player position as the recording, and the
+// simulation only depends on these and the inputs, except for terrain
+// that takes longer to stream in on one run than on another.
+//
+// Input file layout (QDataStream, big-endian):
+//   char[4]  INPUT_FILE_MAGIC
+//   quint32  INPUT_FILE_VERSION
+//   quint32  world seed
+//   quint32  mob count
+//   float[3] Player position after the last step
+//   quint32  number of steps
+//   steps of
+//     float    dT in seconds
+//     quint16  InputBundle flags, see inputFlags() in the .cpp
+//     qint16   mouseX, mouseY
+class InputRecording {
+public:
+    struct Step {
+        float dT;
+        InputBundle input;
+    };
+
+private:
+    unsigned int m_seed;
+    int m_mobCount;
+    glm::vec3 m_endPosition;
+    std::vector<Step> m_steps;
+
+public:
+    InputRecording();
+
+    // Starts an empty recording of a world made with seed
+    void reset(unsigned int seed, int mobCount);
+    void append(float dT, const InputBundle &input);
+    // Remembers where the Player ended up, which replays are checked against
+    void setEndPosition(glm::vec3 pos);
+
+    unsigned int getSeed() const;
+    int getMobCount() const;
+    glm::vec3 getEndPosition() const;
+    int size() const;
+    const Step& getStep(int i) const;
+
+    // Return false if the file can't be written or isn't a valid recording
+    bool save(const QString &path) const;
+    bool load(const QString &path);
+};
@@ -1,8 +1,14 @@
 #include <mainwindow.h>
+#include "renderbenchmark.h"
+#include "scene/terrain.h"
+#include "scene/mobsystem.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QSurfaceFormat>
 #include <QDebug>
+#include <algorithm>
+#include <cstring>
 
 void debugFormatVersion()
 {
@@ -21,13 +27,65 @@ void debugFormatVersion()
 
 int main(int argc, char *argv[])
 {
+    // The benchmark never shows a window, so unless told otherwise
+    // it doesn't ask the window system for one
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--benchmark", 11) == 0 && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
     QApplication a(argc, argv);
 
+    // A world directory written by tools/pregen is streamed from disk
+    // instead of being generated while playing
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption worldOption("world", "Load pregenerated zones from <dir>.", "dir");
+    QCommandLineOption seedOption("seed", "World seed.", "seed", "0");
+    // Frames are paced by the display's refresh rate unless this is set
+    QCommandLineOption uncappedOption("uncapped", "Render as fast as possible instead of waiting for vsync.");
+    parser.addOption(worldOption);
+    parser.addOption(seedOption);
+    // Off by default; benchmarks and recordings pass it to load the mob simulation.
+    // Replays spawn as many mobs as their recording did.
+    QCommandLineOption mobsOption("mobs", "Number of mobs wandering around the player.", "n", "0");
+    // A recording replays the same flythrough on every run, to compare builds
+    QCommandLineOption recordOption("record", "Record the player's inputs to <file> until the window closes.", "file");
+    QCommandLineOption replayOption("replay", "Replay the inputs recorded in <file>, print frame times and quit.", "file");
+    parser.addOption(uncappedOption);
+    parser.addOption(mobsOption);
+    parser.addOption(recordOption);
+    parser.addOption(replayOption);
+    QCommandLineOption renderDistanceOption("render-distance", "Chunks around the player that are loaded and drawn.",
+                                            "chunks", QString::number(Terrain::DEFAULT_RENDER_DISTANCE));
+    QCommandLineOption simulationDistanceOption("simulation-distance", "Chunks around the player mobs are kept within.",
+                                                "chunks", QString::number(int(MobSystem::DEFAULT_SIMULATION_DISTANCE / 16)));
+    parser.addOption(renderDistanceOption);
+    parser.addOption(simulationDistanceOption);
+    // Renders offscreen along a fixed camera path to compare builds
+    QCommandLineOption benchmarkOption("benchmark", "Render <frames> frames offscreen along a camera path, print timings and quit.",
+                                       "frames");
+    QCommandLineOption benchmarkPathOption("benchmark-path", "Camera path: " + CameraSpline::builtInNames().join(", ") +
+                                           ", or a file of \"x y z\" control points.", "path", "orbit");
+    QCommandLineOption benchmarkSizeOption("benchmark-size", "Size of the benchmark's frames.", "WxH", "1280x720");
+    QCommandLineOption benchmarkSpeedOption("benchmark-speed", "Blocks per second the benchmark camera flies.",
+                                            "speed", QString::number(BenchmarkSettings().speed));
+    QCommandLineOption benchmarkCSVOption("benchmark-csv", "Write every benchmark frame's timings to <file>.", "file");
+    parser.addOption(benchmarkOption);
+    parser.addOption(benchmarkPathOption);
+    parser.addOption(benchmarkSizeOption);
+    parser.addOption(benchmarkSpeedOption);
+    parser.addOption(benchmarkCSVOption);
+    parser.process(a);
+
     // Set OpenGL 4.0 and, optionally, 4-sample multisampling
     QSurfaceFormat format;
     format.setVersion(4, 0);
     format.setOption(QSurfaceFormat::DeprecatedFunctions, false);
     format.setProfile(QSurfaceFormat::CoreProfile);
+    // The scene is drawn straight to the screen while no screen effect is active
+    format.setDepthBufferSize(24);
+    format.setSwapInterval(parser.isSet(uncappedOption) ? 0 : 1);
     //format.setSamples(4);  // Uncomment for nice antialiasing. Not always supported.
 
     /*** AUTOMATIC TESTING: DO NOT MODIFY ***/
@@ -37,7 +95,58 @@ int main(int argc, char *argv[])
     QSurfaceFormat::setDefaultFormat(format);
     debugFormatVersion();
 
+    if (parser.isSet(benchmarkOption)) {
+        BenchmarkSettings settings;
+        settings.frames = std::max(1, parser.value(benchmarkOption).toInt());
+        settings.speed = parser.value(benchmarkSpeedOption).toFloat();
+        settings.csvPath = parser.value(benchmarkCSVOption);
+        QStringList wh = parser.value(benchmarkSizeOption).split('x');
+        QSize size = wh.size() == 2 ? QSize(wh[0].toInt(), wh[1].toInt()) : QSize();
+        if (size.isEmpty()) {
+            fprintf(stderr, "--benchmark-size must look like 1280x720\n");
+            return 1;
+        }
+
+        RenderBenchmark benchmark;
+        QString error;
+        if (!benchmark.create(size, &error)) {
+            fprintf(stderr, "Benchmark: %s\n", qPrintable(error));
+            return 1;
+        }
+        MyGL &gl = benchmark.gl();
+        gl.setMobCount(std::max(0, parser.value(mobsOption).toInt()));
+        gl.setRenderDistance(parser.value(renderDistanceOption).toInt());
+        gl.setSimulationDistance(parser.value(simulationDistanceOption).toInt());
+        gl.setWorld(parser.value(worldOption), parser.value(seedOption).toUInt());
+        // Built in paths start around where the Player does
+        std::vector<glm::vec3> points;
+        QString path = parser.value(benchmarkPathOption);
+        if (!CameraSpline::builtIn(path, gl.getCameraPosition(), &points) &&
+            !CameraSpline::load(path, &points, &error)) {
+            fprintf(stderr, "Couldn't read the camera path %s: %s\n", qPrintable(path), qPrintable(error));
+            return 1;
+        }
+        if (!benchmark.run(CameraSpline(points), settings, &error)) {
+            fprintf(stderr, "Benchmark: %s\n", qPrintable(error));
+            return 1;
+        }
+        return 0;
+    }
+
     MainWindow w;
+    unsigned int seed = parser.value(seedOption).toUInt();
+    w.setMobCount(std::max(0, parser.value(mobsOption).toInt()));
+    w.setRenderDistance(parser.value(renderDistanceOption).toInt());
+    w.setSimulationDistance(parser.value(simulationDistanceOption).toInt());
+    if (parser.isSet(replayOption)) {
+        if (!w.replayInputs(parser.value(replayOption), &seed)) {
+            fprintf(stderr, "Couldn't read the input recording %s\n", qPrintable(parser.value(replayOption)));
+            return 1;
+        }
+    } else if (parser.isSet(recordOption)) {
+        w.recordInputs(parser.value(recordOption));
+    }
+    w.setWorld(parser.value(worldOption), seed);
     w.show();
 
     return a.exec();
@@ -2,6 +2,8 @@
 #include <ui_mainwindow.h>
 #include "cameracontrolshelp.h"
 #include <QResizeEvent>
+#include <QFileDialog>
+#include <QDebug>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -18,6 +20,11 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->mygl, SIGNAL(sig_sendPlayerLook(QString)), &playerInfoWindow, SLOT(slot_setLookText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerChunk(QString)), &playerInfoWindow, SLOT(slot_setChunkText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerTerrainZone(QString)), &playerInfoWindow, SLOT(slot_setZoneText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendChunksDrawn(QString)), &playerInfoWindow, SLOT(slot_setDrawnText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendGPUMemory(QString)), &playerInfoWindow, SLOT(slot_setGPUMemoryText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendFrameTime(QString)), &playerInfoWindow, SLOT(slot_setFrameTimeText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendFrameStages(QString)), &playerInfoWindow, SLOT(slot_setFrameStagesText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendFrameGraph(QList<float>,QList<float>)), &playerInfoWindow, SLOT(slot_setFrameGraph(QList<float>,QList<float>)));
 }
 
 MainWindow::~MainWindow()
@@ -25,11 +32,50 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+void MainWindow::setWorld(const QString &directory, unsigned int seed)
+{
+    ui->mygl->setWorld(directory, seed);
+}
+
+void MainWindow::setMobCount(int count)
+{
+    ui->mygl->setMobCount(count);
+}
+
+void MainWindow::setRenderDistance(int chunks)
+{
+    ui->mygl->setRenderDistance(chunks);
+}
+
+void MainWindow::setSimulationDistance(int chunks)
+{
+    ui->mygl->setSimulationDistance(chunks);
+}
+
+void MainWindow::recordInputs(const QString &path)
+{
+    ui->mygl->recordInputs(path);
+}
+
+bool MainWindow::replayInputs(const QString &path, unsigned int *seed)
+{
+    return ui->mygl->replayInputs(path, seed);
+}
+
 void MainWindow::on_actionQuit_triggered()
 {
     QApplication::exit();
 }
 
+void MainWindow::on_actionExport_Frame_Profile_triggered()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export frame profile"),
+                                                    "frame_profile.csv", tr("CSV files (*.csv)"));
+    if (!fileName.isEmpty() && !ui->mygl->exportFrameProfile(fileName)) {
+        qWarning() << "Could not write frame profile to" << fileName;
+    }
+}
+
 void MainWindow::on_actionCamera_Controls_triggered()
 {
     cHelp.show();
@@ -19,9 +19,22 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+    // See MyGL::setWorld
+    void setWorld(const QString &directory, unsigned int seed);
+    // See MyGL::setMobCount
+    void setMobCount(int count);
+    // See MyGL::setRenderDistance and MyGL::setSimulationDistance
+    void setRenderDistance(int chunks);
+    void setSimulationDistance(int chunks);
+    // See MyGL::recordInputs and MyGL::replayInputs
+    void recordInputs(const QString &path);
+    bool replayInputs(const QString &path, unsigned int *seed);
+
 private slots:
     void on_actionQuit_triggered();
 
+    void on_actionExport_Frame_Profile_triggered();
+
     void on_actionCamera_Controls_triggered();
 
 private:
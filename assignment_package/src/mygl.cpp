@@ -3,25 +3,35 @@
 
 #include <iostream>
 #include <QApplication>
+#include <QDebug>
 #include <QFileDialog>
 #include <QKeyEvent>
-#include <QDateTime>
+#include <algorithm>
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
       m_worldAxes(this),
-      m_progLambert(this), m_progFlat(this), m_progInstanced(this),m_progPost(this),
-      mp_progSky(new ShaderProgram(this)),
+      m_progLambert(this), m_progFlat(this), m_progInstanced(this), m_progMob(this),
+      mp_progSky(new ShaderProgram(this)), m_progSkyUpsample(this),
       m_terrain(this), m_player(glm::vec3(103.f, 170.f, -30.f), m_terrain),
-      m_renderedTexture(0), m_time(0),
-      m_prevFrameTime(QDateTime::currentMSecsSinceEpoch()),
+      m_mobs(m_terrain), m_mobTarget(0),
+      m_simulationDistance(int(MobSystem::DEFAULT_SIMULATION_DISTANCE / 16)), m_mobCube(this), m_mobOffsets(), m_mobColors(),
+      m_renderedTexture(0), m_frameDataUBO(0), m_time(0),
+      m_clock(), m_prevFrameTime(0), m_accumulator(0.f), m_interpolation(0.f),
       m_initialTerrainLoaded(false), m_quad(this),
-      m_frameBuffer(this, this->width(), this->height(), this->devicePixelRatio())
+      m_postChain(this, this->width(), this->height(), this->devicePixelRatio()),
+      m_skyBuffer(this, (this->width() + 1) / 2, (this->height() + 1) / 2, 1),
+      m_skySize((this->width() + 1) / 2, (this->height() + 1) / 2),
+      m_skyViewProj(), m_skyTime(0), m_skyValid(false),
+      m_profiler(this),
+      m_inputMode(INPUT_LIVE), m_recording(), m_recordingPath(), m_replayStep(0), m_replayFrameMs()
 {
-    // Connect the timer to a function so that when the timer ticks the function is executed
-    connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
-    // Tell the timer to redraw 60 times per second
-    m_timer.start(16);
+    // Every presented frame advances the simulation and asks for the next one
+    connect(this, SIGNAL(frameSwapped()), this, SLOT(tick()));
+    m_clock.start();
+    // The info window doesn't need to change any faster than it can be read
+    connect(&m_guiTimer, SIGNAL(timeout()), this, SLOT(sendPlayerDataToGUI()));
+    m_guiTimer.start(100);
     setFocusPolicy(Qt::ClickFocus);
 
     setMouseTracking(true); // MyGL will track the mouse's movements even if a mouse button is not pressed
@@ -29,12 +39,69 @@ MyGL::MyGL(QWidget *parent)
 }
 
 MyGL::~MyGL() {
+    if (m_inputMode == INPUT_RECORD) {
+        m_recording.setEndPosition(m_player.mcr_position);
+        if (m_recording.save(m_recordingPath)) {
+            std::cout << "Recorded " << m_recording.size() << " steps to " << m_recordingPath.toStdString() << std::endl;
+        } else {
+            std::cerr << "Couldn't write the input recording " << m_recordingPath.toStdString() << std::endl;
+        }
+    }
     makeCurrent();
     glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &m_frameDataUBO);
+    m_profiler.destroy();
     m_quad.destroyVBOdata();
-    m_frameBuffer.destroy();
+    m_mobCube.destroyVBOdata();
+    m_mobCube.clearOffsetBuf();
+    m_postChain.destroy();
+    m_skyBuffer.destroy();
+}
+
+
+void MyGL::setWorld(const QString &directory, unsigned int seed) {
+    m_terrain.setSeed(seed);
+    if (!directory.isEmpty()) {
+        m_terrain.setWorldDirectory(directory);
+    }
+}
+
+void MyGL::importHeightMap() {
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Open height map"), "/",
+                                                    tr("Height maps (*.png *.jpeg *.jpg *.tif *.tiff *.r16 *.raw *.r32 *.f32)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+    // Large height maps are written to disk zone by zone rather than held
+    // in memory, so they need somewhere to go
+    if (!m_terrain.hasWorldDirectory()) {
+        QString directory = QFileDialog::getExistingDirectory(this, tr("Choose a world directory to import into"));
+        if (directory.isEmpty()) {
+            return;
+        }
+        m_terrain.setWorldDirectory(directory);
+    }
+    QString error;
+    glm::ivec2 center(glm::floor(glm::vec2(m_player.mcr_position.x, m_player.mcr_position.z)));
+    if (!m_terrain.importHeightMap(fileName, center, &error)) {
+        qWarning() << "Couldn't import" << fileName << ":" << error;
+    }
 }
 
+void MyGL::setMobCount(int count) {
+    m_mobTarget = count;
+}
+
+void MyGL::setRenderDistance(int chunks) {
+    m_terrain.setRenderDistance(chunks);
+    // Keeps the simulation distance within the new render distance
+    setSimulationDistance(m_simulationDistance);
+}
+
+void MyGL::setSimulationDistance(int chunks) {
+    m_simulationDistance = std::max(1, chunks);
+    m_mobs.setSimulationDistance(16.f * std::min(m_simulationDistance, m_terrain.getRenderDistance()));
+}
 
 void MyGL::moveMouseToCenter() {
     QCursor::setPos(this->mapToGlobal(QPoint(width() / 2, height() / 2)));
@@ -66,15 +133,18 @@ void MyGL::initializeGL()
     //Create the instance of the world axes
     m_worldAxes.createVBOdata();
     m_quad.createVBOdata();
+    m_mobCube.createVBOdata();
+    m_terrain.createArena();
 
     // Create and set up the diffuse shader
     m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl");
     // Create and set up the flat lighting shader
     m_progFlat.create(":/glsl/flat.vert.glsl", ":/glsl/flat.frag.glsl");
     m_progInstanced.create(":/glsl/instanced.vert.glsl", ":/glsl/lambert.frag.glsl");
-    m_progPost.create(":/glsl/post.vert.glsl", ":/glsl/post.frag.glsl");
+    m_progMob.create(":/glsl/mob.vert.glsl", ":/glsl/mob.frag.glsl");
     // Sky
     mp_progSky->create(":/glsl/sky.vert.glsl", ":/glsl/sky.frag.glsl");
+    m_progSkyUpsample.create(":/glsl/sky.vert.glsl", ":/glsl/skyupsample.frag.glsl");
 
     // Set a color with which to draw geometry.
     // This will ultimately not be used when you change
@@ -98,58 +168,206 @@ void MyGL::initializeGL()
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img.width(), img.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, img.bits());
     m_progLambert.setSampler(0);
 
-    m_frameBuffer.create();
-    m_frameBuffer.bindFrameBuffer();
+    m_skyBuffer.setFilter(GL_LINEAR);
+    m_skyBuffer.create();
+    m_postChain.create();
+
+    // Uniform buffer holding the FrameData block shared by the shaders
+    glGenBuffers(1, &m_frameDataUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameDataUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, m_frameDataUBO);
+
+    m_profiler.create();
+}
+
+void MyGL::uploadFrameData(const Camera &camera) {
+    FrameData frame;
+    frame.viewProj = camera.getViewProj();
+    frame.invViewProj = glm::inverse(frame.viewProj);
+    frame.eye = camera.mcr_position;
+    frame.time = m_time++;
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameDataUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &frame);
 }
 
 void MyGL::resizeGL(int w, int h) {
     //This code sets the concatenated view and perspective projection matrices used for
     //our scene's camera view.
     m_player.setCameraWidthHeight(static_cast<unsigned int>(w), static_cast<unsigned int>(h));
-    glm::mat4 viewproj = m_player.mcr_camera.getViewProj();
 
-    // Upload the view-projection matrix to our shaders (i.e. onto the graphics card)
+    // The view-projection matrix reaches the shaders through
+    // the FrameData uniform buffer, see uploadFrameData
 
-    m_progLambert.setViewProjMatrix(viewproj);
-    m_progFlat.setViewProjMatrix(viewproj);
-    mp_progSky->setViewProjMatrix(glm::inverse(viewproj));
+    // The sky is shaded at half the width and height of the screen
+    glm::ivec2 screen(this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
+    m_skySize = (screen + 1) / 2;
+    m_skyBuffer.resize(m_skySize.x, m_skySize.y, 1);
+    m_skyBuffer.destroy();
+    m_skyBuffer.create();
+    m_skyValid = false;
 
     // Sky
     mp_progSky->useMe();
     // pass u_Dimensions
-    this->glUniform2i(mp_progSky->unifDimensions, width(), height());
-    this->glUniform3f(mp_progSky->unifEye, m_player.mcr_camera.mcr_position.x, m_player.mcr_camera.mcr_position.y, m_player.mcr_camera.mcr_position.z);
+    this->glUniform2i(mp_progSky->unifDimensions, m_skySize.x, m_skySize.y);
+    m_progSkyUpsample.useMe();
+    this->glUniform2i(m_progSkyUpsample.unifDimensions, screen.x, screen.y);
 
-    m_frameBuffer.resize(this->width(), this->height(),
-                         this->devicePixelRatio());
-    m_frameBuffer.destroy();
-    m_frameBuffer.create();
+    m_postChain.resize(this->width(), this->height(), this->devicePixelRatio());
     printGLErrorLog();
 }
 
 
-// MyGL's constructor links tick() to a timer that fires 60 times per second.
+// MyGL's constructor links tick() to QOpenGLWidget::frameSwapped.
 // We're treating MyGL as our game engine class, so we're going to perform
 // all per-frame actions here, such as performing physics updates on all
 // entities in the scene.
 void MyGL::tick() {
-    qint64 currFrameTime = QDateTime::currentMSecsSinceEpoch();
-    float dT = (currFrameTime - m_prevFrameTime) * 0.001f;
-    // Have the player update their position and physics
+    m_profiler.beginFrame();
+    qint64 currFrameTime = m_clock.nsecsElapsed();
+    qint64 frameNs = currFrameTime - m_prevFrameTime;
+    float dT = std::min(frameNs * 1e-9f, MAX_FRAME_TIME);
+    m_prevFrameTime = currFrameTime;
+
+    // Have the player update their position and physics in fixed steps,
+    // so movement and collisions don't depend on the frame rate
     m_inputs.focused = this->hasFocus();
-    m_player.tick(dT, m_inputs);
+    m_profiler.beginCPU(PROFILE_SIMULATION);
+    if (m_inputMode != INPUT_LIVE && !m_initialTerrainLoaded) {
+        // Recordings and replays start from the same place, once the
+        // terrain around the Player has loaded
+        m_accumulator = 0.f;
+    } else if (m_inputMode == INPUT_REPLAY) {
+        // Exactly one recorded step per frame however long frames take,
+        // so every replay renders the same frames
+        if (m_replayStep < m_recording.size()) {
+            InputRecording::Step step = m_recording.getStep(m_replayStep++);
+            simulationStep(step.dT, step.input);
+            dT = step.dT;
+            m_replayFrameMs.push_back(frameNs * 1e-6f);
+        } else {
+            finishReplay();
+        }
+        m_interpolation = 1.f;
+    } else {
+        m_accumulator += dT;
+        while (m_accumulator >= SIMULATION_STEP) {
+            if (m_inputMode == INPUT_RECORD) {
+                m_recording.append(SIMULATION_STEP, m_inputs);
+            }
+            simulationStep(SIMULATION_STEP, m_inputs);
+            m_accumulator -= SIMULATION_STEP;
+        }
+        // The remainder places this frame between the last two steps
+        m_interpolation = m_accumulator / SIMULATION_STEP;
+    }
+    m_profiler.endCPU(PROFILE_SIMULATION);
+
+    updateWorld(dT);
+    update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
+}
+
+void MyGL::updateWorld(float dT) {
     // Check if the terrain should expand
     // This both checks to see if the player is near the border of existing
     // terrain AND checks the status of any FBMWorkers that are generating Chunks
-    m_terrain.multithreadedWork(m_player.mcr_position, m_player.mcr_posPrev, dT);
+    m_profiler.beginCPU(PROFILE_TERRAIN_STREAMING);
+    m_terrain.multithreadedWork(m_player.mcr_position, dT);
+    m_profiler.endCPU(PROFILE_TERRAIN_STREAMING);
+    // Keep water, ice and lava faces ordered back to front for blending
+    m_profiler.beginCPU(PROFILE_TRANSPARENT_SORT);
+    m_terrain.sortTransparentFaces(m_player.mcr_camera.mcr_position);
+    m_profiler.endCPU(PROFILE_TRANSPARENT_SORT);
 
-    // The terrain expansion function generateTerrain(glm::vec3 pos) will be called inside update()
-    update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
-    sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
-    m_prevFrameTime = currFrameTime;
     if (!m_initialTerrainLoaded) {
         m_initialTerrainLoaded = m_terrain.initialTerrainDoneLoading();
+        if (m_initialTerrainLoaded) {
+            m_mobs.spawn(m_player.mcr_position, m_mobTarget, m_mobs.getSpawnRadius());
+            if (m_inputMode == INPUT_RECORD) {
+                m_recording.reset(m_terrain.getSeed(), m_mobTarget);
+            }
+        }
+    }
+}
+
+ProfileSample MyGL::renderFrameAt(glm::vec3 eye, glm::vec2 orientation) {
+    m_profiler.beginFrame();
+    m_profiler.beginCPU(PROFILE_SIMULATION);
+    m_player.setPose(eye, orientation);
+    m_mobs.tick(SIMULATION_STEP, m_player.mcr_position);
+    m_interpolation = 1.f;
+    m_profiler.endCPU(PROFILE_SIMULATION);
+
+    updateWorld(SIMULATION_STEP);
+    paintGL();
+    // Without a swap nothing else would keep the CPU from running
+    // frames ahead of the GPU
+    glFinish();
+    m_profiler.collectGPUTimes();
+    return m_profiler.latest();
+}
+
+bool MyGL::isInitialTerrainLoaded() const {
+    return m_initialTerrainLoaded;
+}
+
+glm::vec3 MyGL::getCameraPosition() const {
+    return m_player.mcr_camera.mcr_position;
+}
+
+void MyGL::simulationStep(float dT, InputBundle &inputs) {
+    m_player.tick(dT, inputs);
+    m_mobs.tick(dT, m_player.mcr_position);
+    inputs.flightToggled = false;
+    inputs.leftClicked = false;
+    inputs.rightClicked = false;
+}
+
+void MyGL::recordInputs(const QString &path) {
+    m_inputMode = INPUT_RECORD;
+    m_recordingPath = path;
+}
+
+bool MyGL::replayInputs(const QString &path, unsigned int *seed) {
+    if (!m_recording.load(path)) {
+        return false;
     }
+    m_inputMode = INPUT_REPLAY;
+    m_replayStep = 0;
+    m_replayFrameMs.clear();
+    m_replayFrameMs.reserve(m_recording.size());
+    m_mobTarget = m_recording.getMobCount();
+    *seed = m_recording.getSeed();
+    return true;
+}
+
+void MyGL::finishReplay() {
+    m_inputMode = INPUT_LIVE;
+    // The first frame's time includes spawning the mobs
+    if (!m_replayFrameMs.empty()) {
+        m_replayFrameMs.erase(m_replayFrameMs.begin());
+    }
+    float total = 0.f;
+    for (float ms : m_replayFrameMs) {
+        total += ms;
+    }
+    std::cout << "Replayed " << m_recording.size() << " steps in " << m_replayFrameMs.size() << " frames\n";
+    if (!m_replayFrameMs.empty()) {
+        std::cout << "Frame time (ms): mean " << total / m_replayFrameMs.size()
+                  << ", p50 " << percentile(m_replayFrameMs, 0.5f)
+                  << ", p90 " << percentile(m_replayFrameMs, 0.9f)
+                  << ", p99 " << percentile(m_replayFrameMs, 0.99f)
+                  << ", max " << percentile(m_replayFrameMs, 1.f) << "\n";
+    }
+    // Only streaming terrain in at a different pace can make a replay
+    // take another path, which makes its timings incomparable
+    float drift = glm::distance(m_player.mcr_position, m_recording.getEndPosition());
+    if (drift > 0.01f) {
+        std::cout << "Warning: the replay ended " << drift << " blocks from where the recording did\n";
+    }
+    std::cout.flush();
+    QApplication::quit();
 }
 
 void MyGL::sendPlayerDataToGUI() const {
@@ -162,56 +380,89 @@ void MyGL::sendPlayerDataToGUI() const {
     glm::ivec2 zone(64 * glm::ivec2(glm::floor(pPos / 64.f)));
     emit sig_sendPlayerChunk(QString::fromStdString("( " + std::to_string(chunk.x) + ", " + std::to_string(chunk.y) + " )"));
     emit sig_sendPlayerTerrainZone(QString::fromStdString("( " + std::to_string(zone.x) + ", " + std::to_string(zone.y) + " )"));
+    emit sig_sendChunksDrawn(QString::fromStdString(std::to_string(m_terrain.getChunksVisible()) + " / " +
+                                                    std::to_string(m_terrain.getChunksInRange()) + " (sections " +
+                                                    std::to_string(m_terrain.getSectionsVisible()) + " / " +
+                                                    std::to_string(m_terrain.getSectionsInRange()) + ")"));
+    ArenaStats gpu = m_terrain.getArena().getStats();
+    emit sig_sendGPUMemory(QString::number(gpu.bytesUsed / 1048576.0, 'f', 1) + " / " +
+                           QString::number(gpu.bytesCapacity / 1048576.0, 'f', 1) + " MB, " +
+                           QString::number(gpu.meshes) + " meshes in " + QString::number(gpu.buffers) + " buffers");
+
+    // Stage times averaged over about half a second, so they can be read
+    auto ms = [](float t) {
+        return t < 0.f ? QString("  -  ") : QString::number(t, 'f', 2).rightJustified(5);
+    };
+    ProfileSample mean = m_profiler.average(30);
+    emit sig_sendFrameTime(ms(mean.frameMs) + " ms (cpu " + ms(mean.cpuTotal()).trimmed() +
+                           ", gpu " + ms(mean.gpuTotal()).trimmed() + ")");
+    QString stages = "stage               cpu ms  gpu ms";
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        stages += "\n" + QString(profileStageName(ProfileStage(i))).leftJustified(18) +
+                  "  " + ms(mean.cpuMs[i]) + "   " + ms(mean.gpuMs[i]);
+    }
+    emit sig_sendFrameStages(stages);
+    QList<float> frameMs, gpuMs;
+    for (const ProfileSample &sample : m_profiler.history()) {
+        frameMs.push_back(sample.frameMs);
+        gpuMs.push_back(sample.gpuTotal());
+    }
+    emit sig_sendFrameGraph(frameMs, gpuMs);
+}
+
+bool MyGL::exportFrameProfile(const QString &path) const {
+    return m_profiler.writeCSV(path);
 }
 
 // This function is called whenever update() is called.
-// MyGL's constructor links update() to a timer that fires 60 times per second,
-// so paintGL() called at a rate of 60 frames per second.
+// tick() calls update() after every presented frame, so paintGL() runs at
+// the display's refresh rate with vsync and as fast as it can without.
 void MyGL::paintGL() {
+    ProfileScope paintScope(m_profiler, PROFILE_PAINT);
+    // Draw from where the camera is between the last two simulation steps
+    Camera camera = m_player.getInterpolatedCamera(m_interpolation);
+    resetDrawStats();
+
+    // Only the screen effects that apply from where the camera is
+    m_postChain.clearPasses();
+    BlockType eyeBlock = m_terrain.tryGetBlockAt(camera.mcr_position);
+    if (eyeBlock == WATER) {
+        m_postChain.addPass(POST_UNDERWATER);
+    } else if (eyeBlock == LAVA) {
+        m_postChain.addPass(POST_LAVA);
+    }
+
     // Clear the screen so that we only see newly drawn images
-    m_frameBuffer.bindFrameBuffer();
+    m_postChain.bindSceneTarget();
 
     glViewport(0, 0, this->width() * this->devicePixelRatio(),
                this->height() * this->devicePixelRatio());
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glm::mat4 viewproj = m_player.mcr_camera.getViewProj();
-
-    m_progFlat.setViewProjMatrix(viewproj);
-    m_progLambert.setViewProjMatrix(viewproj);
-
-    m_progLambert.setTime(m_time++);
-    m_progInstanced.setViewProjMatrix(m_player.mcr_camera.getViewProj());
-    // Sky
-    // Pass u_ViewProj (inverse of the viewproj)
-    mp_progSky->setViewProjMatrix(glm::inverse(viewproj)); // View_Mat^(-1) * Proj_Mat^(-1) * p
-    mp_progSky->useMe();
-    // pass u_Eye
-    this->glUniform3f(mp_progSky->unifEye, m_player.mcr_camera.mcr_position.x, m_player.mcr_camera.mcr_position.y, m_player.mcr_camera.mcr_position.z);
-    // pass u_Time
-    this->glUniform1f(mp_progSky->unifTime, m_time);
-
-    mp_progSky->draw(m_quad);
+    // One upload of the camera and time for every shader program
+    uploadFrameData(camera);
 
+    // Opaque terrain first, so the sky is only shaded where it's visible
+    if (m_initialTerrainLoaded) {
+        ProfileScope terrainScope(m_profiler, PROFILE_TERRAIN_DRAW, true);
+        renderTerrain(camera);
+    }
+    if (m_initialTerrainLoaded) {
+        ProfileScope mobScope(m_profiler, PROFILE_MOB_DRAW, true);
+        renderMobs(camera);
+    }
+    {
+        ProfileScope skyScope(m_profiler, PROFILE_SKY, true);
+        renderSky(camera);
+    }
 
     if (m_initialTerrainLoaded) {
-        renderTerrain();
-        glBindFramebuffer(GL_FRAMEBUFFER, this->defaultFramebufferObject());
-        glViewport(0, 0, this->width() * this->devicePixelRatio(),
-                   this->height() * this->devicePixelRatio());
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        m_frameBuffer.bindToTextureSlot(1);
-        if (m_terrain.getBlockAt(m_player.mcr_position+glm::vec3(0,1.5,0)) == WATER) {
-            // 1 is for under water visual effects
-            m_progPost.setUCase(1);
-        } else if (m_terrain.getBlockAt(m_player.mcr_position+glm::vec3(0,1.5,0)) == LAVA) {
-            // 2 for lava
-            m_progPost.setUCase(2);
-        } else {
-            // any other number will be normal
-            m_progPost.setUCase(0);
-        }
-        m_progPost.draw(m_quad,1);
+        ProfileScope transparentScope(m_profiler, PROFILE_TRANSPARENT_DRAW, true);
+        renderTransparentTerrain();
+    }
+    if (m_postChain.hasPasses()) {
+        ProfileScope postScope(m_profiler, PROFILE_POST, true);
+        m_postChain.apply(m_quad);
     }
 
 }
@@ -219,12 +470,78 @@ void MyGL::paintGL() {
 // TODO: Change this so it renders the nine zones of generated
 // terrain that surround the player (refer to Terrain::m_generatedTerrain
 // for more info)
-void MyGL::renderTerrain() {
+void MyGL::renderTerrain(const Camera &camera) {
     glBindTexture(GL_TEXTURE_2D, m_renderedTexture);
     glActiveTexture(GL_TEXTURE0);
 //    m_terrain.generateTerrain(m_player.mcr_position);
-    auto chunkX = glm::floor(m_player.mcr_position.x / 16.f) * 16, chunkZ = glm::floor(m_player.mcr_position.z / 16.f) * 16;
-    m_terrain.draw(chunkX - 64, chunkX + 65, chunkZ - 64, chunkZ + 65, &m_progLambert);
+    // The farthest zones in range reach about a zone past the render
+    // distance, and fade out over that zone
+    m_progLambert.setFogDistance(16.f * m_terrain.getRenderDistance() + 64.f);
+    m_terrain.draw(&m_progLambert, Frustum(camera.getViewProj()), camera.mcr_position);
+    // The Terrain draws with its own VAO, everything else shares this one
+    glBindVertexArray(vao);
+}
+
+void MyGL::renderMobs(const Camera &camera) {
+    m_mobs.getInstances(m_interpolation, Frustum(camera.getViewProj()), &m_mobOffsets, &m_mobColors);
+    if (m_mobOffsets.empty()) {
+        return;
+    }
+    m_mobCube.createInstancedVBOdata(m_mobOffsets, m_mobColors);
+    m_progMob.drawInstanced(m_mobCube);
+}
+
+void MyGL::renderTransparentTerrain() {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_renderedTexture);
+    m_terrain.drawTransparent(&m_progLambert);
+    glBindVertexArray(vao);
+}
+
+bool MyGL::skyNeedsUpdate(const glm::mat4 &skyViewProj) const {
+    if (!m_skyValid || m_time - m_skyTime >= SKY_MAX_AGE) {
+        return true;
+    }
+    // Where the corners and center of the screen land in the cached sky.
+    // With the eye at the origin a point on the far plane is also the
+    // direction of the ray through it.
+    glm::mat4 invViewProj = glm::inverse(skyViewProj);
+    for (glm::vec2 ndc : {glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(-1, 1), glm::vec2(1, 1), glm::vec2(0, 0)}) {
+        glm::vec4 p = invViewProj * glm::vec4(ndc, 1, 1);
+        glm::vec4 cached = m_skyViewProj * glm::vec4(glm::vec3(p) / p.w, 1);
+        if (cached.w <= 0.f || glm::length(glm::vec2(cached) / cached.w - ndc) > SKY_MAX_REPROJECTION) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MyGL::renderSky(const Camera &camera) {
+    // The sky only depends on the direction of each ray, so the eye
+    // is moved to the origin
+    glm::mat4 skyViewProj = camera.getViewProj() * glm::translate(glm::mat4(), camera.mcr_position);
+    if (skyNeedsUpdate(skyViewProj)) {
+        // Shade the sky at quarter resolution, replacing the cached one
+        m_skyBuffer.bindFrameBuffer();
+        glViewport(0, 0, m_skySize.x, m_skySize.y);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        mp_progSky->draw(m_quad);
+        glEnable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        m_skyViewProj = skyViewProj;
+        m_skyTime = m_time;
+        m_skyValid = true;
+
+        m_postChain.bindSceneTarget();
+        glViewport(0, 0, this->width() * this->devicePixelRatio(),
+                   this->height() * this->devicePixelRatio());
+    }
+    // The quad lies on the far plane, so pixels the terrain already covers
+    // fail the depth test and are never shaded
+    m_skyBuffer.bindToTextureSlot(SKY_TEXTURE_SLOT);
+    m_progSkyUpsample.setSkyViewProjMatrix(m_skyViewProj);
+    m_progSkyUpsample.draw(m_quad, SKY_TEXTURE_SLOT);
 }
 
 
@@ -280,74 +597,19 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
     if (e->key() == Qt::Key_F) {
         // In flight mode: Toggle flight mode OFF
         // In Ground mode: Toggle flight mode ON
-        m_player.changeFlightMode();
+        m_inputs.flightToggled = true;
     }
     if (e->key() == Qt::Key_Space) {
         // In Ground mode: Add a vertical component to the player's velocity to make them jump
         m_inputs.spacePressed = true;
     }
-    // For height map feature
     if (e->key() == Qt::Key_H) {
-        QString fileName = QFileDialog::getOpenFileName(this, tr("Open grayscale/color image"),
-                                                        "/",
-                                                        tr("Images (*.png *.jpeg *.jpg)"));
-        if (fileName.length() > 0) {
-            QImage img(fileName);
-            img = img.scaled(QSize(64, 64), Qt::KeepAspectRatio, Qt::FastTransformation);
-            bool allGray = img.allGray();
-            int w = img.width();
-            int h = img.height();
-            std::vector<std::vector<float>> newHeights;
-            std::vector<std::vector<std::pair<float, BlockType>>> newBlocks;
-            std::vector<std::pair<glm::vec3, BlockType>> colorPairs; // (RGB, NAME) pairs
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(0, 0, 0), BLACK));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(255, 255, 255), WHITE));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(255, 0, 0), RED));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(0, 255, 0), LIME));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(0, 0, 255), BLUE));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(255, 255, 0), YELLOW));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(0, 255, 255), CYAN));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(255, 0, 255), MAGENTA));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(192, 192, 192), SILVER));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(128, 128, 128), GRAY));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(128, 0, 0), MAROON));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(128, 128, 0), OLIVE));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(0, 128, 0), GREEN));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(128, 0, 128), PURPLE));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(0, 128, 128), TEAL));
-            colorPairs.push_back(std::pair<glm::vec3, BlockType>(glm::vec3(0, 0, 128), NAVY));
-            for (int i = 0; i < w; i++) {
-                newHeights.push_back(std::vector<float>());
-                newBlocks.push_back(std::vector<std::pair<float, BlockType>>());
-                for (int j = 0; j < h; j++) {
-                    QColor c = img.pixel(i, j);
-                    float grayscale = 0.2126 * c.red() + 0.7152 * c.green() + 0.0722 * c.blue();
-                    if (allGray) {
-                        newHeights[i].push_back(grayscale * 0.25 + 128.f);
-                    } else {
-                        BlockType t = BLACK;
-                        int minDistSquare = (c.red() - colorPairs[0].first.x) * (c.red() - colorPairs[0].first.x) +
-                                            (c.green() - colorPairs[0].first.y) * (c.green() - colorPairs[0].first.y) +
-                                            (c.blue() - colorPairs[0].first.z) * (c.blue() - colorPairs[0].first.z);
-                        for (int k = 1; k < (int) colorPairs.size(); k++) {
-                            int distSquare = (c.red() - colorPairs[k].first.x) * (c.red() - colorPairs[k].first.x) +
-                                             (c.green() - colorPairs[k].first.y) * (c.green() - colorPairs[k].first.y) +
-                                             (c.blue() - colorPairs[k].first.z) * (c.blue() - colorPairs[k].first.z);
-                            if (minDistSquare > distSquare) {
-                                minDistSquare = distSquare;
-                                t = colorPairs[k].second;
-                            }
-                        }
-                        newBlocks[i].push_back(std::pair<float, BlockType>(grayscale * 0.25 + 128.f, t));
-                    }
-                }
-            }
-            if (allGray) {
-                m_terrain.updategrayscaleHeights(m_player.mcr_position.x, m_player.mcr_position.z, newHeights);
-            } else {
-                m_terrain.updateColorHeights(m_player.mcr_position.x, m_player.mcr_position.z, newBlocks);
-            }
-        }
+        importHeightMap();
+    }
+    if (e->key() == Qt::Key_BracketLeft || e->key() == Qt::Key_BracketRight) {
+        int step = e->key() == Qt::Key_BracketLeft ? -2 : 2;
+        setRenderDistance(m_terrain.getRenderDistance() + step);
+        std::cout << "Render distance " << m_terrain.getRenderDistance() << " chunks" << std::endl;
     }
 }
 
@@ -401,9 +663,10 @@ void MyGL::mouseMoveEvent(QMouseEvent *e) {
 
 void MyGL::mousePressEvent(QMouseEvent *e) {
     // MS1.3
+    // Acted on by the next simulation step, so recordings include them
     if (e->button() == Qt::LeftButton) {
-        m_player.removeBlock();
+        m_inputs.leftClicked = true;
     } else if (e->button() == Qt::RightButton) {
-        m_player.placeBlock();
+        m_inputs.rightClicked = true;
     }
 }
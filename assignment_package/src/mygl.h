@@ -7,8 +7,15 @@
 #include "scene/camera.h"
 #include "scene/terrain.h"
 #include "scene/player.h"
+#include "scene/mobsystem.h"
+#include "scene/cube.h"
 #include "framebuffer.h"
+#include "postchain.h"
+#include "frameprofiler.h"
+#include "inputrecording.h"
 #include "scene/quad.h"
+#include "scene/frustum.h"
+#include <QElapsedTimer>
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLShaderProgram>
 #include <smartpointerhelp.h>
@@ -22,9 +29,10 @@ private:
     ShaderProgram m_progLambert;// A shader program that uses lambertian reflection
     ShaderProgram m_progFlat;// A shader program that uses "flat" reflection (no shadowing at all)
     ShaderProgram m_progInstanced;// A shader program that is designed to be compatible with instanced rendering
-    ShaderProgram m_progPost;
+    ShaderProgram m_progMob; // Draws every mob as an instance of m_mobCube
 
     ShaderProgram* mp_progSky; // A screen-space shader for creating the sky background
+    ShaderProgram m_progSkyUpsample; // Draws the sky rendered by mp_progSky at full resolution
 
     GLuint vao; // A handle for our vertex array object. This will store the VBOs created in our geometry classes.
                 // Don't worry too much about this. Just know it is necessary in order to render geometry.
@@ -32,24 +40,81 @@ private:
     Terrain m_terrain; // All of the Chunks that currently comprise the world.
     Player m_player; // The entity controlled by the user. Contains a camera to display what it sees as well.
     InputBundle m_inputs; // A collection of variables to be updated in keyPressEvent, mouseMoveEvent, mousePressEvent, etc.
-
-    QTimer m_timer; // Timer linked to tick(). Fires approximately 60 times per second.
+    MobSystem m_mobs; // Every mob wandering around the Player
+    int m_mobTarget; // Mobs spawned once the initial terrain has loaded
+    int m_simulationDistance; // Requested by setSimulationDistance, in Chunks
+    Cube m_mobCube;
+    // Per-instance data of the mobs drawn this frame, kept to reuse the allocations
+    std::vector<glm::vec3> m_mobOffsets, m_mobColors;
+
+    QTimer m_guiTimer; // Timer linked to sendPlayerDataToGUI(). Fires 10 times per second.
     GLuint m_renderedTexture; // Handles the rendered texture
+    GLuint m_frameDataUBO; // Uniform buffer holding this frame's FrameData
     unsigned m_time; // Counts the time we call paintGL().
-    qint64 m_prevFrameTime; // previous frame's currentMSecsSinceEpoch
+    QElapsedTimer m_clock; // Monotonic clock frame times are measured with
+    qint64 m_prevFrameTime; // m_clock's reading at the previous tick(), in nanoseconds
+    float m_accumulator; // Frame time not yet consumed by simulation steps, in seconds
+    float m_interpolation; // How far the rendered frame is between the last two simulation steps
     bool m_initialTerrainLoaded;
 
     Quad m_quad;
-    FrameBuffer m_frameBuffer;
+    PostChain m_postChain; // Underwater and lava tints, drawn over the scene
+    // The sky, shaded at quarter resolution and reused while the view
+    // and time of day barely change
+    FrameBuffer m_skyBuffer;
+    glm::ivec2 m_skySize;
+    glm::mat4 m_skyViewProj; // View-projection m_skyBuffer was rendered with, eye at the origin
+    unsigned m_skyTime; // m_time when m_skyBuffer was rendered
+    bool m_skyValid;
+    FrameProfiler m_profiler; // CPU and GPU time of every stage of the last frames
+
+    // Whether the inputs of every simulation step come from the keyboard
+    // and mouse, and are recorded, or come from m_recording
+    enum InputMode { INPUT_LIVE, INPUT_RECORD, INPUT_REPLAY };
+    InputMode m_inputMode;
+    InputRecording m_recording;
+    QString m_recordingPath; // Where m_recording is saved when recording
+    int m_replayStep; // The next step of m_recording to replay
+    std::vector<float> m_replayFrameMs; // Frame times while replaying
 
     void moveMouseToCenter(); // Forces the mouse position to the screen's center. You should call this
                               // from within a mouse move event after reading the mouse movement so that
                               // your mouse stays within the screen bounds and is always read.
 
-    void sendPlayerDataToGUI() const;
+    // Advances the Player and the mobs by dT, then clears the inputs
+    // that only act once
+    void simulationStep(float dT, InputBundle &inputs);
+    // Streams the terrain in around the Player over dT and sorts its
+    // transparent faces, then spawns the mobs once the initial terrain
+    // has loaded
+    void updateWorld(float dT);
+    // Prints the replay's frame time percentiles and quits
+    void finishReplay();
+    // Asks for a height map, and a world directory to write it to if
+    // there isn't one yet, and imports it around the Player
+    void importHeightMap();
+
+    // Whether the cached sky can't be reprojected to skyViewProj
+    bool skyNeedsUpdate(const glm::mat4 &skyViewProj) const;
+
+    // The sun and clouds move every frame, so the cached sky is
+    // re-rendered at least this often
+    static constexpr unsigned SKY_MAX_AGE = 2;
+    // How far, in NDC, the screen may have turned away from the cached
+    // sky before it is re-rendered
+    static constexpr float SKY_MAX_REPROJECTION = 0.01f;
+    static constexpr int SKY_TEXTURE_SLOT = 2;
 
 
 public:
+    // The Player and everything else that moves advance in steps of this
+    // many seconds no matter how fast frames are rendered
+    static constexpr float SIMULATION_STEP = 1.f / 60.f;
+    // Longest frame time simulated in one tick(). Anything beyond it
+    // (a breakpoint, a dragged window) is dropped instead of being
+    // caught up on, which would only make the next frame slower.
+    static constexpr float MAX_FRAME_TIME = 0.25f;
+
     explicit MyGL(QWidget *parent = nullptr);
     ~MyGL();
 
@@ -61,15 +126,61 @@ public:
     // Called whenever MyGL is resized.
     void resizeGL(int w, int h) override;
     // Called whenever MyGL::update() is called.
-    // In the base code, update() is called from tick().
+    // update() is called from tick().
     void paintGL() override;
 
     // Called from paintGL().
-    // Calls Terrain::draw().
-    void renderTerrain();
+    // Calls Terrain::draw() from camera's point of view.
+    void renderTerrain(const Camera &camera);
+    // Draws the mobs in view, between their last two simulation steps
+    void renderMobs(const Camera &camera);
+    // Calls Terrain::drawTransparent(), after the sky
+    void renderTransparentTerrain();
+    // Re-renders the quarter-resolution sky if needed and draws it
+    // behind everything drawn so far
+    void renderSky(const Camera &camera);
+    // Fills the FrameData uniform buffer for this frame
+    void uploadFrameData(const Camera &camera);
 
     void GLDrawScene();
 
+    // Sets the world seed and, if directory is not empty, the world
+    // directory pregenerated zones are streamed from.
+    // Must be called before the first tick().
+    void setWorld(const QString &directory, unsigned int seed);
+    // Sets how many mobs are spawned around the Player once the
+    // terrain around it has loaded. Must be called before that.
+    void setMobCount(int count);
+    // How far from the Player the terrain is loaded and drawn, and the
+    // mobs are kept, in Chunks. See Terrain::setRenderDistance and
+    // MobSystem::setSimulationDistance; the simulation distance is
+    // capped to the render distance.
+    void setRenderDistance(int chunks);
+    void setSimulationDistance(int chunks);
+
+    // Records the inputs of every simulation step from when the initial
+    // terrain has loaded, and saves them to path when MyGL is destroyed
+    void recordInputs(const QString &path);
+    // Replays the inputs recorded in path instead of reading the keyboard
+    // and mouse, then prints frame time percentiles and quits. Replaces the
+    // mob count and sets seed to the one the recording was made with, which
+    // setWorld() must be called with. Returns false if path can't be read.
+    bool replayInputs(const QString &path, unsigned int *seed);
+
+    // Renders a frame without waiting for a window, for RenderBenchmark.
+    // Moves the Player's camera to eye, turned by orientation as in
+    // Player::setPose, advances the mobs by a simulation step and the
+    // terrain streaming by as long, and draws with paintGL() into
+    // screenFramebuffer(). Waits for the GPU to finish the frame and
+    // returns its stage times.
+    ProfileSample renderFrameAt(glm::vec3 eye, glm::vec2 orientation);
+    bool isInitialTerrainLoaded() const;
+    glm::vec3 getCameraPosition() const;
+
+    // Writes the frame profiler's history to a CSV file.
+    // Returns false if it can't be written.
+    bool exportFrameProfile(const QString &path) const;
+
 protected:
     // Automatically invoked when the user
     // presses a key on the keyboard
@@ -84,7 +195,12 @@ protected:
     void mousePressEvent(QMouseEvent *e);
 
 private slots:
-    void tick(); // Slot that gets called ~60 times per second by m_timer firing.
+    // Slot that gets called every time a frame has been presented. Runs
+    // as many fixed simulation steps as the elapsed time covers and
+    // requests the next frame, so rendering is paced by the buffer swap:
+    // the display's refresh rate with vsync, as fast as possible without.
+    void tick();
+    void sendPlayerDataToGUI() const;
 
 signals:
     void sig_sendPlayerPos(QString) const;
@@ -93,6 +209,15 @@ signals:
     void sig_sendPlayerLook(QString) const;
     void sig_sendPlayerChunk(QString) const;
     void sig_sendPlayerTerrainZone(QString) const;
+    // Chunks drawn / meshed Chunks in range in the last frame
+    void sig_sendChunksDrawn(QString) const;
+    // Chunk mesh storage used / allocated on the GPU
+    void sig_sendGPUMemory(QString) const;
+    // Average frame, CPU and GPU time, then the same per stage
+    void sig_sendFrameTime(QString) const;
+    void sig_sendFrameStages(QString) const;
+    // Frame and GPU times of the profiler's history, oldest first
+    void sig_sendFrameGraph(QList<float>, QList<float>) const;
 };
 
 
@@ -7,13 +7,13 @@ float step(float e, float x) {
 
 float desertValue(vec2 uv) {
     uv = uv / 256.f;
-    float x = fractalPerlin(uv, 4);
+    float x = fractalPerlin<4>(uv);
     float height = glm::max(0.05f * (1.0f - glm::pow(4.0f * (x - 0.42f), 2.0f)), 0.0f)+ glm::smoothstep(0.05f, 0.2f, x) * (glm::max(((0.4f-x*x) * 0.2f), 0.0f) + (step(x, 0.69f) + step(0.69f, x) * (glm::abs(glm::mod(glm::floor(x * 100.0f), 2.0f)) * 0.1f + 0.9f) * step(x, 0.8f) + 1.0f - step(x, 0.8f)) * ((glm::pow(glm::smoothstep(0.0f, 0.9f, pow(glm::smoothstep(0.0f, 1.0f, x), 1.0f)), 100.0f) + x * 0.1f) / 1.1f));
     return (1.f - height) * 50.f + 133.f;
 }
 
 float mountainValue(vec2 uv) {
-    float perlin = mountainSummedPerlin(uv / 128.f, 6);
+    float perlin = mountainSummedPerlin<6>(uv / 128.f);
     return glm::pow(perlin, 3.f) * 105.f + 150.f;
 }
 
@@ -25,7 +25,7 @@ float grasslandValue(vec2 uv) {
     worley = smoothStep(0, 1, worley);
     worley = cellHeight * worley;
 
-    float fbmNoise = fractalPerlin(uv, 8);
+    float fbmNoise = fractalPerlin<8>(uv);
 
     return (worley * 0.33f + fbmNoise * 0.67f) * 32.f + 118.f;
 }
@@ -34,11 +34,36 @@ float islandValue(vec2 uv) {
     uv = uv / 128.f;
     float cellHeight;
     float noise = worleyNoise2Point(uv + vec2(128, 256), &cellHeight);
-    noise = 0.67f * noise + fbm(uv, 4) * 0.33f;
+    noise = 0.67f * noise + fbm<4>(uv) * 0.33f;
     return smoothstep(0.f, 1.f, noise) * 45.f + 100.f;
     //return smoothstep(0.f, 1.f, fbm(uv, 4)) * 50.f + 90.f;
 }
 
+BiomeWeights biomeWeights(float elevation, const BiomeBlend &blend) {
+    float w = (elevation - blend.mountainStart) / (blend.mountainEnd - blend.mountainStart);
+    if (blend.extrapolate && w < -blend.tolerance) {
+        return BiomeWeights{1.f - w, w};
+    }
+    w = glm::clamp(w, 0.f, 1.f);
+    if (w <= blend.tolerance) {
+        w = 0.f;
+    } else if (w >= 1.f - blend.tolerance) {
+        w = 1.f;
+    }
+    return BiomeWeights{1.f - w, w};
+}
+
+float blendedHeight(vec2 pos, float elevation, const BiomeBlend &blend) {
+    BiomeWeights w = biomeWeights(elevation, blend);
+    if (w.mountain == 0.f) {
+        return grasslandValue(pos);
+    }
+    if (w.grassland == 0.f) {
+        return mountainValue(pos);
+    }
+    return glm::mix(grasslandValue(pos), mountainValue(pos), w.mountain);
+}
+
 vec2 biomeValue(vec2 uv) {
     return vec2(perlinNoise(uv), perlinNoise(uv + vec2(-1000, 1024)));
 }
@@ -55,11 +80,24 @@ float combinedNoise(vec2 uv) {
     worley = smoothStep(0, 1, worley);
     worley = cellHeight * worley;
 
-    float fbmNoise = fractalPerlin(uv, 8);
+    float fbmNoise = fractalPerlin<8>(uv);
 
     return worley * 0.33f + fbmNoise * 0.67f;
 }
 
+ivec2 seedOffset(unsigned int seed) {
+    if (seed == 0) {
+        return ivec2(0);
+    }
+    // Integer hash so that neighboring seeds land far apart
+    unsigned int h = seed * 0x9E3779B1u;
+    h ^= h >> 15;
+    h *= 0x85EBCA77u;
+    h ^= h >> 13;
+    return ivec2(static_cast<int>(h & 0xffff) - 0x8000,
+                 static_cast<int>(h >> 16) - 0x8000);
+}
+
 vec2 random2(vec2 p) {
     return fract(sin(vec2(dot(p, vec2(127.1f, 311.7f)),dot(p, vec2(269.5f, 183.3f)))) * 43758.5453f);
 }
@@ -262,7 +300,13 @@ float interpNoise2D(glm::vec2 xy) {
 }
 
 vec2 eleMoiValue(vec2 uv) {
-    return vec2(clamp(0.f,1.f,fbm(uv,3)-0.2f), clamp(0.f,1.f,fbm(uv + vec2(-1000, 1024),3)+0.3f));
+    return vec2(elevationValue(uv), clamp(0.f,1.f,fbm<3>(uv + vec2(-1000, 1024))+0.3f));
+}
+
+// The elevation component of eleMoiValue on its own, for callers
+// that have no use for the moisture component
+float elevationValue(vec2 uv) {
+    return clamp(0.f,1.f,fbm<3>(uv)-0.2f);
 }
 
 
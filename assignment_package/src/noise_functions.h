@@ -1,5 +1,7 @@
 #pragma once
 #include "glm_includes.h"
+#include <array>
+#include <utility>
 
 #define DESERT_MAX_HEIGHT 128.f
 #define MOUNTAIN_MAX_HEIGHT 248.f
@@ -8,6 +10,38 @@
 
 using namespace glm;
 
+// Thresholds for blending the grassland and mountain height functions
+// by elevation. The elevation is remapped so that mountainStart gives a
+// mountain weight of 0 and mountainEnd a weight of 1; weights are clamped
+// to that range and snapped to either end within tolerance, so that only
+// the height functions that actually contribute to a column get evaluated.
+// The defaults reproduce the original glm::mix(grassland, mountain, elevation).
+struct BiomeBlend {
+    float mountainStart;
+    float mountainEnd;
+    float tolerance;
+    // Elevations below mountainStart keep lowering the grassland height,
+    // as the original mix did, instead of counting as pure grassland.
+    // Such columns evaluate both height functions. On by default to keep
+    // the original terrain; custom bands should turn it off, since far
+    // below a narrow band the extrapolated height runs away.
+    bool extrapolate;
+
+    BiomeBlend()
+        : mountainStart(0.f), mountainEnd(1.f), tolerance(0.f), extrapolate(true)
+    {}
+};
+
+struct BiomeWeights {
+    float grassland;
+    float mountain;
+};
+
+// Offset applied to world-space noise coordinates so that each world
+// seed samples a different region of the noise. Seed 0 is the original
+// world (no offset).
+ivec2 seedOffset(unsigned int seed);
+
 vec2 random2(vec2 p);
 vec2 random2(vec3 p);
 vec3 random3(vec3 p);
@@ -39,9 +73,106 @@ float grasslandValue(vec2 uv);
 float islandValue(vec2 uv);
 float riverNoise(vec2 uv);
 
+// Biome-weight stage: computes the blend weights first, then
+// evaluates only the height functions with non-negligible weight
+BiomeWeights biomeWeights(float elevation, const BiomeBlend &blend);
+float blendedHeight(vec2 pos, float elevation, const BiomeBlend &blend);
+
 vec2 eleMoiValue(vec2 uv);
+float elevationValue(vec2 uv);
 glm::vec2 hash(glm::vec2 p);
 float SimplexNoise(glm::vec2 p);
 float moisture(glm::vec2 uv);
 
 float temperature(glm::vec2 uv);
+
+// Compile-time octave kernels.
+// The octave count is a template parameter, so the loop is unrolled and
+// the frequencies and amplitudes are constants. fbm<N> gives exactly the
+// same result as fbm(uv, N). The Perlin kernels inline their basis and
+// multiply out the falloff's powers instead of calling pow(), so they
+// match fractalPerlin / mountainSummedPerlin up to float rounding.
+// Biome height functions should be built from these.
+
+// Each octave doubles the frequency and halves the amplitude of the last
+template <int Octaves>
+struct OctaveTable {
+    std::array<float, Octaves> freq;
+    std::array<float, Octaves> amp;
+    float ampSum;
+
+    constexpr OctaveTable(float baseFreq)
+        : freq(), amp(), ampSum(0.f)
+    {
+        float f = baseFreq;
+        float a = 0.5f;
+        for (int i = 0; i < Octaves; i++) {
+            freq[i] = f;
+            amp[i] = a;
+            ampSum += a;
+            f *= 2.f;
+            a *= 0.5f;
+        }
+    }
+};
+
+// Calls octave(0) ... octave(N - 1) in order, without a loop
+template <typename F, int... I>
+inline void forEachOctave(std::integer_sequence<int, I...>, F octave) {
+    (octave(I), ...);
+}
+
+// Sum of Basis over the octaves of an OctaveTable starting at frequency 4
+template <int Octaves, float (*Basis)(vec2)>
+inline float octaveNoise(vec2 uv) {
+    static constexpr OctaveTable<Octaves> table(4.f);
+    float sum = 0.f;
+    forEachOctave(std::make_integer_sequence<int, Octaves>(), [&](int i) {
+        sum += Basis(uv * table.freq[i]) * table.amp[i];
+    });
+    return sum;
+}
+
+// perlinNoise(vec2) for the kernels below
+inline float perlinFalloff(float dist) {
+    float dist3 = dist * dist * dist;
+    return 1 - 6 * (dist3 * dist * dist) + 15 * (dist3 * dist) - 10 * dist3;
+}
+
+inline float perlinSurflet(vec2 P, vec2 gridPoint) {
+    vec2 diff = P - gridPoint;
+    return dot(diff, random2(gridPoint)) * perlinFalloff(glm::abs(diff.x)) * perlinFalloff(glm::abs(diff.y));
+}
+
+inline float perlinBasis(vec2 uv) {
+    vec2 uvXLYL = floor(uv);
+    return perlinSurflet(uv, uvXLYL) + perlinSurflet(uv, uvXLYL + vec2(1, 0)) +
+           perlinSurflet(uv, uvXLYL + vec2(1, 1)) + perlinSurflet(uv, uvXLYL + vec2(0, 1));
+}
+
+inline float ridgedPerlinBasis(vec2 uv) {
+    return 1.f - glm::abs(perlinBasis(uv));
+}
+
+template <int Octaves>
+inline float fbm(vec2 uv) {
+    return octaveNoise<Octaves, bilerpNoise>(uv);
+}
+
+template <int Octaves>
+inline float fractalPerlin(vec2 uv) {
+    return octaveNoise<Octaves, ridgedPerlinBasis>(uv);
+}
+
+template <int Octaves>
+inline float mountainSummedPerlin(vec2 uv) {
+    static constexpr OctaveTable<Octaves> table(1.f);
+    float sum = 0.f;
+    float prevValue = 1.f;
+    forEachOctave(std::make_integer_sequence<int, Octaves>(), [&](int i) {
+        float noise = ridgedPerlinBasis(uv * table.freq[i]) * prevValue;
+        prevValue = noise;
+        sum += noise * table.amp[i];
+    });
+    return sum / table.ampSum;
+}
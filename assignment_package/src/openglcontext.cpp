@@ -4,11 +4,13 @@
 #include <QApplication>
 #include <QProcessEnvironment>
 #include <QOpenGLContext>
+#include <QOpenGLVersionFunctionsFactory>
 #include <QDebug>
 
 
 OpenGLContext::OpenGLContext(QWidget *parent)
-    : QOpenGLWidget(parent)
+    : QOpenGLWidget(parent), m_currentProgram(0), mp_functions33(nullptr), m_functions33Resolved(false),
+      m_drawStats(), m_screenFramebuffer()
 {}
 
 OpenGLContext::~OpenGLContext()
@@ -21,7 +23,8 @@ inline const char *glGS(GLenum e)
 
 void OpenGLContext::debugContextVersion()
 {
-    QOpenGLContext *ctx = context();
+    // Not context(), which is null when rendering without a window
+    QOpenGLContext *ctx = QOpenGLContext::currentContext();
     QSurfaceFormat form = format();
     QSurfaceFormat ctxform = ctx->format();
     QSurfaceFormat::OpenGLContextProfile prof = ctxform.profile();
@@ -142,3 +145,58 @@ void OpenGLContext::printShaderInfoLog(int shader)
     // Throwing here allows us to use the debugger to track down the error.
     throw;
 }
+
+void OpenGLContext::useProgram(GLuint prog) {
+    if (prog != m_currentProgram) {
+        glUseProgram(prog);
+        m_currentProgram = prog;
+    }
+}
+
+void OpenGLContext::multiDrawElementsBaseVertex(GLenum mode, const GLsizei *count, GLenum type,
+                                                const void *const *indices, GLsizei drawCount, const GLint *baseVertex) {
+    if (!m_functions33Resolved) {
+        m_functions33Resolved = true;
+        mp_functions33 = QOpenGLVersionFunctionsFactory::get<QOpenGLFunctions_3_3_Core>(QOpenGLContext::currentContext());
+        if (mp_functions33 != nullptr && !mp_functions33->initializeOpenGLFunctions()) {
+            mp_functions33 = nullptr;
+        }
+    }
+    qint64 vertices = 0;
+    for (GLsizei i = 0; i < drawCount; i++) {
+        vertices += count[i];
+    }
+    if (mp_functions33 != nullptr) {
+        mp_functions33->glMultiDrawElementsBaseVertex(mode, count, type, indices, drawCount, baseVertex);
+        countDraw(mode, vertices);
+    } else {
+        for (GLsizei i = 0; i < drawCount; i++) {
+            glDrawElementsBaseVertex(mode, count[i], type, indices[i], baseVertex[i]);
+        }
+        countDraw(mode, vertices);
+        m_drawStats.drawCalls += drawCount - 1;
+    }
+}
+
+void OpenGLContext::countDraw(GLenum mode, qint64 count) {
+    m_drawStats.drawCalls++;
+    if (mode == GL_TRIANGLES) {
+        m_drawStats.triangles += count / 3;
+    }
+}
+
+void OpenGLContext::resetDrawStats() {
+    m_drawStats = DrawStats();
+}
+
+DrawStats OpenGLContext::getDrawStats() const {
+    return m_drawStats;
+}
+
+GLuint OpenGLContext::screenFramebuffer() const {
+    return m_screenFramebuffer ? *m_screenFramebuffer : defaultFramebufferObject();
+}
+
+void OpenGLContext::setScreenFramebuffer(GLuint framebuffer) {
+    m_screenFramebuffer = framebuffer;
+}
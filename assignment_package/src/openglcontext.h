@@ -3,6 +3,16 @@
 #include <QOpenGLWidget>
 #include <QTimer>
 #include <QOpenGLExtraFunctions>
+#include <QOpenGLFunctions_3_3_Core>
+#include <optional>
+
+// Draw calls and triangles submitted since OpenGLContext::resetDrawStats()
+struct DrawStats {
+    int drawCalls;
+    qint64 triangles;
+
+    DrawStats() : drawCalls(0), triangles(0) {}
+};
 
 
 class OpenGLContext
@@ -18,4 +28,31 @@ public:
     void printGLErrorLog();
     void printLinkInfoLog(int prog);
     void printShaderInfoLog(int shader);
+
+    // glUseProgram, skipped if prog is already the program in use
+    void useProgram(GLuint prog);
+
+    // glMultiDrawElementsBaseVertex is core since OpenGL 3.2 but isn't part
+    // of QOpenGLExtraFunctions. Falls back to one glDrawElementsBaseVertex
+    // per draw if the context doesn't provide it.
+    void multiDrawElementsBaseVertex(GLenum mode, const GLsizei *count, GLenum type,
+                                     const void *const *indices, GLsizei drawCount, const GLint *baseVertex);
+
+    // Counts one draw call of count vertices in the given mode towards
+    // getDrawStats(). multiDrawElementsBaseVertex counts itself.
+    void countDraw(GLenum mode, qint64 count);
+    void resetDrawStats();
+    DrawStats getDrawStats() const;
+
+    // The framebuffer frames end up in: the widget's own, or the one
+    // given to setScreenFramebuffer when rendering without a window
+    GLuint screenFramebuffer() const;
+    void setScreenFramebuffer(GLuint framebuffer);
+
+private:
+    GLuint m_currentProgram;
+    QOpenGLFunctions_3_3_Core *mp_functions33;
+    bool m_functions33Resolved;
+    DrawStats m_drawStats;
+    std::optional<GLuint> m_screenFramebuffer;
 };
@@ -36,3 +36,22 @@ void PlayerInfo::slot_setZoneText(QString s) {
     ui->zoneLabel->setText(s);
 }
 
+void PlayerInfo::slot_setDrawnText(QString s) {
+    ui->drawnLabel->setText(s);
+}
+
+void PlayerInfo::slot_setGPUMemoryText(QString s) {
+    ui->gpuMemoryLabel->setText(s);
+}
+
+void PlayerInfo::slot_setFrameTimeText(QString s) {
+    ui->frameTimeLabel->setText(s);
+}
+
+void PlayerInfo::slot_setFrameStagesText(QString s) {
+    ui->frameStagesLabel->setText(s);
+}
+
+void PlayerInfo::slot_setFrameGraph(QList<float> frameMs, QList<float> gpuMs) {
+    ui->frameGraph->setTimes(frameMs, gpuMs);
+}
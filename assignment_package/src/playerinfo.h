@@ -2,6 +2,7 @@
 #define PLAYERINFO_H
 
 #include <QWidget>
+#include <QList>
 
 namespace Ui {
 class PlayerInfo;
@@ -20,6 +21,11 @@ public slots:
     void slot_setLookText(QString);
     void slot_setChunkText(QString);
     void slot_setZoneText(QString);
+    void slot_setDrawnText(QString);
+    void slot_setGPUMemoryText(QString);
+    void slot_setFrameTimeText(QString);
+    void slot_setFrameStagesText(QString);
+    void slot_setFrameGraph(QList<float> frameMs, QList<float> gpuMs);
 
 private:
     Ui::PlayerInfo *ui;
@@ -0,0 +1,69 @@
+#include "postchain.h"
+
+namespace {
+// The texture slot the scene buffer is read from
+const unsigned int SCENE_TEXTURE_SLOT = 1;
+
+// Defined in post.frag.glsl for every active pass, in the order of the bits of PostPass
+const char *PASS_DEFINES[POST_PASS_COUNT] = {"UNDERWATER", "LAVA"};
+}
+
+PostChain::PostChain(OpenGLContext *context, unsigned int width, unsigned int height, unsigned int devicePixelRatio)
+    : mp_context(context), m_sceneBuffer(context, width, height, devicePixelRatio),
+      m_programs(), m_passes(0)
+{}
+
+void PostChain::create() {
+    for (unsigned int mask = 1; mask < m_programs.size(); mask++) {
+        QString defines;
+        for (int i = 0; i < POST_PASS_COUNT; i++) {
+            if (mask & (1u << i)) {
+                defines += QString("#define %1\n").arg(PASS_DEFINES[i]);
+            }
+        }
+        m_programs[mask] = mkU<ShaderProgram>(mp_context);
+        m_programs[mask]->create(":/glsl/post.vert.glsl", ":/glsl/post.frag.glsl", defines);
+    }
+    m_sceneBuffer.create();
+}
+
+void PostChain::destroy() {
+    m_sceneBuffer.destroy();
+}
+
+void PostChain::resize(unsigned int width, unsigned int height, unsigned int devicePixelRatio) {
+    m_sceneBuffer.resize(width, height, devicePixelRatio);
+    m_sceneBuffer.destroy();
+    m_sceneBuffer.create();
+}
+
+void PostChain::clearPasses() {
+    m_passes = 0;
+}
+
+void PostChain::addPass(PostPass pass) {
+    m_passes |= pass;
+}
+
+bool PostChain::hasPasses() const {
+    return m_passes != 0;
+}
+
+void PostChain::bindSceneTarget() {
+    if (hasPasses()) {
+        m_sceneBuffer.bindFrameBuffer();
+    } else {
+        mp_context->glBindFramebuffer(GL_FRAMEBUFFER, mp_context->screenFramebuffer());
+    }
+}
+
+void PostChain::apply(Drawable &quad) {
+    if (!hasPasses()) {
+        return;
+    }
+    mp_context->glBindFramebuffer(GL_FRAMEBUFFER, mp_context->screenFramebuffer());
+    // Every pixel is overwritten, so only the depth needs clearing
+    mp_context->glClear(GL_DEPTH_BUFFER_BIT);
+    m_sceneBuffer.bindToTextureSlot(SCENE_TEXTURE_SLOT);
+    m_programs[m_passes]->draw(quad, SCENE_TEXTURE_SLOT);
+}
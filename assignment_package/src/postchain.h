@@ -0,0 +1,50 @@
+#pragma once
+#include "openglcontext.h"
+#include "framebuffer.h"
+#include "shaderprogram.h"
+#include "smartpointerhelp.h"
+#include <array>
+
+// The screen effects the PostChain can apply, as bits of a mask
+enum PostPass : unsigned int {
+    POST_UNDERWATER = 1 << 0, // Blue tint while the camera is in WATER
+    POST_LAVA       = 1 << 1, // Red tint while the camera is in LAVA
+};
+#define POST_PASS_COUNT 2
+
+// Screen effects applied to the rendered scene. Passes are added every
+// frame only while they're active, and all of them are applied at once
+// by a single full-screen draw: post.frag.glsl is compiled once for every
+// combination of passes, each with the #defines of its passes.
+// While no pass is active the scene is drawn straight to the screen,
+// skipping the extra full-screen write and read of the scene buffer.
+class PostChain {
+private:
+    OpenGLContext *mp_context;
+    // Where the scene is drawn while any pass is active
+    FrameBuffer m_sceneBuffer;
+    // The fused program for every mask of passes, indexed by the mask.
+    // Mask 0 never draws and has none.
+    std::array<uPtr<ShaderProgram>, 1 << POST_PASS_COUNT> m_programs;
+    unsigned int m_passes; // Mask of the passes added this frame
+
+public:
+    PostChain(OpenGLContext *context, unsigned int width, unsigned int height, unsigned int devicePixelRatio);
+    // Compiles the fused programs and creates the scene buffer
+    void create();
+    void destroy();
+    // Call from MyGL::resizeGL to keep the scene buffer the size of the screen
+    void resize(unsigned int width, unsigned int height, unsigned int devicePixelRatio);
+
+    // Removes every pass, at the start of a frame
+    void clearPasses();
+    void addPass(PostPass pass);
+    bool hasPasses() const;
+    // Binds the frame buffer the scene should be drawn into this frame:
+    // the scene buffer if any pass is active, the screen otherwise.
+    // Add this frame's passes first.
+    void bindSceneTarget();
+    // Draws the scene buffer to the screen through the fused program of
+    // the active passes. Does nothing if there are none.
+    void apply(Drawable &quad);
+};
@@ -0,0 +1,185 @@
+#include "renderbenchmark.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Seconds the initial terrain may take to load before run() gives up
+const float MAX_LOADING_SECONDS = 300.f;
+
+struct FrameResult {
+    ProfileSample profile; // frameMs is the whole of renderFrameAt
+    DrawStats draws;
+};
+
+// How Player::setPose has to turn the camera, from facing -Z, to look
+// along dir and CAMERA_TILT below it
+glm::vec2 orientationAlong(glm::vec3 dir) {
+    return glm::vec2(glm::degrees(std::atan2(-dir.x, -dir.z)),
+                     glm::degrees(std::asin(glm::clamp(dir.y, -1.f, 1.f))) - RenderBenchmark::CAMERA_TILT);
+}
+
+void printDistribution(const char *name, const std::vector<float> &values) {
+    if (values.empty()) {
+        printf("  %-18s        -\n", name);
+        return;
+    }
+    float total = 0.f;
+    for (float v : values) {
+        total += v;
+    }
+    printf("  %-18s %10.3f %10.3f %10.3f %10.3f %10.3f\n", name, total / values.size(),
+           percentile(values, 0.5f), percentile(values, 0.95f), percentile(values, 0.99f), percentile(values, 1.f));
+}
+
+QString columnName(int stage) {
+    return QString(profileStageName(ProfileStage(stage))).replace(' ', '_');
+}
+
+bool writeCSV(const QString &path, const std::vector<FrameResult> &results) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    out << "frame,frame_ms,draw_calls,triangles";
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        out << "," << columnName(i) << "_cpu_ms";
+    }
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        out << "," << columnName(i) << "_gpu_ms";
+    }
+    out << "\n";
+    for (size_t f = 0; f < results.size(); f++) {
+        const FrameResult &r = results[f];
+        out << f << "," << r.profile.frameMs << "," << r.draws.drawCalls << "," << r.draws.triangles;
+        for (float ms : r.profile.cpuMs) {
+            out << "," << ms;
+        }
+        // Left empty for stages that aren't timed on the GPU
+        for (float ms : r.profile.gpuMs) {
+            out << ",";
+            if (ms >= 0.f) {
+                out << ms;
+            }
+        }
+        out << "\n";
+    }
+    return true;
+}
+}
+
+RenderBenchmark::RenderBenchmark()
+    : m_surface(), m_context(), mp_target(), mp_gl()
+{}
+
+bool RenderBenchmark::create(QSize size, QString *error) {
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    m_surface.setFormat(format);
+    m_surface.create();
+    m_context.setFormat(format);
+    if (!m_surface.isValid() || !m_context.create() || !m_context.makeCurrent(&m_surface)) {
+        *error = "couldn't make an OpenGL context on an offscreen surface";
+        return false;
+    }
+
+    // Initialized right away, as ~MyGL frees its GL data
+    mp_gl = mkU<MyGL>();
+    // Never shown, so the size is only what resizeGL and paintGL read
+    mp_gl->resize(size);
+    mp_gl->initializeGL();
+    QSize pixels = size * mp_gl->devicePixelRatio();
+    mp_target = mkU<QOpenGLFramebufferObject>(pixels, QOpenGLFramebufferObject::CombinedDepthStencil);
+    if (!mp_target->isValid()) {
+        *error = QString("couldn't make a %1x%2 framebuffer object").arg(pixels.width()).arg(pixels.height());
+        return false;
+    }
+    mp_gl->setScreenFramebuffer(mp_target->handle());
+    mp_gl->resizeGL(size.width(), size.height());
+    return true;
+}
+
+MyGL& RenderBenchmark::gl() {
+    return *mp_gl;
+}
+
+bool RenderBenchmark::run(const CameraSpline &path, const BenchmarkSettings &settings, QString *error) {
+    QOpenGLFunctions *f = m_context.functions();
+    printf("Renderer: %s, OpenGL %s\n", reinterpret_cast<const char*>(f->glGetString(GL_RENDERER)),
+           reinterpret_cast<const char*>(f->glGetString(GL_VERSION)));
+
+    // The camera waits at the start of the path while the terrain loads
+    glm::vec3 start = path.position(0.f);
+    glm::vec2 startOrientation = orientationAlong(path.direction(0.f));
+    QElapsedTimer clock;
+    clock.start();
+    while (!mp_gl->isInitialTerrainLoaded()) {
+        if (clock.elapsed() > MAX_LOADING_SECONDS * 1000.f) {
+            *error = "the terrain around the start of the path didn't load";
+            return false;
+        }
+        mp_gl->renderFrameAt(start, startOrientation);
+    }
+    printf("Loaded the terrain around the start of the path in %.2f s\n", clock.elapsed() / 1000.0);
+
+    std::vector<FrameResult> results;
+    results.reserve(settings.frames);
+    for (int i = 0; i < settings.frames; i++) {
+        float distance = i * MyGL::SIMULATION_STEP * settings.speed;
+        clock.restart();
+        FrameResult r;
+        r.profile = mp_gl->renderFrameAt(path.position(distance), orientationAlong(path.direction(distance)));
+        r.profile.frameMs = clock.nsecsElapsed() * 1e-6f;
+        r.draws = mp_gl->getDrawStats();
+        results.push_back(r);
+    }
+
+    float flown = settings.frames * MyGL::SIMULATION_STEP * settings.speed;
+    printf("Rendered %d frames at %dx%d, flying %.0f blocks of a %.0f block path at %g blocks/s\n",
+           settings.frames, mp_target->width(), mp_target->height(), flown, path.length(), settings.speed);
+    printf("\n  %-18s %10s %10s %10s %10s %10s\n", "", "mean", "p50", "p95", "p99", "max");
+    std::vector<float> frameMs, drawCalls, triangles;
+    for (const FrameResult &r : results) {
+        frameMs.push_back(r.profile.frameMs);
+        drawCalls.push_back(r.draws.drawCalls);
+        triangles.push_back(r.draws.triangles / 1000.f);
+    }
+    printDistribution("frame ms", frameMs);
+    printDistribution("draw calls", drawCalls);
+    printDistribution("triangles (k)", triangles);
+
+    printf("\nStage times in ms (mean / p95); GPU only where timer queries are supported\n");
+    printf("  %-18s %10s %10s %10s %10s\n", "stage", "cpu mean", "cpu p95", "gpu mean", "gpu p95");
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        std::vector<float> cpu, gpu;
+        for (const FrameResult &r : results) {
+            cpu.push_back(r.profile.cpuMs[i]);
+            if (r.profile.gpuMs[i] >= 0.f) {
+                gpu.push_back(r.profile.gpuMs[i]);
+            }
+        }
+        float cpuTotal = 0.f, gpuTotal = 0.f;
+        for (float ms : cpu) {
+            cpuTotal += ms;
+        }
+        for (float ms : gpu) {
+            gpuTotal += ms;
+        }
+        printf("  %-18s %10.3f %10.3f", profileStageName(ProfileStage(i)),
+               cpu.empty() ? 0.f : cpuTotal / cpu.size(), percentile(cpu, 0.95f));
+        if (gpu.empty()) {
+            printf(" %10s %10s\n", "-", "-");
+        } else {
+            printf(" %10.3f %10.3f\n", gpuTotal / gpu.size(), percentile(gpu, 0.95f));
+        }
+    }
+    fflush(stdout);
+
+    if (!settings.csvPath.isEmpty() && !writeCSV(settings.csvPath, results)) {
+        *error = "couldn't write " + settings.csvPath;
+        return false;
+    }
+    return true;
+}
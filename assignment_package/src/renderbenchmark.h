@@ -0,0 +1,54 @@
+#pragma once
+#include "mygl.h"
+#include "scene/cameraspline.h"
+#include "smartpointerhelp.h"
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QSize>
+
+// What a RenderBenchmark run renders, from the --benchmark options
+struct BenchmarkSettings {
+    int frames;
+    float speed;     // Blocks per second the camera flies along the path
+    QString csvPath; // Where every frame's results are written, nowhere if empty
+
+    BenchmarkSettings() : frames(600), speed(15.f), csvPath() {}
+};
+
+// Renders frames through MyGL::paintGL() with no window, flying the
+// camera along a CameraSpline, then prints the frame times, draw calls,
+// triangles and the CPU and, where timer queries are supported, GPU
+// time of every stage.
+// The context is made on a QOffscreenSurface and MyGL draws into a
+// framebuffer object, so nothing is ever shown. Run with
+// QT_QPA_PLATFORM=offscreen, and LIBGL_ALWAYS_SOFTWARE=1 to use Mesa's
+// software rasterizer on machines without a GPU; without a display,
+// under xvfb-run.
+class RenderBenchmark {
+private:
+    QOffscreenSurface m_surface;
+    QOpenGLContext m_context;
+    uPtr<QOpenGLFramebufferObject> mp_target;
+    // Declared last so it is destroyed first, while m_context is current
+    uPtr<MyGL> mp_gl;
+
+public:
+    // Degrees the camera looks down from the direction of travel, so
+    // most of the frame is terrain
+    static constexpr float CAMERA_TILT = 15.f;
+
+    RenderBenchmark();
+
+    // Makes the context and a MyGL rendering size pixels into mp_target.
+    // Returns false and sets error if there is no usable OpenGL context.
+    bool create(QSize size, QString *error);
+    // The MyGL that renders, to set up the world with before run()
+    MyGL& gl();
+
+    // Loads the terrain around the start of path without timing it, then
+    // renders settings.frames frames along it and prints the results.
+    // Returns false and sets error if the terrain doesn't load or the
+    // CSV file can't be written.
+    bool run(const CameraSpline &path, const BenchmarkSettings &settings, QString *error);
+};
@@ -0,0 +1,127 @@
+#include "cameraspline.h"
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+CameraSpline::CameraSpline(const std::vector<glm::vec3> &points)
+    : m_points(points), m_distances()
+{
+    int segments = int(m_points.size());
+    m_distances.reserve(segments * SAMPLES_PER_SEGMENT + 1);
+    m_distances.push_back(0.f);
+    glm::vec3 prev = m_points[0];
+    for (int i = 0; i < segments; i++) {
+        for (int s = 1; s <= SAMPLES_PER_SEGMENT; s++) {
+            glm::vec3 p = evaluate(i, s / float(SAMPLES_PER_SEGMENT));
+            m_distances.push_back(m_distances.back() + glm::distance(prev, p));
+            prev = p;
+        }
+    }
+}
+
+glm::vec3 CameraSpline::evaluate(int i, float u) const {
+    int n = int(m_points.size());
+    const glm::vec3 &p0 = m_points[(i + n - 1) % n];
+    const glm::vec3 &p1 = m_points[i % n];
+    const glm::vec3 &p2 = m_points[(i + 1) % n];
+    const glm::vec3 &p3 = m_points[(i + 2) % n];
+    float u2 = u * u, u3 = u2 * u;
+    return 0.5f * (2.f * p1 + (p2 - p0) * u +
+                   (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * u2 +
+                   (3.f * p1 - p0 - 3.f * p2 + p3) * u3);
+}
+
+void CameraSpline::locate(float distance, int *segment, float *u) const {
+    float lap = length();
+    distance = lap > 0.f ? distance - lap * std::floor(distance / lap) : 0.f;
+    // The first sample past distance, and the one before it
+    size_t next = std::upper_bound(m_distances.begin(), m_distances.end(), distance) - m_distances.begin();
+    next = std::min(std::max(next, size_t(1)), m_distances.size() - 1);
+    float d0 = m_distances[next - 1], d1 = m_distances[next];
+    float t = d1 > d0 ? (distance - d0) / (d1 - d0) : 0.f;
+    int sample = int(next - 1);
+    *segment = sample / SAMPLES_PER_SEGMENT;
+    *u = (sample % SAMPLES_PER_SEGMENT + t) / SAMPLES_PER_SEGMENT;
+}
+
+bool CameraSpline::builtIn(const QString &name, glm::vec3 center, std::vector<glm::vec3> *points) {
+    points->clear();
+    if (name == "orbit") {
+        const int count = 12;
+        for (int i = 0; i < count; i++) {
+            float a = 2.f * glm::pi<float>() * i / count;
+            // Bobs up and down to look at the terrain from a few heights
+            points->push_back(center + glm::vec3(96.f * std::cos(a), 12.f * std::sin(3.f * a), 96.f * std::sin(a)));
+        }
+    } else if (name == "flyover") {
+        // Out along +X and back 192 blocks over, weaving and climbing a little
+        for (int i = 0; i <= 4; i++) {
+            points->push_back(center + glm::vec3(224.f * i, 16.f * (i % 2), 48.f * (i % 2 ? 1 : -1)));
+        }
+        for (int i = 4; i >= 0; i--) {
+            points->push_back(center + glm::vec3(224.f * i + 112.f, 24.f * (i % 2), 192.f));
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QStringList CameraSpline::builtInNames() {
+    return QStringList{"orbit", "flyover"};
+}
+
+bool CameraSpline::load(const QString &path, std::vector<glm::vec3> *points, QString *error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *error = file.errorString();
+        return false;
+    }
+    points->clear();
+    QTextStream in(&file);
+    int lineNumber = 0;
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        lineNumber++;
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        QStringList fields = line.split(' ', Qt::SkipEmptyParts);
+        glm::vec3 p;
+        bool ok = fields.size() == 3;
+        for (int i = 0; ok && i < 3; i++) {
+            p[i] = fields[i].toFloat(&ok);
+        }
+        if (!ok) {
+            *error = QString("line %1 isn't \"x y z\"").arg(lineNumber);
+            return false;
+        }
+        points->push_back(p);
+    }
+    if (points->size() < 2) {
+        *error = "a path needs at least two points";
+        return false;
+    }
+    return true;
+}
+
+float CameraSpline::length() const {
+    return m_distances.back();
+}
+
+glm::vec3 CameraSpline::position(float distance) const {
+    int segment;
+    float u;
+    locate(distance, &segment, &u);
+    return evaluate(segment, u);
+}
+
+glm::vec3 CameraSpline::direction(float distance) const {
+    // A central difference is all a camera needs
+    const float step = 0.5f;
+    glm::vec3 d = position(distance + step) - position(distance - step);
+    float len = glm::length(d);
+    return len > 0.f ? d / len : glm::vec3(0, 0, -1);
+}
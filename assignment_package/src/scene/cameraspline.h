@@ -0,0 +1,46 @@
+#pragma once
+#include "glm_includes.h"
+#include <QString>
+#include <QStringList>
+#include <vector>
+
+// A closed Catmull-Rom spline through control points, for flying the
+// camera along the same path on every run. Points along it are found by
+// their distance from the first control point, so a path is flown at a
+// steady speed however unevenly its control points are spaced.
+class CameraSpline {
+private:
+    std::vector<glm::vec3> m_points;
+    // Distance along the spline at every SAMPLES_PER_SEGMENT-th of each
+    // segment, starting with 0 at the first control point
+    std::vector<float> m_distances;
+
+    // The point u of the way along segment i, from m_points[i] to m_points[i + 1]
+    glm::vec3 evaluate(int i, float u) const;
+    // The segment and how far along it the point at distance is
+    void locate(float distance, int *segment, float *u) const;
+
+public:
+    static constexpr int SAMPLES_PER_SEGMENT = 32;
+
+    // Needs at least two points
+    explicit CameraSpline(const std::vector<glm::vec3> &points);
+
+    // A path that comes with the game, placed around center:
+    //   "orbit"    circles center 96 blocks out, keeping mostly the same terrain in range
+    //   "flyover"  a 2 km loop, streaming new terrain in all the way
+    // Returns false if there is no path called name.
+    static bool builtIn(const QString &name, glm::vec3 center, std::vector<glm::vec3> *points);
+    static QStringList builtInNames();
+    // Reads control points from a text file with one "x y z" per line.
+    // Blank lines and lines starting with # are skipped. Returns false if
+    // the file can't be read or has fewer than two points.
+    static bool load(const QString &path, std::vector<glm::vec3> *points, QString *error);
+
+    // Length of one lap
+    float length() const;
+    // The point distance along the spline, wrapping around after a lap
+    glm::vec3 position(float distance) const;
+    // The unit direction of travel at distance
+    glm::vec3 direction(float distance) const;
+};
@@ -1,15 +1,28 @@
 #include "chunk.h"
 #include "noise_functions.h"
+#include <algorithm>
 #include <iostream>
 
-Chunk::Chunk(OpenGLContext* mp_context) : Drawable(mp_context), m_blocks(), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}}, m_vboData(this)
+Chunk::Chunk(OpenGLContext* mp_context) : Drawable(mp_context), m_blocks(), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
+    m_count2(-1), mp_arena(nullptr), m_allocOpaque(), m_allocTransparent(),
+    m_heightMap(), m_waterColumns(), m_hasIce(false), m_hasSand(false), m_stored(false), m_noiseOffset(0, 0),
+    m_meshMinY(0), m_meshMaxY(256),
+    m_sectionIdxOpaque(), m_sectionIdxTransparent(), m_sectionConnectivity(),
+    mp_transparentFaceCenters(mkS<std::vector<glm::vec3>>()), m_meshVersion(0),
+    m_sortEye(0.f), m_sorted(false), m_sortPending(false), m_sectionBlocks(), m_vboData(this)
 {
     std::fill_n(m_blocks.begin(), 65536, EMPTY);
 }
 
-Chunk::Chunk(OpenGLContext* mp_context, int x, int z) :
+Chunk::Chunk(OpenGLContext* mp_context, int x, int z, unsigned int seed, ChunkArena *arena) :
     Drawable(mp_context), m_blocks(), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
-    m_pos(glm::ivec2(x, z)), m_vboData(this)
+    m_pos(glm::ivec2(x, z)),
+    m_count2(-1), mp_arena(arena), m_allocOpaque(), m_allocTransparent(),
+    m_heightMap(), m_waterColumns(), m_hasIce(false), m_hasSand(false), m_stored(false), m_noiseOffset(seedOffset(seed)),
+    m_meshMinY(0), m_meshMaxY(256),
+    m_sectionIdxOpaque(), m_sectionIdxTransparent(), m_sectionConnectivity(),
+    mp_transparentFaceCenters(mkS<std::vector<glm::vec3>>()), m_meshVersion(0),
+    m_sortEye(0.f), m_sorted(false), m_sortPending(false), m_sectionBlocks(), m_vboData(this)
 {
     std::fill_n(m_blocks.begin(), 65536, EMPTY);
 }
@@ -26,7 +39,62 @@ BlockType Chunk::getBlockAt(int x, int y, int z) const {
 
 // Does bounds checking with at()
 void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-    m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+    BlockType &b = m_blocks.at(x + 16 * y + 16 * 256 * z);
+    if ((b == EMPTY) != (t == EMPTY)) {
+        m_sectionBlocks[y / 16] += t == EMPTY ? -1 : 1;
+    }
+    b = t;
+}
+
+void Chunk::fillColumn(int x, int z, int yBegin, int yEnd, BlockType t) {
+    if (x < 0 || x >= 16 || z < 0 || z >= 16) {
+        return;
+    }
+    yBegin = glm::max(yBegin, 0);
+    yEnd = glm::min(yEnd, 256);
+    // Consecutive blocks of a column are 16 apart
+    BlockType *b = &m_blocks[x + 16 * 256 * z];
+    for (int y = yBegin; y < yEnd;) {
+        int sectionEnd = glm::min(yEnd, (y / 16 + 1) * 16);
+        int empty = 0;
+        for (int i = y; i < sectionEnd; i++) {
+            empty += b[16 * i] == EMPTY;
+            b[16 * i] = t;
+        }
+        m_sectionBlocks[y / 16] += t == EMPTY ? empty - (sectionEnd - y) : empty;
+        y = sectionEnd;
+    }
+}
+
+void Chunk::fillBox(glm::ivec3 min, glm::ivec3 max, BlockType t) {
+    min = glm::max(min, glm::ivec3(0));
+    max = glm::min(max, glm::ivec3(16, 256, 16));
+    int width = max.x - min.x;
+    if (width <= 0) {
+        return;
+    }
+    // Rows along x are contiguous, so each is a single fill
+    for (int z = min.z; z < max.z; z++) {
+        for (int y = min.y; y < max.y; y++) {
+            BlockType *row = &m_blocks[min.x + 16 * y + 16 * 256 * z];
+            int empty = static_cast<int>(std::count(row, row + width, EMPTY));
+            std::fill_n(row, width, t);
+            m_sectionBlocks[y / 16] += t == EMPTY ? empty - width : empty;
+        }
+    }
+}
+
+int Chunk::getSectionBlockCount(int section) const {
+    return m_sectionBlocks[section];
+}
+
+int Chunk::getTopSection() const {
+    for (int s = CHUNK_SECTIONS - 1; s >= 0; s--) {
+        if (m_sectionBlocks[s] > 0) {
+            return s + 1;
+        }
+    }
+    return 0;
 }
 
 const static std::unordered_map<Direction, Direction, EnumHash> oppositeDirection {
@@ -45,6 +113,55 @@ void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
     }
 }
 
+void Chunk::unlinkNeighbors() {
+    for (auto &kv : m_neighbors) {
+        if (kv.second != nullptr) {
+            kv.second->m_neighbors[oppositeDirection.at(kv.first)] = nullptr;
+            kv.second = nullptr;
+        }
+    }
+}
+
+const std::array<BlockType, 65536>& Chunk::getBlocks() const {
+    return m_blocks;
+}
+
+void Chunk::setBlocks(const std::array<BlockType, 65536> &blocks) {
+    m_blocks = blocks;
+    m_sectionBlocks.fill(0);
+    for (int i = 0; i < 65536; i++) {
+        if (m_blocks[i] != EMPTY) {
+            // Blocks are stored x + 16 * y + 16 * 256 * z
+            m_sectionBlocks[(i / 16) % 256 / 16]++;
+        }
+    }
+}
+
+const std::array<int, 256>& Chunk::getHeightMap() const {
+    return m_heightMap;
+}
+
+void Chunk::setHeightMap(const std::array<int, 256> &heightMap) {
+    m_heightMap = heightMap;
+}
+
+bool Chunk::hasIce() const {
+    return m_hasIce;
+}
+
+bool Chunk::hasSand() const {
+    return m_hasSand;
+}
+
+void Chunk::setSurfaceFlags(bool hasIce, bool hasSand) {
+    m_hasIce = hasIce;
+    m_hasSand = hasSand;
+}
+
+void Chunk::markStored() {
+    m_stored = true;
+}
+
 // Helper function that check if BlockType is empty
 // Note: LAVA is set to be transparent becaue we want player to swim in it
 bool Chunk::isOpaque(BlockType t) {
@@ -115,28 +232,47 @@ int Chunk::elemCount2() {
     return m_count2;
 }
 
-void Chunk::generateIdx2() {
-    m_idx2Generated = true;
-    mp_context->glGenBuffers(1, &m_bufIdx2);
-}
-
-void Chunk::generatePos2() {
-    m_pos2Generated = true;
-    mp_context->glGenBuffers(1, &m_bufPos2);
-}
-
-bool Chunk::bindIdx2() {
-    if (m_idx2Generated) {
-        mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx2);
-    }
-    return m_idx2Generated;
-}
-
-bool Chunk::bindPos2() {
-    if (m_pos2Generated) {
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPos2);
+unsigned short Chunk::computeSectionConnectivity(int section) {
+    int baseY = section * 16;
+    unsigned short connectivity = 0;
+    std::array<bool, 4096> visited{};
+    std::vector<glm::ivec3> stack;
+    for (int start = 0; start < 4096; start++) {
+        glm::ivec3 p(start % 16, start / 256, (start / 16) % 16);
+        if (visited[start] || isOpaque(getBlockAt(p.x, baseY + p.y, p.z))) {
+            continue;
+        }
+        // Flood fill one connected region, noting every face it touches
+        unsigned char faces = 0;
+        visited[start] = true;
+        stack.push_back(p);
+        while (!stack.empty()) {
+            glm::ivec3 c = stack.back();
+            stack.pop_back();
+            faces |= (c.x == 15) << XPOS | (c.x == 0) << XNEG |
+                     (c.y == 15) << YPOS | (c.y == 0) << YNEG |
+                     (c.z == 15) << ZPOS | (c.z == 0) << ZNEG;
+            for (auto &&face : adjacentFaces) {
+                glm::ivec3 n = c + glm::ivec3(face.directionVec);
+                if (n.x < 0 || n.x >= 16 || n.y < 0 || n.y >= 16 || n.z < 0 || n.z >= 16) {
+                    continue;
+                }
+                int i = n.x + 16 * n.z + 256 * n.y;
+                if (!visited[i] && !isOpaque(getBlockAt(n.x, baseY + n.y, n.z))) {
+                    visited[i] = true;
+                    stack.push_back(n);
+                }
+            }
+        }
+        for (int a = 0; a < 6; a++) {
+            for (int b = a + 1; b < 6; b++) {
+                if ((faces >> a & 1) && (faces >> b & 1)) {
+                    connectivity |= 1 << facePairBit(Direction(a), Direction(b));
+                }
+            }
+        }
     }
-    return m_pos2Generated;
+    return connectivity;
 }
 
 void Chunk::createVBOdata() {
@@ -145,9 +281,16 @@ void Chunk::createVBOdata() {
     std::vector<GLuint> idx, idx2;
 
     unsigned count = 0, count2 = 0;
-    for (int x = 0; x < 16; x++) {
-        for (int z = 0; z < 16; z++) {
-            for (int y = 0; y < 256; y++) {
+    int minY = 256, maxY = 0;
+    // Mesh one section at a time so each section's faces are contiguous
+    for (int y = 0; y < 256; y++) {
+        if (y % 16 == 0) {
+            m_vboData.m_sectionIdxOpaque[y / 16] = idx.size();
+            m_vboData.m_sectionIdxTransparent[y / 16] = idx2.size();
+            m_vboData.m_sectionConnectivity[y / 16] = computeSectionConnectivity(y / 16);
+        }
+        for (int x = 0; x < 16; x++) {
+            for (int z = 0; z < 16; z++) {
                 BlockType currType = getBlockAt(x, y, z);
                 if (currType != EMPTY) {
                     auto &&bufUsing = isOpaque(currType) ? interleaved : interleaved2;
@@ -178,11 +321,13 @@ void Chunk::createVBOdata() {
                             }
                         }
                         if (canRender) {
+                            minY = std::min(minY, y);
+                            maxY = std::max(maxY, y + 1);
                             for (auto &&vd : neighborFace.vertices) {
                                 // Store all the per-vertex data in an interleaved format in a single VBO
                                 // (except for indices, which must be stored in a separate buffer)
                                 // position
-                                bufUsing.push_back(glm::vec4(x, y, z, 1) + vd.pos);
+                                bufUsing.push_back(glm::vec4(m_pos.x + x, y, m_pos.y + z, 1) + vd.pos);
                                 // normal
                                 bufUsing.push_back(glm::vec4(neighborFace.directionVec, 0));
                                 // color
@@ -203,40 +348,80 @@ void Chunk::createVBOdata() {
             }
         }
     }
+    m_vboData.m_sectionIdxOpaque[CHUNK_SECTIONS] = idx.size();
+    m_vboData.m_sectionIdxTransparent[CHUNK_SECTIONS] = idx2.size();
     // opaque
     this->m_vboData.m_vboDataOpaque = interleaved;
     this->m_vboData.m_idxDataOpaque = idx;
     // transparent
     this->m_vboData.m_vboDataTransparent = interleaved2;
     this->m_vboData.m_idxDataTransparent = idx2;
+    this->m_vboData.m_minY = minY;
+    this->m_vboData.m_maxY = maxY;
 }
 
-void Chunk::fillChunk() {
-    int x = m_pos.x;
-    int z = m_pos.y;
-    // To decide where and what to draw for assets
-    int maxHeight = 0;
-    bool isIce = false;
-    bool isSand = false;
-    // Populate blocks by x, z coordinates
+void Chunk::runGenerationStage(GenerationStage stage, const BiomeBlend &blend) {
+    if (m_stored && stage != DECORATION) {
+        return;
+    }
+    switch (stage) {
+        case HEIGHTFIELD:
+            generateHeightfield(blend);
+            break;
+        case CAVES:
+            generateCaves();
+            break;
+        case SURFACE:
+            generateSurface();
+            break;
+        case DECORATION:
+            generateDecoration();
+            break;
+        case FLUIDS:
+            generateFluids();
+            break;
+        default:
+            break;
+    }
+}
+
+// Computes the terrain height of every column from the biome noise
+void Chunk::generateHeightfield(const BiomeBlend &blend) {
     for (int i = 0; i < 16; i++) {
         for (int j = 0; j < 16; j++) {
-            glm::vec2 pos(i + x, j + z);
-            glm::vec2 eleMoi = eleMoiValue(pos/128.f);
+            glm::vec2 pos(i + m_pos.x + m_noiseOffset.x, j + m_pos.y + m_noiseOffset.y);
+            float elevation = elevationValue(pos/128.f);
+            m_heightMap[i + 16 * j] = blendedHeight(pos, elevation, blend);
+        }
+    }
+}
 
-            // cave
-            setBlockAt(i,0,j,BEDROCK);
+// Carves the Perlin caves out of the stone below the surface layer.
+// The lava at the bottom of the caves is left to generateFluids.
+void Chunk::generateCaves() {
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) {
+            setBlockAt(i, 0, j, BEDROCK);
             for (int y = 1; y <= 95; y++) {
-                if (perlinNoise(glm::vec3(x + i, y, z + j) / 10.f) > 0) {
+                if (perlinNoise(glm::vec3(m_pos.x + m_noiseOffset.x + i, y, m_pos.y + m_noiseOffset.y + j) / 10.f) > 0) {
                     setBlockAt(i, y, j, STONE);
-                } else {
-                    if (y < 25) {
-                        setBlockAt(i, y, j, LAVA);
-                    } else {
-                        setBlockAt(i, y, j, EMPTY);
-                    }
                 }
             }
+        }
+    }
+}
+
+// Picks each column's biome from moisture and temperature and fills
+// it from the top of the cave layer up to the heightfield
+void Chunk::generateSurface() {
+    m_hasIce = false;
+    m_hasSand = false;
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) {
+            glm::vec2 pos(i + m_pos.x + m_noiseOffset.x, j + m_pos.y + m_noiseOffset.y);
+            int height = m_heightMap[i + 16 * j];
+            m_waterColumns[i + 16 * j] = false;
+
             float pi = 3.14159f;
             float moist = moisture(glm::vec2(pos[0] * cos(pi * 0.25) - sin(pi * 0.25) * pos[1],
                                              pos[0] * sin(pi * 0.25) + cos(pi * 0.25) * pos[1]) / 1000.f);
@@ -248,8 +433,6 @@ void Chunk::fillChunk() {
             temperature = 0.5 * (temperature + 1);
             float s = glm::smoothstep(0.4f, 0.75f, moist);
             float t = glm::smoothstep(0.4f, 0.75f, temperature);
-            int height = glm::mix(grasslandValue(pos), mountainValue(pos), eleMoi[0]);
-            maxHeight = max(height, maxHeight);
             float threshold = 0.3;
             if (s > threshold && t > threshold) {
                 for (int y = 96; y <= height; ++y) {
@@ -269,49 +452,111 @@ void Chunk::fillChunk() {
                 if (height > 138) {
                     if (height <= 143) {
                         setBlockAt(i, height, j, ICE);
-                        if (!isIce) {
-                            isIce = true;
-                        }
+                        m_hasIce = true;
                     } else {
                         setBlockAt(i, height, j, GRASS);
                     }
                 } else {
-                    for (int y = height; y <= 138; y++) {
-                        setBlockAt(i, y, j, WATER);
-                    }
+                    // Flooded by generateFluids
+                    m_waterColumns[i + 16 * j] = true;
                 }
             } else if(s > threshold && t < threshold) {
                 for (int y = 96; y < height; y++) {
                     setBlockAt(i, y, j, ICE);
-                    if (!isIce) {
-                        isIce = true;
-                    }
+                    m_hasIce = true;
                 }
             } else {
                 for (int y = 96; y < height; y++) {
                     setBlockAt(i, y, j, SAND);
-                    if (!isSand) {
-                        isSand = true;
-                    }
+                    m_hasSand = true;
                 }
             }
         }
     }
-    // Procedurally placed assets feature
-    // 2% chance of generating a logo randomly
-    if (rand() % 50 < 1) {
-        if (isIce) { // Blue PENN logo
-            drawPenn(maxHeight, BLUE);
-        } else if (isSand) {
-            drawPenn(maxHeight, RED); // Blue PENN logo
-        } else { // POOH logo
-            drawPooh(maxHeight);
+}
+
+// Procedurally placed assets feature.
+// Structures are anchored in this Chunk but may extend into its XPOS
+// and ZPOS neighbors (and the one diagonal to both), so those must have
+// completed the SURFACE stage before this runs.
+void Chunk::generateDecoration() {
+    // 2% chance of generating a logo. Hashed from the Chunk's position
+    // so the result doesn't depend on which worker generates it.
+    glm::vec2 cell((m_pos.x + m_noiseOffset.x) / 16.f, (m_pos.y + m_noiseOffset.y) / 16.f);
+    if (random1(cell) >= 0.02f) {
+        return;
+    }
+    glm::vec2 offset = random2(cell) * 16.f;
+    glm::ivec2 origin(offset);
+    // Logos are 2 blocks wide along X and up to 15 blocks along Z;
+    // stand them on the highest column they cover
+    int maxHeight = 0;
+    for (int i = origin.x; i <= origin.x + 1; i++) {
+        for (int j = origin.y; j <= origin.y + 14; j++) {
+            maxHeight = std::max(maxHeight, getHeightAtOffset(i, j));
+        }
+    }
+    if (m_hasIce) { // Blue PENN logo
+        drawPenn(origin, maxHeight, BLUE);
+    } else if (m_hasSand) {
+        drawPenn(origin, maxHeight, RED); // Red PENN logo
+    } else { // POOH logo
+        drawPooh(origin, maxHeight);
+    }
+}
+
+// Fills the lava pools at the bottom of the caves and the lakes.
+// Only EMPTY blocks are flooded so structures are left intact.
+void Chunk::generateFluids() {
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) {
+            for (int y = 1; y < 25; y++) {
+                if (getBlockAt(i, y, j) == EMPTY) {
+                    setBlockAt(i, y, j, LAVA);
+                }
+            }
+            if (m_waterColumns[i + 16 * j]) {
+                for (int y = m_heightMap[i + 16 * j]; y <= 138; y++) {
+                    if (getBlockAt(i, y, j) == EMPTY) {
+                        setBlockAt(i, y, j, WATER);
+                    }
+                }
+            }
         }
     }
 }
 
-void Chunk::drawPenn(int maxHeight, BlockType t) {
-    for (int i = 7; i <= 8; i++) {
+// Resolves (x, z), given relative to this Chunk's corner and at most one
+// Chunk past its XPOS / ZPOS edges, to the Chunk that holds it.
+// Rewrites x and z to be relative to that Chunk.
+Chunk* Chunk::chunkAtOffset(int &x, int &z) {
+    Chunk *c = this;
+    if (x >= 16) {
+        c = c->m_neighbors[XPOS];
+        x -= 16;
+    }
+    if (c != nullptr && z >= 16) {
+        c = c->m_neighbors[ZPOS];
+        z -= 16;
+    }
+    return c;
+}
+
+void Chunk::setBlockAtOffset(int x, int y, int z, BlockType t) {
+    Chunk *c = chunkAtOffset(x, z);
+    // A stored Chunk already holds its part of the structure
+    if (c != nullptr && !c->m_stored && y >= 0 && y < 256) {
+        c->setBlockAt(x, y, z, t);
+    }
+}
+
+int Chunk::getHeightAtOffset(int x, int z) {
+    Chunk *c = chunkAtOffset(x, z);
+    return c != nullptr ? c->m_heightMap[x + 16 * z] : 0;
+}
+
+void Chunk::drawPenn(glm::ivec2 origin, int maxHeight, BlockType t) {
+    for (int i = origin.x; i <= origin.x + 1; i++) {
         for (int j = 0; j <= 14; j++) {
             if (j == 3 || j == 7 || j == 11) {
                 continue;
@@ -319,57 +564,57 @@ void Chunk::drawPenn(int maxHeight, BlockType t) {
             switch (j) {
                 case 0:
                     for (int k = 0; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, t);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, t);
                     }
                     break;
                 case 1:
-                    setBlockAt(i, maxHeight + 3, j, t);
-                    setBlockAt(i, maxHeight + 6, j, t);
+                    setBlockAtOffset(i, maxHeight + 3, origin.y + j, t);
+                    setBlockAtOffset(i, maxHeight + 6, origin.y + j, t);
                     break;
                 case 2:
                     for (int k = 3; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, t);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, t);
                     }
                     break;
                 case 4:
                     for (int k = 0; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, t);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, t);
                     }
                     break;
                 case 5:
                     for (int k = 0; k <= 6; k += 3) {
-                        setBlockAt(i, maxHeight + k, j, t);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, t);
                     }
                     break;
                 case 6:
                     for (int k = 0; k <= 6; k += 3) {
-                        setBlockAt(i, maxHeight + k, j, t);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, t);
                     }
                     break;
                 case 8:
                     for (int k = 0; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, t);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, t);
                     }
                     break;
                 case 9:
-                    setBlockAt(i, maxHeight + 6, j, t);
+                    setBlockAtOffset(i, maxHeight + 6, origin.y + j, t);
                     break;
                 case 10:
                     for (int k = 0; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, t);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, t);
                     }
                     break;
                 case 12:
                     for (int k = 0; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, t);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, t);
                     }
                     break;
                 case 13:
-                    setBlockAt(i, maxHeight + 6, j, t);
+                    setBlockAtOffset(i, maxHeight + 6, origin.y + j, t);
                     break;
                 case 14:
                     for (int k = 0; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, t);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, t);
                     }
                     break;
                 default:
@@ -379,112 +624,112 @@ void Chunk::drawPenn(int maxHeight, BlockType t) {
     }
 }
 
-void Chunk::drawPooh(int maxHeight) {
-    for (int i = 7; i <= 8; i++) {
+void Chunk::drawPooh(glm::ivec2 origin, int maxHeight) {
+    for (int i = origin.x; i <= origin.x + 1; i++) {
         for (int j = 0; j <= 11; j++) {
             switch (j) {
                 case 0:
                     for (int k = 3; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     for (int k = 10; k <= 12; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     break;
                 case 1:
                     for (int k = 2; k <= 12; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     break;
                 case 2:
                     for (int k = 1; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
-                    setBlockAt(i, maxHeight + 7, j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 7, origin.y + j, BLACK);
                     for (int k = 8; k <= 12; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     break;
                 case 3:
-                    setBlockAt(i, maxHeight, j, YELLOW);
-                    setBlockAt(i, maxHeight + 1, j, YELLOW);
-                    setBlockAt(i, maxHeight + 2, j, BLACK);
-                    setBlockAt(i, maxHeight + 3, j, BLACK);
-                    setBlockAt(i, maxHeight + 4, j, YELLOW);
-                    setBlockAt(i, maxHeight + 5, j, BLACK);
-                    setBlockAt(i, maxHeight + 6, j, YELLOW);
-                    setBlockAt(i, maxHeight + 7, j, YELLOW);
-                    setBlockAt(i, maxHeight + 8, j, BLACK);
-                    setBlockAt(i, maxHeight + 9, j, YELLOW);
-                    setBlockAt(i, maxHeight + 10, j, YELLOW);
+                    setBlockAtOffset(i, maxHeight, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 1, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 2, origin.y + j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 3, origin.y + j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 4, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 5, origin.y + j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 6, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 7, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 8, origin.y + j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 9, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 10, origin.y + j, YELLOW);
                     break;
                 case 4:
-                    setBlockAt(i, maxHeight, j, YELLOW);
-                    setBlockAt(i, maxHeight + 1, j, BLACK);
+                    setBlockAtOffset(i, maxHeight, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 1, origin.y + j, BLACK);
                     for (int k = 2; k <= 10; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     break;
                 case 5:
-                    setBlockAt(i, maxHeight, j, YELLOW);
-                    setBlockAt(i, maxHeight + 1, j, BLACK);
-                    setBlockAt(i, maxHeight + 2, j, YELLOW);
-                    setBlockAt(i, maxHeight + 3, j, YELLOW);
-                    setBlockAt(i, maxHeight + 4, j, BLACK);
+                    setBlockAtOffset(i, maxHeight, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 1, origin.y + j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 2, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 3, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 4, origin.y + j, BLACK);
                     for (int k = 5; k <= 10; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     break;
                 case 6:
-                    setBlockAt(i, maxHeight, j, YELLOW);
-                    setBlockAt(i, maxHeight + 1, j, BLACK);
-                    setBlockAt(i, maxHeight + 2, j, YELLOW);
-                    setBlockAt(i, maxHeight + 3, j, YELLOW);
-                    setBlockAt(i, maxHeight + 4, j, BLACK);
+                    setBlockAtOffset(i, maxHeight, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 1, origin.y + j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 2, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 3, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 4, origin.y + j, BLACK);
                     for (int k = 5; k <= 10; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     break;
                 case 7:
-                    setBlockAt(i, maxHeight, j, YELLOW);
-                    setBlockAt(i, maxHeight + 1, j, BLACK);
+                    setBlockAtOffset(i, maxHeight, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 1, origin.y + j, BLACK);
                     for (int k = 2; k <= 10; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     break;
                 case 8:
-                    setBlockAt(i, maxHeight, j, YELLOW);
-                    setBlockAt(i, maxHeight + 1, j, YELLOW);
-                    setBlockAt(i, maxHeight + 2, j, BLACK);
-                    setBlockAt(i, maxHeight + 3, j, BLACK);
-                    setBlockAt(i, maxHeight + 4, j, YELLOW);
-                    setBlockAt(i, maxHeight + 5, j, BLACK);
-                    setBlockAt(i, maxHeight + 6, j, YELLOW);
-                    setBlockAt(i, maxHeight + 7, j, YELLOW);
-                    setBlockAt(i, maxHeight + 8, j, BLACK);
-                    setBlockAt(i, maxHeight + 9, j, YELLOW);
-                    setBlockAt(i, maxHeight + 10, j, YELLOW);
+                    setBlockAtOffset(i, maxHeight, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 1, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 2, origin.y + j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 3, origin.y + j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 4, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 5, origin.y + j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 6, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 7, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 8, origin.y + j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 9, origin.y + j, YELLOW);
+                    setBlockAtOffset(i, maxHeight + 10, origin.y + j, YELLOW);
                     break;
                 case 9:
                     for (int k = 1; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
-                    setBlockAt(i, maxHeight + 7, j, BLACK);
+                    setBlockAtOffset(i, maxHeight + 7, origin.y + j, BLACK);
                     for (int k = 8; k <= 12; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     break;
                 case 10:
                     for (int k = 2; k <= 12; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     break;
                 case 11:
                     for (int k = 3; k <= 6; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     for (int k = 10; k <= 12; k++) {
-                        setBlockAt(i, maxHeight + k, j, YELLOW);
+                        setBlockAtOffset(i, maxHeight + k, origin.y + j, YELLOW);
                     }
                     break;
                 default:
@@ -494,32 +739,106 @@ void Chunk::drawPooh(int maxHeight) {
     }
 }
 
-void Chunk::create(std::vector<glm::vec4> m_vboDataOpaque, std::vector<GLuint> m_idxDataOpaque,
-            std::vector<glm::vec4> m_vboDataTransparent, std::vector<GLuint> m_idxDataTransparent) {
-    // Takes in a vector of interleaved vertex data and a vector of index data,
-    // and buffers them into the appropriate VBOs of Drawable
-    m_count = m_idxDataOpaque.size();
+void Chunk::create(const ChunkVBOData &data) {
+    // Copies the interleaved vertex data and index data of both
+    // meshes into the Terrain's shared ChunkArena, over the previous
+    // meshes if they fit
+    mp_arena->reallocate(m_allocOpaque, data.m_vboDataOpaque, data.m_idxDataOpaque);
+    mp_arena->reallocate(m_allocTransparent, data.m_vboDataTransparent, data.m_idxDataTransparent);
+    m_count = data.m_idxDataOpaque.size();
+    m_count2 = data.m_idxDataTransparent.size();
+    m_meshMinY = data.m_minY;
+    m_meshMaxY = data.m_maxY;
+    m_sectionIdxOpaque = data.m_sectionIdxOpaque;
+    m_sectionIdxTransparent = data.m_sectionIdxTransparent;
+    m_sectionConnectivity = data.m_sectionConnectivity;
 
-    generatePos();
-    bindPos();
-    mp_context->glBufferData(GL_ARRAY_BUFFER, m_vboDataOpaque.size() * sizeof(glm::vec4), m_vboDataOpaque.data(), GL_STATIC_DRAW);
+    // Each transparent face is 4 vertices of (pos, nor, uv)
+    sPtr<std::vector<glm::vec3>> centers = mkS<std::vector<glm::vec3>>();
+    const std::vector<glm::vec4> &vbo = data.m_vboDataTransparent;
+    centers->reserve(vbo.size() / 12);
+    for (size_t v = 0; v + 12 <= vbo.size(); v += 12) {
+        centers->push_back(glm::vec3(vbo[v] + vbo[v + 3] + vbo[v + 6] + vbo[v + 9]) * 0.25f);
+    }
+    mp_transparentFaceCenters = centers;
+    m_meshVersion++;
+    m_sorted = false;
+}
 
-    generateIdx();
-    bindIdx();
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_idxDataOpaque.size() * sizeof(GLuint), m_idxDataOpaque.data(), GL_STATIC_DRAW);
+bool Chunk::needsTransparentSort(glm::vec3 eye) const {
+    if (m_count2 <= 0 || m_sortPending) {
+        return false;
+    }
+    if (!m_sorted) {
+        return true;
+    }
+    // Far away faces keep their order over longer camera moves, so the
+    // allowed move grows with the distance to the Chunk
+    glm::vec3 center(m_pos.x + 8, (m_meshMinY + m_meshMaxY) * 0.5f, m_pos.y + 8);
+    float moved = glm::length(eye - m_sortEye);
+    return moved > glm::max(1.f, glm::length(center - eye) / 16.f);
+}
 
-    // transparent
-    m_count2 = m_idxDataTransparent.size();
+TransparentSortData Chunk::beginTransparentSort(glm::vec3 eye) {
+    m_sortPending = true;
+    TransparentSortData sort;
+    sort.mp_chunk = this;
+    sort.m_meshVersion = m_meshVersion;
+    sort.m_eye = eye;
+    sort.mp_faceCenters = mp_transparentFaceCenters;
+    for (int s = 0; s <= CHUNK_SECTIONS; s++) {
+        sort.m_sectionFaces[s] = m_sectionIdxTransparent[s] / 6;
+    }
+    return sort;
+}
+
+void Chunk::finishTransparentSort(const TransparentSortData &sort) {
+    m_sortPending = false;
+    if (sort.m_meshVersion != m_meshVersion || !m_allocTransparent.valid() ||
+            static_cast<int>(sort.m_indices.size()) != m_allocTransparent.indexCount) {
+        return;
+    }
+    mp_arena->uploadIndices(m_allocTransparent, sort.m_indices);
+    m_sortEye = sort.m_eye;
+    m_sorted = true;
+}
 
-    generatePos2();
-    bindPos2();
-    mp_context->glBufferData(GL_ARRAY_BUFFER, m_vboDataTransparent.size() * sizeof(glm::vec4), m_vboDataTransparent.data(), GL_STATIC_DRAW);
+void Chunk::destroyVBOdata() {
+    if (mp_arena != nullptr) {
+        mp_arena->release(m_allocOpaque);
+        mp_arena->release(m_allocTransparent);
+    }
+    m_count = -1;
+    m_count2 = -1;
+    m_meshVersion++;
+}
 
-    generateIdx2();
-    bindIdx2();
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_idxDataTransparent.size() * sizeof(GLuint), m_idxDataTransparent.data(), GL_STATIC_DRAW);
+const ArenaAllocation& Chunk::getAllocation(bool opaque) const {
+    return opaque ? m_allocOpaque : m_allocTransparent;
 }
 
 void Chunk::setMCount(int c) {
     m_count = c;
 }
+
+glm::ivec2 Chunk::getSectionIndexRange(int section, bool opaque) const {
+    const std::array<int, CHUNK_SECTIONS + 1> &offsets = opaque ? m_sectionIdxOpaque : m_sectionIdxTransparent;
+    return glm::ivec2(offsets[section], offsets[section + 1]);
+}
+
+unsigned short Chunk::getSectionConnectivity(int section) const {
+    return m_sectionConnectivity[section];
+}
+
+glm::ivec2 Chunk::getPos() const {
+    return m_pos;
+}
+
+bool Chunk::getMeshBounds(glm::vec3 &min, glm::vec3 &max) const {
+    if (m_meshMinY > m_meshMaxY) {
+        return false;
+    }
+    min = glm::vec3(m_pos.x, m_meshMinY, m_pos.y);
+    max = glm::vec3(m_pos.x + 16, m_meshMaxY, m_pos.y + 16);
+    return true;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "chunkhelpers.h"
+#include "chunkarena.h"
 #include "drawable.h"
 #include "smartpointerhelp.h"
 #include "glm_includes.h"
@@ -11,17 +12,51 @@
 
 class Chunk;
 
+// The passes world generation runs over a Chunk, in order.
+// HEIGHTFIELD, CAVES and SURFACE only touch the Chunk itself.
+// DECORATION may write into the XPOS / ZPOS neighbors, so it requires
+// them to have finished SURFACE. FLUIDS only fills EMPTY blocks and runs
+// once every structure that could reach the Chunk has been placed.
+enum GenerationStage : unsigned char {
+    UNGENERATED, HEIGHTFIELD, CAVES, SURFACE, DECORATION, FLUIDS
+};
+
 struct ChunkVBOData {
     Chunk* mp_chunk;
     std::vector<glm::vec4> m_vboDataOpaque, m_vboDataTransparent;
     std::vector<GLuint> m_idxDataOpaque, m_idxDataTransparent;
+    // Vertical extent of the mesh, empty (min > max) if it has no faces
+    int m_minY, m_maxY;
+    // The index data is ordered by section: section s is indices
+    // [m_sectionIdx[s], m_sectionIdx[s + 1])
+    std::array<int, CHUNK_SECTIONS + 1> m_sectionIdxOpaque, m_sectionIdxTransparent;
+    // See facesConnected
+    std::array<unsigned short, CHUNK_SECTIONS> m_sectionConnectivity;
 
     ChunkVBOData(Chunk* c) :
         mp_chunk(c), m_vboDataOpaque{}, m_vboDataTransparent{},
-        m_idxDataOpaque{}, m_idxDataTransparent{}
+        m_idxDataOpaque{}, m_idxDataTransparent{}, m_minY(256), m_maxY(0),
+        m_sectionIdxOpaque{}, m_sectionIdxTransparent{}, m_sectionConnectivity{}
     {}
 };
 
+// A back-to-front ordering of a Chunk's transparent faces, computed by a
+// TransparentSortWorker for one camera position. Each face is a quad of
+// 4 vertices drawn with 6 indices.
+struct TransparentSortData {
+    Chunk* mp_chunk;
+    // Mesh version the sort was started for, see Chunk::m_meshVersion
+    int m_meshVersion;
+    glm::vec3 m_eye;
+    // World-space face centers, in mesh order
+    sPtr<const std::vector<glm::vec3>> mp_faceCenters;
+    // Faces of section s are [m_sectionFaces[s], m_sectionFaces[s + 1])
+    std::array<int, CHUNK_SECTIONS + 1> m_sectionFaces;
+    // The resulting index buffer. Faces stay within their section so
+    // the section index ranges remain valid.
+    std::vector<GLuint> m_indices;
+};
+
 // One Chunk is a 16 x 256 x 16 section of the world,
 // containing all the Minecraft blocks in that area.
 // We divide the world into Chunks in order to make
@@ -40,42 +75,128 @@ private:
     // These allow us to properly determine
     std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
     glm::ivec2 m_pos;
-    // An alteration to the VBO for the Chunk class,
-    // so that it additionally supports UV coordinates (vec2).
+    // The number of indices in the transparent mesh
     int m_count2;
-    GLuint m_bufIdx2;
-    GLuint m_bufPos2;
-    bool m_idx2Generated;
-    bool m_pos2Generated;
+    // Both meshes live in a ChunkArena shared by the whole Terrain
+    ChunkArena *mp_arena;
+    ArenaAllocation m_allocOpaque, m_allocTransparent;
+
+    // Per-column data handed from one generation stage to the next
+    std::array<int, 256> m_heightMap;
+    std::array<bool, 256> m_waterColumns;
+    bool m_hasIce;
+    bool m_hasSand;
+    // The blocks were loaded from a ChunkStore, complete with the parts
+    // of neighboring zones' structures that reach into them, so the
+    // generation stages leave them alone
+    bool m_stored;
+    // World-seed offset added to the noise sample coordinates
+    glm::ivec2 m_noiseOffset;
+    // Vertical extent of the uploaded mesh, used for culling
+    int m_meshMinY, m_meshMaxY;
+    // Per-section index ranges and connectivity of the uploaded mesh
+    std::array<int, CHUNK_SECTIONS + 1> m_sectionIdxOpaque, m_sectionIdxTransparent;
+    std::array<unsigned short, CHUNK_SECTIONS> m_sectionConnectivity;
+    // Face centers of the uploaded transparent mesh, for sorting
+    sPtr<const std::vector<glm::vec3>> mp_transparentFaceCenters;
+    // Bumped on every upload so sorts of an older mesh can be dropped
+    int m_meshVersion;
+    // Camera position the transparent faces were last sorted for
+    glm::vec3 m_sortEye;
+    bool m_sorted;
+    bool m_sortPending;
+    // Number of non-EMPTY blocks in each section, so raycasts can
+    // skip the empty ones without reading their blocks
+    std::array<unsigned short, CHUNK_SECTIONS> m_sectionBlocks;
 
     // Helper function that check if BlockType is empty
     bool isOpaque(BlockType t);
     // Helper function to get block color
     glm::vec4 getColor(BlockType t);
+    // Flood fills the non-opaque blocks of one section to find
+    // which of its faces see each other
+    unsigned short computeSectionConnectivity(int section);
+
+    // Helpers for structures that cross into the XPOS / ZPOS neighbors
+    Chunk* chunkAtOffset(int &x, int &z);
+    void setBlockAtOffset(int x, int y, int z, BlockType t);
+    int getHeightAtOffset(int x, int z);
 
 public:
     ChunkVBOData m_vboData;
     Chunk(OpenGLContext* mp_context);
-    Chunk(OpenGLContext* mp_context, int x, int z);
+    Chunk(OpenGLContext* mp_context, int x, int z, unsigned int seed = 0, ChunkArena *arena = nullptr);
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // Bulk versions of setBlockAt for filling large areas: set blocks
+    // [yBegin, yEnd) of column (x, z), or every block of the box
+    // [min, max), to t. Ranges are clipped to the Chunk.
+    void fillColumn(int x, int z, int yBegin, int yEnd, BlockType t);
+    void fillBox(glm::ivec3 min, glm::ivec3 max, BlockType t);
+    // Number of non-EMPTY blocks in a 16 block tall section
+    int getSectionBlockCount(int section) const;
+    // One past the highest section holding any block, 0 if
+    // the Chunk is empty
+    int getTopSection() const;
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    // Clears the neighbors' pointers to this Chunk and its to them,
+    // before it is deleted
+    void unlinkNeighbors();
 
-    // Functions for an alteration to the VBO for the Chunk class
+    // Raw block and column height data, for saving and loading Chunks
+    const std::array<BlockType, 65536>& getBlocks() const;
+    void setBlocks(const std::array<BlockType, 65536> &blocks);
+    const std::array<int, 256>& getHeightMap() const;
+    void setHeightMap(const std::array<int, 256> &heightMap);
+    // Which logo generateDecoration draws, decided by generateSurface
+    bool hasIce() const;
+    bool hasSand() const;
+    void setSurfaceFlags(bool hasIce, bool hasSand);
+    // Marks the blocks as loaded from a ChunkStore. Only DECORATION still
+    // runs, to place the parts of this Chunk's structures that reach into
+    // generated neighbors; nothing writes into a stored Chunk's blocks.
+    void markStored();
+
+    // The number of indices in the transparent mesh
     int elemCount2();
-    void generateIdx2();
-    void generatePos2();
-    bool bindIdx2();
-    bool bindPos2();
 
     virtual void createVBOdata() override;
-    void fillChunk();
-    void create(std::vector<glm::vec4> m_vboDataOpaque, std::vector<GLuint>,
-                std::vector<glm::vec4> m_vboDataTransparent, std::vector<GLuint> m_idxDataTransparent);
+    // World generation, see GenerationStage
+    void runGenerationStage(GenerationStage stage, const BiomeBlend &blend = BiomeBlend());
+    void generateHeightfield(const BiomeBlend &blend);
+    void generateCaves();
+    void generateSurface();
+    void generateDecoration();
+    void generateFluids();
+    // Uploads VBO data computed by createVBOdata into the arena,
+    // replacing any previously uploaded meshes
+    void create(const ChunkVBOData &data);
+    // Returns the meshes' space to the arena
+    virtual void destroyVBOdata() override;
+    // Where the opaque or transparent mesh lives in the arena.
+    // Section index ranges are relative to its firstIndex.
+    const ArenaAllocation& getAllocation(bool opaque) const;
     void setMCount(int c);
+    // World-space corner of the Chunk, as (x, z)
+    glm::ivec2 getPos() const;
+    // Bounding box of the uploaded mesh in world space.
+    // Returns false if the mesh is empty.
+    bool getMeshBounds(glm::vec3 &min, glm::vec3 &max) const;
+    // Index range [x, y) of one section of the uploaded mesh
+    glm::ivec2 getSectionIndexRange(int section, bool opaque) const;
+    unsigned short getSectionConnectivity(int section) const;
+
+    // Whether the transparent faces should be sorted again for a camera at
+    // eye: they never have been, or the camera moved far enough that the
+    // order may have changed
+    bool needsTransparentSort(glm::vec3 eye) const;
+    // Marks a sort as pending and returns what the worker needs to run it
+    TransparentSortData beginTransparentSort(glm::vec3 eye);
+    // Uploads a finished sort's index buffer, unless the mesh changed since
+    void finishTransparentSort(const TransparentSortData &sort);
 
     // Functions for placing assets
-    void drawPenn(int maxHeight, BlockType t);
-    void drawPooh(int maxHeight);
+    void drawPenn(glm::ivec2 origin, int maxHeight, BlockType t);
+    void drawPooh(glm::ivec2 origin, int maxHeight);
 };
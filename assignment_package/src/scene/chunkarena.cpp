@@ -0,0 +1,257 @@
+#include "chunkarena.h"
+#include <algorithm>
+
+namespace {
+// Binds a VAO for the guard's lifetime and then restores the one bound
+// before. The GL_ELEMENT_ARRAY_BUFFER binding belongs to the bound VAO,
+// so binding the arena's index buffer with someone else's VAO bound
+// would change what that VAO draws.
+class VAOBinding {
+private:
+    OpenGLContext *mp_context;
+    GLint m_previous;
+
+public:
+    VAOBinding(OpenGLContext *context, GLuint vao)
+        : mp_context(context), m_previous(0)
+    {
+        mp_context->glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &m_previous);
+        mp_context->glBindVertexArray(vao);
+    }
+    ~VAOBinding() {
+        mp_context->glBindVertexArray(m_previous);
+    }
+};
+}
+
+FreeList::FreeList(int capacity)
+    : m_free{}, m_capacity(capacity), m_used(0)
+{
+    if (capacity > 0) {
+        m_free[0] = capacity;
+    }
+}
+
+int FreeList::allocate(int count) {
+    if (count <= 0) {
+        return 0;
+    }
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+        if (it->second < count) {
+            continue;
+        }
+        int offset = it->first;
+        int remaining = it->second - count;
+        m_free.erase(it);
+        if (remaining > 0) {
+            m_free[offset + count] = remaining;
+        }
+        m_used += count;
+        return offset;
+    }
+    return -1;
+}
+
+void FreeList::release(int offset, int count) {
+    if (count <= 0) {
+        return;
+    }
+    m_used -= count;
+    auto next = m_free.lower_bound(offset);
+    // Merge with the free range right after this one
+    if (next != m_free.end() && next->first == offset + count) {
+        count += next->second;
+        next = m_free.erase(next);
+    }
+    // And with the one right before
+    if (next != m_free.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += count;
+            return;
+        }
+    }
+    m_free[offset] = count;
+}
+
+void FreeList::grow(int newCapacity) {
+    if (newCapacity > m_capacity) {
+        int oldCapacity = m_capacity;
+        m_capacity = newCapacity;
+        // release() counts the new elements as freed
+        m_used += newCapacity - oldCapacity;
+        release(oldCapacity, newCapacity - oldCapacity);
+    }
+}
+
+int FreeList::capacity() const {
+    return m_capacity;
+}
+
+int FreeList::used() const {
+    return m_used;
+}
+
+int FreeList::freeRanges() const {
+    return m_free.size();
+}
+
+bool ArenaAllocation::valid() const {
+    return firstVertex >= 0;
+}
+
+ChunkArena::ChunkArena(OpenGLContext *context, int vertexCapacity, int indexCapacity)
+    : Drawable(context), m_vertices(vertexCapacity), m_indices(indexCapacity),
+      m_meshes(0), m_reusedInPlace(0), m_grows(0), m_vao(0), m_vaoGenerated(false), m_vaoProgram(0)
+{}
+
+ChunkArena::~ChunkArena()
+{}
+
+void ChunkArena::createVBOdata() {
+    generatePos();
+    bindPos();
+    mp_context->glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_vertices.capacity()) * VERTEX_SIZE,
+                             nullptr, GL_DYNAMIC_DRAW);
+    generateIdx();
+    VAOBinding binding(mp_context, generateVAO());
+    bindIdx();
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_indices.capacity()) * sizeof(GLuint),
+                             nullptr, GL_DYNAMIC_DRAW);
+    m_count = 0;
+}
+
+void ChunkArena::destroyVBOdata() {
+    Drawable::destroyVBOdata();
+    if (m_vaoGenerated) {
+        mp_context->glDeleteVertexArrays(1, &m_vao);
+        m_vaoGenerated = false;
+        m_vaoProgram = 0;
+    }
+    m_vertices = FreeList(m_vertices.capacity());
+    m_indices = FreeList(m_indices.capacity());
+    m_meshes = 0;
+}
+
+void ChunkArena::growBuffer(GLuint &buffer, FreeList &list, int elementSize, int minCapacity) {
+    int newCapacity = std::max(list.capacity() * 2, minCapacity);
+    GLuint newBuffer;
+    mp_context->glGenBuffers(1, &newBuffer);
+    mp_context->glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    mp_context->glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(newCapacity) * elementSize,
+                             nullptr, GL_DYNAMIC_DRAW);
+    mp_context->glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    mp_context->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                                    static_cast<GLsizeiptr>(list.capacity()) * elementSize);
+    mp_context->glDeleteBuffers(1, &buffer);
+    // Only the copy targets are used, which belong to no VAO. upload
+    // binds the new buffer to its own target.
+    buffer = newBuffer;
+    list.grow(newCapacity);
+    m_grows++;
+    // m_vao still points at the deleted buffer
+    m_vaoProgram = 0;
+}
+
+ArenaAllocation ChunkArena::allocate(const std::vector<glm::vec4> &vbo, const std::vector<GLuint> &idx) {
+    ArenaAllocation a;
+    a.vertexCount = vbo.size() / 3;
+    a.indexCount = idx.size();
+
+    a.firstVertex = m_vertices.allocate(a.vertexCount);
+    if (a.firstVertex < 0) {
+        growBuffer(m_bufPos, m_vertices, VERTEX_SIZE, m_vertices.capacity() + a.vertexCount);
+        a.firstVertex = m_vertices.allocate(a.vertexCount);
+    }
+    a.firstIndex = m_indices.allocate(a.indexCount);
+    if (a.firstIndex < 0) {
+        growBuffer(m_bufIdx, m_indices, sizeof(GLuint), m_indices.capacity() + a.indexCount);
+        a.firstIndex = m_indices.allocate(a.indexCount);
+    }
+    m_meshes++;
+    upload(a, vbo, idx);
+    return a;
+}
+
+void ChunkArena::upload(const ArenaAllocation &a, const std::vector<glm::vec4> &vbo, const std::vector<GLuint> &idx) {
+    if (a.vertexCount > 0) {
+        bindPos();
+        mp_context->glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(a.firstVertex) * VERTEX_SIZE,
+                                    static_cast<GLsizeiptr>(a.vertexCount) * VERTEX_SIZE, vbo.data());
+    }
+    if (a.indexCount > 0) {
+        VAOBinding binding(mp_context, generateVAO());
+        bindIdx();
+        mp_context->glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLintptr>(a.firstIndex) * sizeof(GLuint),
+                                    static_cast<GLsizeiptr>(a.indexCount) * sizeof(GLuint), idx.data());
+    }
+}
+
+void ChunkArena::reallocate(ArenaAllocation &a, const std::vector<glm::vec4> &vbo, const std::vector<GLuint> &idx) {
+    int vertexCount = vbo.size() / 3;
+    int indexCount = idx.size();
+    if (!a.valid() || vertexCount > a.vertexCount || indexCount > a.indexCount) {
+        release(a);
+        a = allocate(vbo, idx);
+        return;
+    }
+    // Shrink in place: only the tails of the old ranges are freed
+    m_vertices.release(a.firstVertex + vertexCount, a.vertexCount - vertexCount);
+    m_indices.release(a.firstIndex + indexCount, a.indexCount - indexCount);
+    a.vertexCount = vertexCount;
+    a.indexCount = indexCount;
+    upload(a, vbo, idx);
+    m_reusedInPlace++;
+}
+
+void ChunkArena::uploadIndices(const ArenaAllocation &a, const std::vector<GLuint> &idx) {
+    if (a.valid() && a.indexCount > 0) {
+        VAOBinding binding(mp_context, generateVAO());
+        bindIdx();
+        mp_context->glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLintptr>(a.firstIndex) * sizeof(GLuint),
+                                    static_cast<GLsizeiptr>(a.indexCount) * sizeof(GLuint), idx.data());
+    }
+}
+
+void ChunkArena::release(ArenaAllocation &a) {
+    if (!a.valid()) {
+        return;
+    }
+    m_vertices.release(a.firstVertex, a.vertexCount);
+    m_indices.release(a.firstIndex, a.indexCount);
+    a = ArenaAllocation();
+    m_meshes--;
+}
+
+GLuint ChunkArena::generateVAO() {
+    if (!m_vaoGenerated) {
+        mp_context->glGenVertexArrays(1, &m_vao);
+        m_vaoGenerated = true;
+        m_vaoProgram = 0;
+    }
+    return m_vao;
+}
+
+bool ChunkArena::bindVAO(GLuint prog) {
+    mp_context->glBindVertexArray(generateVAO());
+    return m_vaoProgram != prog;
+}
+
+void ChunkArena::setVAOConfigured(GLuint prog) {
+    m_vaoProgram = prog;
+}
+
+ArenaStats ChunkArena::getStats() const {
+    ArenaStats stats;
+    stats.buffers = (m_posGenerated ? 1 : 0) + (m_idxGenerated ? 1 : 0);
+    stats.meshes = m_meshes;
+    stats.bytesUsed = static_cast<size_t>(m_vertices.used()) * VERTEX_SIZE +
+                      static_cast<size_t>(m_indices.used()) * sizeof(GLuint);
+    stats.bytesCapacity = stats.buffers == 0 ? 0 :
+                          static_cast<size_t>(m_vertices.capacity()) * VERTEX_SIZE +
+                          static_cast<size_t>(m_indices.capacity()) * sizeof(GLuint);
+    stats.freeRanges = m_vertices.freeRanges() + m_indices.freeRanges();
+    stats.reusedInPlace = m_reusedInPlace;
+    stats.grows = m_grows;
+    return stats;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "drawable.h"
+#include "glm_includes.h"
+#include <map>
+#include <vector>
+
+// First-fit allocator over the elements [0, capacity) of a buffer.
+// Freed ranges are merged with their free neighbors.
+class FreeList {
+private:
+    // Offset -> size of every free range
+    std::map<int, int> m_free;
+    int m_capacity;
+    int m_used;
+
+public:
+    FreeList(int capacity);
+
+    // Returns the offset of count free elements, or -1 if
+    // there is no free range that large
+    int allocate(int count);
+    void release(int offset, int count);
+    // Adds the elements [capacity, newCapacity) to the free list
+    void grow(int newCapacity);
+
+    int capacity() const;
+    int used() const;
+    int freeRanges() const;
+};
+
+// Where one mesh lives in a ChunkArena. firstVertex is
+// -1 if the mesh hasn't been uploaded.
+struct ArenaAllocation {
+    int firstVertex, vertexCount;
+    int firstIndex, indexCount;
+
+    ArenaAllocation() : firstVertex(-1), vertexCount(0), firstIndex(0), indexCount(0) {}
+    bool valid() const;
+};
+
+// Memory use of a ChunkArena, for the debug overlay
+struct ArenaStats {
+    int buffers;          // GL buffers currently alive
+    int meshes;           // Live allocations
+    size_t bytesUsed;     // Bytes covered by live allocations
+    size_t bytesCapacity; // Bytes of GPU storage allocated
+    int freeRanges;       // Holes in both free lists, a measure of fragmentation
+    int reusedInPlace;    // Re-uploads that fit in the mesh's previous storage
+    int grows;            // Times a buffer was reallocated larger
+};
+
+// One interleaved vertex buffer and one index buffer that every Chunk's
+// meshes are sub-allocated from, so the whole Terrain can be drawn
+// with a single multi-draw call per pass. Vertex positions are in world
+// space and indices are relative to the mesh's first vertex.
+// Buffers grow by doubling when an allocation doesn't fit.
+// The vertex layout lives in one VAO, so drawing every Chunk is a
+// VAO bind plus the draw call.
+class ChunkArena : public Drawable {
+private:
+    FreeList m_vertices;
+    FreeList m_indices;
+    int m_meshes;
+    int m_reusedInPlace;
+    int m_grows;
+    // Vertex array object holding the attribute layout of the arena's
+    // vertex buffer and its index buffer binding
+    GLuint m_vao;
+    bool m_vaoGenerated;
+    // The shader program m_vao's attributes were last set up for, 0 if
+    // they need to be set up again
+    GLuint m_vaoProgram;
+
+    // Copies the mesh data into the ranges already reserved in a
+    void upload(const ArenaAllocation &a, const std::vector<glm::vec4> &vbo, const std::vector<GLuint> &idx);
+
+    // Generates m_vao if it doesn't exist yet and returns it
+    GLuint generateVAO();
+
+    // Reallocates one of the buffers with a larger capacity,
+    // copying the old contents over on the GPU
+    void growBuffer(GLuint &buffer, FreeList &list, int elementSize, int minCapacity);
+
+public:
+    // Each vertex is a position, a normal and a uv, all vec4s
+    static constexpr int VERTEX_SIZE = 3 * sizeof(glm::vec4);
+
+    ChunkArena(OpenGLContext* context, int vertexCapacity = 1 << 18, int indexCapacity = 3 << 17);
+    virtual ~ChunkArena();
+
+    // Allocates the buffers at their initial capacity
+    virtual void createVBOdata() override;
+    virtual void destroyVBOdata() override;
+
+    // Copies an interleaved mesh into the arena
+    ArenaAllocation allocate(const std::vector<glm::vec4> &vbo, const std::vector<GLuint> &idx);
+    // Replaces the mesh in a with a new one. If the new mesh fits in a's
+    // ranges it is written over the old one and the unused tails are
+    // freed, otherwise a is released and the mesh allocated elsewhere.
+    void reallocate(ArenaAllocation &a, const std::vector<glm::vec4> &vbo, const std::vector<GLuint> &idx);
+    // Overwrites the indices of a with a permutation of the same size,
+    // leaving its vertices untouched
+    void uploadIndices(const ArenaAllocation &a, const std::vector<GLuint> &idx);
+    // Returns the mesh's ranges to the free lists and invalidates it
+    void release(ArenaAllocation &a);
+
+    // Binds the arena's vertex array object. Returns true if the caller
+    // has to (re)specify its attributes for prog: the VAO is new, one of
+    // the buffers was reallocated, or it was last set up for another program.
+    bool bindVAO(GLuint prog);
+    // Records that every attribute of the bound VAO and its index buffer
+    // have been specified for prog, so bindVAO can skip them next time
+    void setVAOConfigured(GLuint prog);
+
+    ArenaStats getStats() const;
+};
@@ -10,7 +10,10 @@
 enum BlockType : unsigned char {
     EMPTY, GRASS, DIRT, STONE, ICE, WATER, SNOW, BRONZE, LAVA, BEDROCK, SAND, TREE, OTHER,
     // For height map feature
-    BLACK, WHITE, RED, LIME, BLUE, YELLOW, CYAN, MAGENTA, SILVER, GRAY, MAROON, OLIVE, GREEN, PURPLE, TEAL, NAVY
+    BLACK, WHITE, RED, LIME, BLUE, YELLOW, CYAN, MAGENTA, SILVER, GRAY, MAROON, OLIVE, GREEN, PURPLE, TEAL, NAVY,
+    // Returned by Terrain's try- queries for coordinates whose Chunk
+    // isn't loaded. Never stored in a Chunk.
+    UNLOADED
 };
 
 // The six cardinal directions in 3D space
@@ -18,6 +21,22 @@ enum Direction : unsigned char {
     XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG
 };
 
+// For visibility culling each Chunk is split vertically
+// into sections of 16 x 16 x 16 blocks
+#define CHUNK_SECTIONS 16
+
+// A section's connectivity has one bit per pair of its six faces,
+// set when the two faces are joined by a path through non-opaque blocks
+inline int facePairBit(Direction a, Direction b) {
+    int lo = a < b ? a : b;
+    int hi = a < b ? b : a;
+    return lo * (11 - lo) / 2 + (hi - lo - 1);
+}
+
+inline bool facesConnected(unsigned short connectivity, Direction a, Direction b) {
+    return a != b && ((connectivity >> facePairBit(a, b)) & 1);
+}
+
 // Lets us use any enum class as the key of a
 // std::unordered_map
 struct EnumHash {
@@ -0,0 +1,121 @@
+#include "chunkstore.h"
+#include "terrain.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <cstring>
+
+ChunkStore::ChunkStore(const QString &directory, unsigned int seed)
+    : m_directory(directory), m_seed(seed)
+{}
+
+const QString& ChunkStore::getDirectory() const {
+    return m_directory;
+}
+
+bool ChunkStore::ensureDirectory() const {
+    return QDir().mkpath(m_directory);
+}
+
+QString ChunkStore::zonePath(int64_t zone) const {
+    glm::ivec2 coord = toCoords(zone);
+    return QDir(m_directory).filePath(QString("zone_%1_%2.dat").arg(coord.x).arg(coord.y));
+}
+
+bool ChunkStore::hasZone(int64_t zone) const {
+    return QFile::exists(zonePath(zone));
+}
+
+bool ChunkStore::saveZone(int64_t zone, const std::vector<const Chunk*> &chunks) const {
+    if (chunks.size() != 16) {
+        return false;
+    }
+    QSaveFile file(zonePath(zone));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    glm::ivec2 coord = toCoords(zone);
+    QDataStream out(&file);
+    out.writeRawData(ZONE_FILE_MAGIC, 4);
+    out << quint32(ZONE_FILE_VERSION) << quint32(m_seed) << qint32(coord.x) << qint32(coord.y);
+
+    std::vector<std::pair<quint8, quint16>> runs;
+    for (const Chunk *c : chunks) {
+        for (int h : c->getHeightMap()) {
+            out << quint8(glm::clamp(h, 0, 255));
+        }
+        out << quint8((c->hasIce() ? 1 : 0) | (c->hasSand() ? 2 : 0));
+        const std::array<BlockType, 65536> &blocks = c->getBlocks();
+        runs.clear();
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (!runs.empty() && runs.back().first == blocks[i] && runs.back().second < 0xffff) {
+                runs.back().second++;
+            } else {
+                runs.push_back({quint8(blocks[i]), 1});
+            }
+        }
+        out << quint32(runs.size());
+        for (auto &run : runs) {
+            out << run.first << run.second;
+        }
+    }
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+bool ChunkStore::loadZone(int64_t zone, const std::vector<Chunk*> &chunks) const {
+    if (chunks.size() != 16) {
+        return false;
+    }
+    QFile file(zonePath(zone));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    char magic[4];
+    quint32 version, seed;
+    qint32 x, z;
+    in.readRawData(magic, 4);
+    in >> version >> seed >> x >> z;
+    glm::ivec2 coord = toCoords(zone);
+    if (in.status() != QDataStream::Ok || std::memcmp(magic, ZONE_FILE_MAGIC, 4) != 0 ||
+            version != ZONE_FILE_VERSION || seed != m_seed || x != coord.x || z != coord.y) {
+        return false;
+    }
+
+    // Decode everything first so a corrupt file leaves the Chunks untouched
+    std::vector<std::array<int, 256>> heightMaps(16);
+    std::vector<quint8> surfaceFlags(16);
+    std::vector<std::array<BlockType, 65536>> blocks(16);
+    for (int c = 0; c < 16; c++) {
+        for (int &h : heightMaps[c]) {
+            quint8 height;
+            in >> height;
+            h = height;
+        }
+        in >> surfaceFlags[c];
+        quint32 runCount;
+        in >> runCount;
+        size_t i = 0;
+        for (quint32 r = 0; r < runCount; r++) {
+            quint8 type;
+            quint16 length;
+            in >> type >> length;
+            if (in.status() != QDataStream::Ok || i + length > blocks[c].size()) {
+                return false;
+            }
+            std::fill_n(blocks[c].begin() + i, length, static_cast<BlockType>(type));
+            i += length;
+        }
+        if (i != blocks[c].size()) {
+            return false;
+        }
+    }
+    for (int c = 0; c < 16; c++) {
+        chunks[c]->setHeightMap(heightMaps[c]);
+        chunks[c]->setBlocks(blocks[c]);
+        chunks[c]->setSurfaceFlags(surfaceFlags[c] & 1, surfaceFlags[c] & 2);
+        chunks[c]->markStored();
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "chunk.h"
+#include <QString>
+#include <vector>
+
+// Magic number and version at the start of every zone file.
+// Bump ZONE_FILE_VERSION whenever the layout below changes.
+#define ZONE_FILE_MAGIC "MMZN"
+#define ZONE_FILE_VERSION 2
+
+// Reads and writes whole terrain zones (4 x 4 Chunks) that have been
+// generated through every GenerationStage, one file per zone.
+//
+// Zone file layout (QDataStream, big-endian):
+//   char[4]  ZONE_FILE_MAGIC
+//   quint32  ZONE_FILE_VERSION
+//   quint32  world seed
+//   qint32   zone corner x, z
+//   16 Chunks, ordered by x then z within the zone, each made of
+//     quint8[256]  column heights
+//     quint8       surface flags: 1 if Chunk::hasIce, 2 if Chunk::hasSand
+//     quint32      number of runs
+//     runs of (quint8 BlockType, quint16 length) covering the Chunk's
+//     65536 blocks in Chunk::getBlocks() order
+//
+// Files are written through QSaveFile, so a zone file is either complete
+// or absent even if the writer is interrupted.
+class ChunkStore {
+private:
+    QString m_directory;
+    unsigned int m_seed;
+
+    QString zonePath(int64_t zone) const;
+
+public:
+    ChunkStore(const QString &directory, unsigned int seed);
+
+    const QString& getDirectory() const;
+    // Creates the directory if needed
+    bool ensureDirectory() const;
+    bool hasZone(int64_t zone) const;
+
+    // chunks must hold the zone's 16 Chunks, ordered by x then z
+    bool saveZone(int64_t zone, const std::vector<const Chunk*> &chunks) const;
+    // Fails without modifying the Chunks if the file is missing, is from
+    // another version or seed, or is corrupt. Loaded Chunks are marked
+    // stored, see Chunk::markStored.
+    bool loadZone(int64_t zone, const std::vector<Chunk*> &chunks) const;
+};
@@ -1,18 +1,30 @@
 #include "chunkworkers.h"
+#include <algorithm>
 
-FBMWorker::FBMWorker(int x, int z, std::vector<Chunk*> chunksToFill,
-                         std::unordered_set<Chunk*>* chunksCompleted, QMutex* ChunksCompletedLock) :
-    m_xCorner(x), m_zCorner(z), m_chunksToFill(chunksToFill),
-    mp_chunksCompleted(chunksCompleted), mp_chunksCompletedLock(ChunksCompletedLock)
+FBMWorker::FBMWorker(int64_t zone, std::vector<Chunk*> chunksToFill,
+                     GenerationStage firstStage, GenerationStage lastStage, const BiomeBlend &biomeBlend,
+                     std::vector<std::pair<int64_t, GenerationStage>>* zonesCompleted, QMutex* zonesCompletedLock,
+                     const ChunkStore* store) :
+    m_zone(zone), m_chunksToFill(chunksToFill), m_firstStage(firstStage), m_lastStage(lastStage),
+    m_biomeBlend(biomeBlend), mp_zonesCompleted(zonesCompleted), mp_zonesCompletedLock(zonesCompletedLock),
+    mp_store(store)
 {}
 
 void FBMWorker::run() {
-    for (auto &chunk : m_chunksToFill) {
-        chunk->fillChunk();
-        mp_chunksCompletedLock->lock();
-        mp_chunksCompleted->insert(chunk);
-        mp_chunksCompletedLock->unlock();
+    if (m_firstStage == HEIGHTFIELD && mp_store != nullptr && mp_store->loadZone(m_zone, m_chunksToFill)) {
+        mp_zonesCompletedLock->lock();
+        mp_zonesCompleted->push_back({m_zone, SURFACE});
+        mp_zonesCompletedLock->unlock();
+        return;
     }
+    for (int stage = m_firstStage; stage <= m_lastStage; stage++) {
+        for (auto &chunk : m_chunksToFill) {
+            chunk->runGenerationStage(static_cast<GenerationStage>(stage), m_biomeBlend);
+        }
+    }
+    mp_zonesCompletedLock->lock();
+    mp_zonesCompleted->push_back({m_zone, m_lastStage});
+    mp_zonesCompletedLock->unlock();
 }
 
 VBOWorker::VBOWorker(Chunk* c, std::vector<ChunkVBOData>* dat, QMutex * datLock) :
@@ -23,6 +35,40 @@ void VBOWorker::run() {
     mp_chunk->createVBOdata();
 
     mp_chunkVBOsCompletedLock->lock();
-    mp_chunkVBOsCompleted->push_back(mp_chunk->m_vboData);
+    // The Chunk doesn't need its copy once the data is uploaded
+    mp_chunkVBOsCompleted->push_back(std::move(mp_chunk->m_vboData));
     mp_chunkVBOsCompletedLock->unlock();
 }
+
+TransparentSortWorker::TransparentSortWorker(const TransparentSortData &sort,
+                                             std::vector<TransparentSortData> *sortsCompleted,
+                                             QMutex *sortsCompletedLock)
+    : m_sort(sort), mp_sortsCompleted(sortsCompleted), mp_sortsCompletedLock(sortsCompletedLock)
+{}
+
+void TransparentSortWorker::run() {
+    const std::vector<glm::vec3> &centers = *m_sort.mp_faceCenters;
+    std::vector<std::pair<float, GLuint>> faces;
+    m_sort.m_indices.clear();
+    m_sort.m_indices.reserve(centers.size() * 6);
+    for (int s = 0; s < CHUNK_SECTIONS; s++) {
+        faces.clear();
+        for (int f = m_sort.m_sectionFaces[s]; f < m_sort.m_sectionFaces[s + 1]; f++) {
+            glm::vec3 d = centers[f] - m_sort.m_eye;
+            faces.push_back({glm::dot(d, d), static_cast<GLuint>(f)});
+        }
+        // Farthest first
+        std::sort(faces.begin(), faces.end(), [](const std::pair<float, GLuint> &a, const std::pair<float, GLuint> &b) {
+            return a.first > b.first;
+        });
+        // Same winding as Chunk::createVBOdata
+        for (auto &face : faces) {
+            GLuint v = face.second * 4;
+            m_sort.m_indices.insert(m_sort.m_indices.end(), {v + 3, v + 1, v + 2, v + 3, v, v + 1});
+        }
+    }
+
+    mp_sortsCompletedLock->lock();
+    mp_sortsCompleted->push_back(std::move(m_sort));
+    mp_sortsCompletedLock->unlock();
+}
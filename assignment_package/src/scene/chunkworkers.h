@@ -1,25 +1,51 @@
 #pragma once
 #include <glm/glm.hpp>
 #include "chunk.h"
+#include "chunkstore.h"
 #include <QRunnable>
 #include <QMutex>
-#include <unordered_set>
+#include <utility>
 
 // BlockTypeWorkers
+// Runs the generation stages firstStage..lastStage over every Chunk of
+// one terrain zone, then reports the zone as having reached lastStage.
+// A zone starting at HEIGHTFIELD is first looked up in the ChunkStore,
+// if there is one, and reported as having reached SURFACE if it loads.
+// It then goes through the remaining stages like any other zone, which
+// leave its stored blocks alone but place the parts of its structures
+// that reach into generated neighbors.
 class FBMWorker : public QRunnable {
 private:
-    // Coords of the terrain zone being generated
-    int m_xCorner, m_zCorner;
+    // Key of the terrain zone being generated
+    int64_t m_zone;
     std::vector<Chunk*> m_chunksToFill;
-    std::unordered_set<Chunk*>* mp_chunksCompleted;
-    QMutex* mp_chunksCompletedLock;
+    GenerationStage m_firstStage, m_lastStage;
+    BiomeBlend m_biomeBlend;
+    std::vector<std::pair<int64_t, GenerationStage>>* mp_zonesCompleted;
+    QMutex* mp_zonesCompletedLock;
+    const ChunkStore* mp_store;
 public:
-    FBMWorker(int x, int z, std::vector<Chunk*> chunksToFill,
-              std::unordered_set<Chunk*>* chunksCompleted, QMutex* ChunksCompletedLock);
+    FBMWorker(int64_t zone, std::vector<Chunk*> chunksToFill,
+              GenerationStage firstStage, GenerationStage lastStage, const BiomeBlend &biomeBlend,
+              std::vector<std::pair<int64_t, GenerationStage>>* zonesCompleted, QMutex* zonesCompletedLock,
+              const ChunkStore* store = nullptr);
     void run() override;
 
 };
 
+// Orders the faces of one Chunk's transparent mesh back to front within
+// each section, for blending
+class TransparentSortWorker : public QRunnable {
+private:
+    TransparentSortData m_sort;
+    std::vector<TransparentSortData>* mp_sortsCompleted;
+    QMutex *mp_sortsCompletedLock;
+public:
+    TransparentSortWorker(const TransparentSortData &sort, std::vector<TransparentSortData>* sortsCompleted,
+                          QMutex *sortsCompletedLock);
+    void run() override;
+};
+
 class VBOWorker : public QRunnable {
 private:
     Chunk* mp_chunk;
@@ -0,0 +1,95 @@
+#include "collision.h"
+#include "terrain.h"
+
+// Gap kept between a box and the blocks it stops against, so that a box
+// resting on a face doesn't count as overlapping the block behind it
+static const float SKIN = 1e-4f;
+
+AABB AABB::translated(glm::vec3 offset) const {
+    return AABB(min + offset, max + offset);
+}
+
+bool blocksMovement(BlockType t) {
+    return t != EMPTY && t != WATER && t != LAVA;
+}
+
+namespace {
+// Reads blocks for one sweep, looking each Chunk up only when the
+// column being read leaves the previous one
+class BlockReader {
+private:
+    const Terrain &mr_terrain;
+    const Chunk *mp_chunk;
+    glm::ivec2 m_chunkOrigin;
+
+public:
+    BlockReader(const Terrain &terrain)
+        : mr_terrain(terrain), mp_chunk(nullptr), m_chunkOrigin(0, 0)
+    {}
+
+    bool isSolid(int x, int y, int z) {
+        if (y < 0 || y >= 256) {
+            return false;
+        }
+        glm::ivec2 origin(16 * glm::ivec2(glm::floor(glm::vec2(x, z) / 16.f)));
+        if (mp_chunk == nullptr || origin != m_chunkOrigin) {
+            mp_chunk = mr_terrain.findChunkAt(x, z);
+            if (mp_chunk == nullptr) {
+                return true;
+            }
+            m_chunkOrigin = origin;
+        }
+        return blocksMovement(mp_chunk->getBlockAt(x - origin.x, y, z - origin.y));
+    }
+};
+
+// How far box can move along axis, up to d, before touching a solid block
+float sweepAxis(const AABB &box, int axis, float d, BlockReader &blocks) {
+    if (d == 0.f) {
+        return 0.f;
+    }
+    int a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+    // Cells the box covers on the other two axes. Faces lying on a cell
+    // boundary don't reach into the next cell.
+    int min1 = int(glm::floor(box.min[a1] + SKIN)), max1 = int(glm::floor(box.max[a1] - SKIN));
+    int min2 = int(glm::floor(box.min[a2] + SKIN)), max2 = int(glm::floor(box.max[a2] - SKIN));
+    // Layers of cells ahead of the leading face, nearest first. Cells the
+    // box already overlaps are ignored, so it can always back out of them.
+    int step = d > 0.f ? 1 : -1;
+    int first = d > 0.f ? int(glm::floor(box.max[axis] - SKIN)) + 1 : int(glm::floor(box.min[axis] + SKIN)) - 1;
+    int last = d > 0.f ? int(glm::floor(box.max[axis] + d)) : int(glm::floor(box.min[axis] + d));
+    for (int layer = first; layer * step <= last * step; layer += step) {
+        glm::ivec3 cell;
+        cell[axis] = layer;
+        for (cell[a1] = min1; cell[a1] <= max1; cell[a1]++) {
+            for (cell[a2] = min2; cell[a2] <= max2; cell[a2]++) {
+                if (!blocks.isSolid(cell.x, cell.y, cell.z)) {
+                    continue;
+                }
+                // Stop just short of the layer's near face
+                if (d > 0.f) {
+                    return glm::max(layer - box.max[axis] - SKIN, 0.f);
+                }
+                return glm::min(layer + 1 - box.min[axis] + SKIN, 0.f);
+            }
+        }
+    }
+    return d;
+}
+}
+
+SweepResult sweepAABB(const AABB &box, glm::vec3 displacement, const Terrain &terrain) {
+    BlockReader blocks(terrain);
+    SweepResult result{glm::vec3(0.f), glm::bvec3(false)};
+    AABB moving = box;
+    // Vertical first, so a box walking along the ground settles onto it
+    // before its horizontal movement is checked
+    for (int axis : {1, 0, 2}) {
+        float d = sweepAxis(moving, axis, displacement[axis], blocks);
+        result.blocked[axis] = d != displacement[axis];
+        result.moved[axis] = d;
+        moving.min[axis] += d;
+        moving.max[axis] += d;
+    }
+    return result;
+}
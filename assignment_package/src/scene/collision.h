@@ -0,0 +1,31 @@
+#pragma once
+#include "glm_includes.h"
+#include "chunkhelpers.h"
+
+class Terrain;
+
+// An axis-aligned box in world space
+struct AABB {
+    glm::vec3 min, max;
+
+    AABB(glm::vec3 min, glm::vec3 max) : min(min), max(max) {}
+    AABB translated(glm::vec3 offset) const;
+};
+
+// How far a box could move and which axes it was stopped on
+struct SweepResult {
+    glm::vec3 moved;
+    glm::bvec3 blocked;
+};
+
+// Whether a block stops entities. Liquids can be moved through.
+bool blocksMovement(BlockType t);
+
+// Moves box by displacement through the Terrain's blocks, one axis at a
+// time (Y, then X, then Z), stopping it against the first solid block
+// along each axis. Every block the box sweeps through is checked, so
+// fast boxes can't pass through thin walls, and blocks the box's sides
+// are only touching don't stop it, so it slides past corners.
+// Unloaded Chunks are treated as solid.
+// Works for boxes of any size.
+SweepResult sweepAABB(const AABB &box, glm::vec3 displacement, const Terrain &terrain);
@@ -6,11 +6,15 @@ struct InputBundle {
     bool spacePressed;
     float mouseX, mouseY;
     bool focused;
+    // Set by a key press or click and cleared after the next simulation
+    // step, so each one acts exactly once
+    bool flightToggled, leftClicked, rightClicked;
 
     InputBundle()
         : wPressed(false), aPressed(false), sPressed(false),
           dPressed(false), qPressed(false), ePressed(false),
-          spacePressed(false), mouseX(0.f), mouseY(0.f), focused(false)
+          spacePressed(false), mouseX(0.f), mouseY(0.f), focused(false),
+          flightToggled(false), leftClicked(false), rightClicked(false)
     {}
 
 };
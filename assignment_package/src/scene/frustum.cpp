@@ -0,0 +1,32 @@
+#include "frustum.h"
+
+Frustum::Frustum(const glm::mat4 &viewProj)
+    : m_planes()
+{
+    // Gribb & Hartmann: each plane is the last row of the matrix plus or
+    // minus one of the others. glm is column-major, so row i is m[.][i].
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        m_planes[2 * i] = rows[3] + rows[i];
+        m_planes[2 * i + 1] = rows[3] - rows[i];
+    }
+    for (glm::vec4 &p : m_planes) {
+        p /= glm::length(glm::vec3(p));
+    }
+}
+
+bool Frustum::intersectsAABB(glm::vec3 min, glm::vec3 max) const {
+    for (const glm::vec4 &p : m_planes) {
+        // The box corner furthest along the plane's normal
+        glm::vec3 corner(p.x >= 0.f ? max.x : min.x,
+                         p.y >= 0.f ? max.y : min.y,
+                         p.z >= 0.f ? max.z : min.z);
+        if (glm::dot(glm::vec3(p), corner) + p.w < 0.f) {
+            return false;
+        }
+    }
+    return true;
+}
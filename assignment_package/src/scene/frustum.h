@@ -0,0 +1,19 @@
+#pragma once
+#include "glm_includes.h"
+#include <array>
+
+// The six clipping planes of a view-projection matrix, used to skip
+// geometry that can't be on screen
+class Frustum {
+private:
+    // Left, right, bottom, top, near, far. Each plane is (n, d) with n
+    // pointing into the frustum, so a point p is inside when dot(n, p) + d >= 0
+    std::array<glm::vec4, 6> m_planes;
+
+public:
+    Frustum(const glm::mat4 &viewProj);
+
+    // Conservative: may return true for a box that is just outside
+    // near a corner of the frustum, but never false for a visible one
+    bool intersectsAABB(glm::vec3 min, glm::vec3 max) const;
+};
@@ -0,0 +1,165 @@
+#include "heightmapfile.h"
+#include "glm_includes.h"
+#include <QFileInfo>
+#include <QImageReader>
+#include <QRegularExpression>
+#include <QtEndian>
+#include <climits>
+#include <cmath>
+
+namespace {
+// Images are decoded whole, so larger height maps have to be given as
+// raw grids, which are memory mapped
+const qint64 MAX_IMAGE_PIXELS = 4096 * 4096;
+
+// The colors colored height maps are matched against
+const std::pair<glm::ivec3, BlockType> COLOR_BLOCKS[] = {
+    {glm::ivec3(0, 0, 0), BLACK},
+    {glm::ivec3(255, 255, 255), WHITE},
+    {glm::ivec3(255, 0, 0), RED},
+    {glm::ivec3(0, 255, 0), LIME},
+    {glm::ivec3(0, 0, 255), BLUE},
+    {glm::ivec3(255, 255, 0), YELLOW},
+    {glm::ivec3(0, 255, 255), CYAN},
+    {glm::ivec3(255, 0, 255), MAGENTA},
+    {glm::ivec3(192, 192, 192), SILVER},
+    {glm::ivec3(128, 128, 128), GRAY},
+    {glm::ivec3(128, 0, 0), MAROON},
+    {glm::ivec3(128, 128, 0), OLIVE},
+    {glm::ivec3(0, 128, 0), GREEN},
+    {glm::ivec3(128, 0, 128), PURPLE},
+    {glm::ivec3(0, 128, 128), TEAL},
+    {glm::ivec3(0, 0, 128), NAVY}
+};
+
+BlockType closestColorBlock(glm::ivec3 color) {
+    BlockType best = BLACK;
+    int bestDistance = INT_MAX;
+    for (const auto &c : COLOR_BLOCKS) {
+        glm::ivec3 d = color - c.first;
+        int distance = d.x * d.x + d.y * d.y + d.z * d.z;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = c.second;
+        }
+    }
+    return best;
+}
+
+int paletteIndex(QRgb c) {
+    return (qRed(c) >> 3) << 10 | (qGreen(c) >> 3) << 5 | qBlue(c) >> 3;
+}
+}
+
+HeightMapFile::HeightMapFile()
+    : m_format(GRAY_IMAGE), m_file(), mp_map(nullptr), m_image(), m_width(0), m_height(0), m_palette()
+{}
+
+bool HeightMapFile::open(const QString &path, QString *error) {
+    QString suffix = QFileInfo(path).suffix().toLower();
+    if (suffix == "r16" || suffix == "raw") {
+        return openRaw(path, RAW_U16, error);
+    }
+    if (suffix == "r32" || suffix == "f32") {
+        return openRaw(path, RAW_F32, error);
+    }
+    return openImage(path, error);
+}
+
+bool HeightMapFile::openRaw(const QString &path, Format format, QString *error) {
+    m_format = format;
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        *error = m_file.errorString();
+        return false;
+    }
+    qint64 pixelSize = format == RAW_U16 ? 2 : 4;
+    qint64 pixels = m_file.size() / pixelSize;
+    QRegularExpressionMatch size = QRegularExpression("_(\\d+)x(\\d+)$").match(QFileInfo(path).completeBaseName());
+    if (size.hasMatch()) {
+        m_width = size.captured(1).toInt();
+        m_height = size.captured(2).toInt();
+    } else {
+        m_width = m_height = static_cast<int>(std::llround(std::sqrt(double(pixels))));
+    }
+    if (m_width <= 0 || m_height <= 0 || qint64(m_width) * m_height * pixelSize != m_file.size()) {
+        *error = "The file's size doesn't match its dimensions; name it <name>_<width>x<height>." +
+                 QFileInfo(path).suffix();
+        return false;
+    }
+    mp_map = m_file.map(0, m_file.size());
+    if (mp_map == nullptr) {
+        *error = m_file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool HeightMapFile::openImage(const QString &path, QString *error) {
+    QImageReader reader(path);
+    QSize size = reader.size();
+    if (size.isValid() && qint64(size.width()) * size.height() > MAX_IMAGE_PIXELS) {
+        *error = QString("The image is %1x%2 pixels. Images over 4096x4096 are decoded whole, so save larger "
+                         "height maps as raw 16-bit grids named <name>_%1x%2.r16 instead.")
+                     .arg(size.width()).arg(size.height());
+        return false;
+    }
+    QImage image = reader.read();
+    if (image.isNull()) {
+        *error = "Not a readable image.";
+        return false;
+    }
+    m_width = image.width();
+    m_height = image.height();
+    if (image.allGray()) {
+        m_format = GRAY_IMAGE;
+        m_image = image.convertToFormat(QImage::Format_Grayscale16);
+    } else {
+        m_format = COLOR_IMAGE;
+        m_image = image.convertToFormat(QImage::Format_RGB32);
+        // Matching each pixel against every color is done once per
+        // 15-bit color instead
+        m_palette.resize(1 << 15);
+        for (int i = 0; i < (1 << 15); i++) {
+            glm::ivec3 color(i >> 10 & 31, i >> 5 & 31, i & 31);
+            m_palette[i] = closestColorBlock(color * 8 + 4);
+        }
+    }
+    return true;
+}
+
+int HeightMapFile::width() const {
+    return m_width;
+}
+
+int HeightMapFile::height() const {
+    return m_height;
+}
+
+bool HeightMapFile::needsNormalizing() const {
+    return m_format == RAW_U16 || m_format == RAW_F32;
+}
+
+bool HeightMapFile::isColor() const {
+    return m_format == COLOR_IMAGE;
+}
+
+float HeightMapFile::sample(int x, int y) const {
+    size_t i = size_t(y) * m_width + x;
+    switch (m_format) {
+    case RAW_U16:
+        return qFromLittleEndian<quint16>(mp_map + 2 * i);
+    case RAW_F32:
+        return qFromLittleEndian<float>(mp_map + 4 * i);
+    case GRAY_IMAGE:
+        return reinterpret_cast<const quint16*>(m_image.constScanLine(y))[x] / 65535.f;
+    default: {
+        QRgb c = reinterpret_cast<const QRgb*>(m_image.constScanLine(y))[x];
+        return (0.2126f * qRed(c) + 0.7152f * qGreen(c) + 0.0722f * qBlue(c)) / 255.f;
+    }
+    }
+}
+
+BlockType HeightMapFile::colorBlock(int x, int y) const {
+    return m_palette[paletteIndex(reinterpret_cast<const QRgb*>(m_image.constScanLine(y))[x])];
+}
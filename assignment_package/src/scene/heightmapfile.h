@@ -0,0 +1,49 @@
+#pragma once
+#include "chunkhelpers.h"
+#include <QFile>
+#include <QImage>
+#include <QString>
+#include <vector>
+
+// A height map to import, one pixel per block column. Raw grids of
+// little-endian 16-bit integers (.r16, .raw) or 32-bit floats (.r32,
+// .f32) are memory mapped, so only the pages being read are resident
+// however large the file is. Their size is taken from a "_<width>x<height>"
+// suffix of the file name, or they must be square. Any other file is
+// decoded whole by QImage, so it may be at most 4096 x 4096 pixels: gray
+// images only give heights, colored ones also give the color block
+// closest to each pixel.
+class HeightMapFile {
+private:
+    enum Format { RAW_U16, RAW_F32, GRAY_IMAGE, COLOR_IMAGE };
+    Format m_format;
+    QFile m_file;
+    const uchar *mp_map;
+    // Decoded to Grayscale16 or RGB32
+    QImage m_image;
+    int m_width, m_height;
+    // Closest color block of every 15-bit color, for COLOR_IMAGE
+    std::vector<BlockType> m_palette;
+
+    bool openRaw(const QString &path, Format format, QString *error);
+    bool openImage(const QString &path, QString *error);
+
+public:
+    HeightMapFile();
+    HeightMapFile(const HeightMapFile&) = delete;
+    HeightMapFile& operator=(const HeightMapFile&) = delete;
+
+    // Returns false, setting error, if path can't be read
+    bool open(const QString &path, QString *error);
+
+    int width() const;
+    int height() const;
+    // Raw grids hold arbitrary values, which sample() returns as they
+    // are. Images are already scaled to [0, 1].
+    bool needsNormalizing() const;
+    bool isColor() const;
+    // The value of pixel (x, y). Safe to call from any thread.
+    float sample(int x, int y) const;
+    // The color block closest to pixel (x, y) of a colored image
+    BlockType colorBlock(int x, int y) const;
+};
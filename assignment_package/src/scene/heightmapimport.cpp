@@ -0,0 +1,213 @@
+#include "heightmapimport.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace {
+// Rows of a raw grid scanned by a worker at a time
+const int SCAN_ROWS = 64;
+
+// The i-th offset of a square spiral: 0 is the center, followed by the
+// 8 offsets around it, the 16 around those, and so on
+glm::ivec2 spiralOffset(int i) {
+    if (i == 0) {
+        return glm::ivec2(0);
+    }
+    // Ring r holds [(2r - 1)^2, (2r + 1)^2)
+    int r = static_cast<int>((std::sqrt(double(i)) + 1.0) / 2.0);
+    while ((2 * r + 1) * (2 * r + 1) <= i) {
+        r++;
+    }
+    while ((2 * r - 1) * (2 * r - 1) > i) {
+        r--;
+    }
+    int k = i - (2 * r - 1) * (2 * r - 1);
+    int t = k % (2 * r);
+    switch (k / (2 * r)) {
+    case 0:  return glm::ivec2(-r + t, -r);
+    case 1:  return glm::ivec2(r, -r + t);
+    case 2:  return glm::ivec2(r - t, r);
+    default: return glm::ivec2(-r, r - t);
+    }
+}
+
+int zoneCorner(int v) {
+    return v & ~63;
+}
+}
+
+HeightMapImport::HeightMapImport(sPtr<const HeightMapFile> file, const ChunkStore &store, unsigned int seed,
+                                 const BiomeBlend &blend, glm::ivec2 center)
+    : mp_file(file), m_store(store), m_seed(seed), m_blend(blend),
+      m_origin(center - glm::ivec2(file->width(), file->height()) / 2),
+      m_centerZone(zoneCorner(center.x), zoneCorner(center.y)), m_spiralLength(0),
+      m_nextRow(0), m_rowsScanned(0), m_min(0.f), m_max(1.f), m_rangeLock(),
+      m_nextZone(0), m_zonesWritten(0), m_failed(false), m_cancelled(false),
+      m_finishedZones(), m_finishedZonesLock()
+{
+    glm::ivec2 last = m_origin + getSize() - 1;
+    int radius = 0;
+    for (int corner : {m_origin.x, last.x}) {
+        radius = std::max(radius, std::abs(zoneCorner(corner) - m_centerZone.x) / 64);
+    }
+    for (int corner : {m_origin.y, last.y}) {
+        radius = std::max(radius, std::abs(zoneCorner(corner) - m_centerZone.y) / 64);
+    }
+    m_spiralLength = (2 * radius + 1) * (2 * radius + 1);
+    if (mp_file->needsNormalizing()) {
+        m_min = std::numeric_limits<float>::max();
+        m_max = std::numeric_limits<float>::lowest();
+    }
+}
+
+void HeightMapImport::scanRange() {
+    int rows = mp_file->height();
+    for (int row = m_nextRow.fetch_add(SCAN_ROWS); row < rows && !m_cancelled; row = m_nextRow.fetch_add(SCAN_ROWS)) {
+        int end = std::min(row + SCAN_ROWS, rows);
+        float lo = std::numeric_limits<float>::max(), hi = std::numeric_limits<float>::lowest();
+        for (int y = row; y < end; y++) {
+            for (int x = 0; x < mp_file->width(); x++) {
+                float v = mp_file->sample(x, y);
+                // NaN is a common no-data value
+                if (v == v) {
+                    lo = std::min(lo, v);
+                    hi = std::max(hi, v);
+                }
+            }
+        }
+        m_rangeLock.lock();
+        m_min = std::min(m_min, lo);
+        m_max = std::max(m_max, hi);
+        m_rangeLock.unlock();
+        m_rowsScanned.fetch_add(end - row, std::memory_order_release);
+    }
+    // Rows other workers took may still be being scanned
+    while (m_rowsScanned.load(std::memory_order_acquire) < rows && !m_cancelled) {
+        std::this_thread::yield();
+    }
+}
+
+void HeightMapImport::importZone(int64_t zone) {
+    glm::ivec2 corner = toCoords(zone);
+    std::vector<uPtr<Chunk>> chunks;
+    std::vector<Chunk*> writable;
+    for (int x = corner.x; x < corner.x + 64; x += 16) {
+        for (int z = corner.y; z < corner.y + 64; z += 16) {
+            chunks.push_back(mkU<Chunk>(nullptr, x, z, m_seed));
+            writable.push_back(chunks.back().get());
+        }
+    }
+    glm::ivec2 lo = glm::max(corner, m_origin);
+    glm::ivec2 hi = glm::min(corner + 64, m_origin + getSize());
+    bool covered = lo == corner && hi == corner + 64;
+    if (!covered && !m_store.loadZone(zone, writable)) {
+        for (GenerationStage stage : {HEIGHTFIELD, CAVES, SURFACE, FLUIDS}) {
+            for (Chunk *c : writable) {
+                c->runGenerationStage(stage, m_blend);
+            }
+        }
+    }
+
+    for (Chunk *c : writable) {
+        glm::ivec2 pos = c->getPos();
+        std::array<int, 256> heightMap = c->getHeightMap();
+        int xEnd = std::min(hi.x, pos.x + 16), zEnd = std::min(hi.y, pos.y + 16);
+        for (int x = std::max(lo.x, pos.x); x < xEnd; x++) {
+            for (int z = std::max(lo.y, pos.y); z < zEnd; z++) {
+                ImportedColumn col = column(x, z);
+                int lx = x - pos.x, lz = z - pos.y;
+                c->fillColumn(lx, lz, 0, std::min(col.height - 1, 128), col.lower);
+                c->fillColumn(lx, lz, 128, col.height - 1, col.upper);
+                c->fillColumn(lx, lz, col.height - 1, col.height, col.top);
+                c->fillColumn(lx, lz, col.height, 256, EMPTY);
+                heightMap[lx + 16 * lz] = col.height - 1;
+            }
+        }
+        c->setHeightMap(heightMap);
+    }
+
+    std::vector<const Chunk*> readable(writable.begin(), writable.end());
+    if (!m_store.saveZone(zone, readable)) {
+        m_failed = true;
+    }
+}
+
+void HeightMapImport::run() {
+    if (mp_file->needsNormalizing()) {
+        scanRange();
+    }
+    glm::ivec2 first = glm::ivec2(zoneCorner(m_origin.x), zoneCorner(m_origin.y));
+    glm::ivec2 last = m_origin + getSize() - 1;
+    for (int i = m_nextZone.fetch_add(1); i < m_spiralLength && !m_cancelled; i = m_nextZone.fetch_add(1)) {
+        glm::ivec2 corner = m_centerZone + 64 * spiralOffset(i);
+        // The spiral is square, the height map may not be
+        if (corner.x < first.x || corner.y < first.y || corner.x > last.x || corner.y > last.y) {
+            continue;
+        }
+        int64_t zone = toKey(corner.x, corner.y);
+        importZone(zone);
+        m_zonesWritten++;
+        m_finishedZonesLock.lock();
+        m_finishedZones.push_back(zone);
+        m_finishedZonesLock.unlock();
+    }
+}
+
+void HeightMapImport::cancel() {
+    m_cancelled = true;
+}
+
+int HeightMapImport::zoneCount() const {
+    glm::ivec2 last = m_origin + getSize() - 1;
+    glm::ivec2 zones = (glm::ivec2(zoneCorner(last.x), zoneCorner(last.y)) -
+                        glm::ivec2(zoneCorner(m_origin.x), zoneCorner(m_origin.y))) / 64 + 1;
+    return zones.x * zones.y;
+}
+
+int HeightMapImport::zonesWritten() const {
+    return m_zonesWritten;
+}
+
+bool HeightMapImport::failed() const {
+    return m_failed;
+}
+
+void HeightMapImport::takeFinishedZones(std::vector<int64_t> *out) {
+    QMutexLocker lock(&m_finishedZonesLock);
+    out->insert(out->end(), m_finishedZones.begin(), m_finishedZones.end());
+    m_finishedZones.clear();
+}
+
+glm::ivec2 HeightMapImport::getOrigin() const {
+    return m_origin;
+}
+
+glm::ivec2 HeightMapImport::getSize() const {
+    return glm::ivec2(mp_file->width(), mp_file->height());
+}
+
+ImportedColumn HeightMapImport::column(int x, int z) const {
+    glm::ivec2 p = glm::ivec2(x, z) - m_origin;
+    float v = mp_file->sample(p.x, p.y);
+    if (mp_file->needsNormalizing()) {
+        v = m_max > m_min && v == v ? (v - m_min) / (m_max - m_min) : 0.f;
+    }
+    // The small bias keeps whole heights from rounding up a block
+    int height = static_cast<int>(std::ceil(MIN_HEIGHT + HEIGHT_RANGE * v - 1e-4f));
+    height = glm::clamp(height, 1, 256);
+    if (mp_file->isColor()) {
+        BlockType t = mp_file->colorBlock(p.x, p.y);
+        return {height, t, t, t};
+    }
+    return {height, GRASS, DIRT, STONE};
+}
+
+HeightMapImportWorker::HeightMapImportWorker(sPtr<HeightMapImport> import)
+    : mp_import(import)
+{}
+
+void HeightMapImportWorker::run() {
+    mp_import->run();
+}
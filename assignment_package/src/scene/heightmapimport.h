@@ -0,0 +1,87 @@
+#pragma once
+#include "heightmapfile.h"
+#include "chunkstore.h"
+#include "terrain.h"
+#include "smartpointerhelp.h"
+#include <QMutex>
+#include <QRunnable>
+#include <atomic>
+#include <vector>
+
+// Writes a HeightMapFile into a world directory one terrain zone at a
+// time, so only the zones being written are ever in memory. Zones are
+// handed out from the zone at the center outwards, so the ones around
+// the Player are done first. Any number of HeightMapImportWorkers can run
+// the import together; they share out rows of a raw grid to find its
+// range first, then the zones.
+// Zones the height map only partly covers keep what the world directory
+// already had there, or are generated, without DECORATION since that
+// needs their neighbors.
+class HeightMapImport {
+public:
+    // Heights of the imported columns, from the lowest to the
+    // highest value of the height map
+    static constexpr float MIN_HEIGHT = 128.f;
+    static constexpr float HEIGHT_RANGE = 63.75f;
+
+private:
+    sPtr<const HeightMapFile> mp_file;
+    ChunkStore m_store;
+    unsigned int m_seed;
+    BiomeBlend m_blend;
+    // World position of the height map's first pixel
+    glm::ivec2 m_origin;
+    // Zone the spiral of zones starts from, and how many zones it
+    // takes to cover the whole height map
+    glm::ivec2 m_centerZone;
+    int m_spiralLength;
+
+    // Raw grids' values are mapped from [m_min, m_max] to [0, 1]
+    std::atomic<int> m_nextRow, m_rowsScanned;
+    float m_min, m_max;
+    QMutex m_rangeLock;
+
+    std::atomic<int> m_nextZone;
+    std::atomic<int> m_zonesWritten;
+    std::atomic<bool> m_failed;
+    std::atomic<bool> m_cancelled;
+    std::vector<int64_t> m_finishedZones;
+    QMutex m_finishedZonesLock;
+
+    void scanRange();
+    void importZone(int64_t zone);
+
+public:
+    // The height map's center goes at center. Zone files are written
+    // through store, and generated with seed and blend where needed.
+    HeightMapImport(sPtr<const HeightMapFile> file, const ChunkStore &store, unsigned int seed,
+                    const BiomeBlend &blend, glm::ivec2 center);
+
+    // Works on the import until every zone has been taken
+    void run();
+    // Makes every worker stop after the zone it's on
+    void cancel();
+
+    // Zones the height map covers part of
+    int zoneCount() const;
+    int zonesWritten() const;
+    // Whether a zone file couldn't be written
+    bool failed() const;
+    // Moves the zones written since the last call into out
+    void takeFinishedZones(std::vector<int64_t> *out);
+
+    // World-space area covered by the height map
+    glm::ivec2 getOrigin() const;
+    glm::ivec2 getSize() const;
+    // The column of world position (x, z), which must be covered.
+    // Only valid for zones that have been reported as finished.
+    ImportedColumn column(int x, int z) const;
+};
+
+class HeightMapImportWorker : public QRunnable {
+private:
+    sPtr<HeightMapImport> mp_import;
+public:
+    HeightMapImportWorker(sPtr<HeightMapImport> import);
+    void run() override;
+};
@@ -0,0 +1,218 @@
+#include "mobsystem.h"
+#include "terrain.h"
+#include "parallelfor.h"
+
+namespace {
+const float WALK_SPEED = 2.5f;
+// Chance that a new wander choice is to stand still
+const float IDLE_CHANCE = 0.3f;
+// How quickly horizontal velocity follows the wanted one, per second
+const float STEER_RATE = 8.f;
+const float GRAVITY = -30.f;
+const float MAX_FALL_SPEED = -50.f;
+// Enough to get onto a block
+const float JUMP_VELOCITY = 8.f;
+// Mobs closer than this push each other apart
+const float SEPARATION_RADIUS = 1.2f;
+const float SEPARATION_SPEED = 2.f;
+// A mob that moved further than this in one tick was respawned and
+// isn't interpolated
+const float TELEPORT_DISTANCE = 4.f;
+
+// The box of a mob standing at feet
+AABB mobBox(glm::vec3 feet) {
+    glm::vec3 half(MobSystem::SIZE / 2.f, 0.f, MobSystem::SIZE / 2.f);
+    return AABB(feet - half, feet + glm::vec3(MobSystem::SIZE / 2.f, MobSystem::SIZE, MobSystem::SIZE / 2.f));
+}
+
+// xorshift32, uniform in [0, 1)
+float nextRandom(std::uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.f / 16777216.f);
+}
+}
+
+MobSystem::MobSystem(const Terrain &terrain)
+    : mcr_terrain(terrain), m_positions(), m_prevPositions(), m_velocities(), m_wander(),
+      m_wanderTimers(), m_grounded(), m_blockedSideways(), m_rngStates(), m_colors(),
+      m_neighbors(2.f * SEPARATION_RADIUS), m_playerPos(0.f), m_dT(0.f),
+      m_spawnRadius(DEFAULT_SIMULATION_DISTANCE / 2.f), m_despawnRadius(DEFAULT_SIMULATION_DISTANCE)
+{}
+
+bool MobSystem::findSpawnPoint(glm::vec3 center, float radius, std::uint32_t &rng, glm::vec3 *out) const {
+    float angle = nextRandom(rng) * 6.2831853f;
+    // sqrt spreads the mobs evenly over the disc
+    float distance = radius * glm::sqrt(nextRandom(rng));
+    int x = int(glm::floor(center.x + glm::cos(angle) * distance));
+    int z = int(glm::floor(center.z + glm::sin(angle) * distance));
+    const Chunk *c = mcr_terrain.findChunkAt(x, z);
+    if (c == nullptr) {
+        return false;
+    }
+    glm::ivec2 corner = c->getPos();
+    for (int y = 16 * c->getTopSection() - 1; y >= 0; y--) {
+        BlockType t = c->getBlockAt(x - corner.x, y, z - corner.y);
+        if (t == EMPTY) {
+            continue;
+        }
+        // Only stand on solid ground, not in water or lava
+        if (!blocksMovement(t) || y + 1 >= 256) {
+            return false;
+        }
+        *out = glm::vec3(x + 0.5f, y + 1.f, z + 0.5f);
+        return true;
+    }
+    return false;
+}
+
+void MobSystem::spawn(glm::vec3 center, int count, float radius) {
+    std::uint32_t rng = 2654435761u * static_cast<std::uint32_t>(m_positions.size() + 1);
+    // Give up after a few misses per mob, the area may be mostly water
+    int attempts = 4 * count;
+    for (int attempt = 0; attempt < attempts && count > 0; attempt++) {
+        glm::vec3 p;
+        if (!findSpawnPoint(center, radius, rng, &p)) {
+            continue;
+        }
+        count--;
+        m_positions.push_back(p);
+        m_prevPositions.push_back(p);
+        m_velocities.push_back(glm::vec3(0.f));
+        m_wander.push_back(glm::vec2(0.f));
+        m_wanderTimers.push_back(0.f);
+        m_grounded.push_back(false);
+        m_blockedSideways.push_back(false);
+        // Each mob's generator must start from a different nonzero state
+        m_rngStates.push_back(rng | 1u);
+        nextRandom(rng);
+        // Pink, white or brown
+        float kind = nextRandom(rng);
+        glm::vec3 color = kind < 0.33f ? glm::vec3(0.95f, 0.6f, 0.65f) :
+                          kind < 0.66f ? glm::vec3(0.9f, 0.9f, 0.88f) : glm::vec3(0.45f, 0.3f, 0.2f);
+        m_colors.push_back(color * (0.85f + 0.15f * nextRandom(rng)));
+    }
+}
+
+void MobSystem::clear() {
+    m_positions.clear();
+    m_prevPositions.clear();
+    m_velocities.clear();
+    m_wander.clear();
+    m_wanderTimers.clear();
+    m_grounded.clear();
+    m_blockedSideways.clear();
+    m_rngStates.clear();
+    m_colors.clear();
+}
+
+int MobSystem::count() const {
+    return static_cast<int>(m_positions.size());
+}
+
+void MobSystem::setSimulationDistance(float distance) {
+    m_despawnRadius = distance;
+    m_spawnRadius = distance / 2.f;
+}
+
+float MobSystem::getSpawnRadius() const {
+    return m_spawnRadius;
+}
+
+void MobSystem::tick(float dT, glm::vec3 playerPos) {
+    if (m_positions.empty()) {
+        return;
+    }
+    m_prevPositions = m_positions;
+    m_neighbors.build(m_prevPositions);
+    m_playerPos = playerPos;
+    m_dT = dT;
+
+    parallelFor(count(), BATCH_SIZE, [this](int begin, int end) {
+        tickBatch(begin, end);
+    });
+}
+
+void MobSystem::tickBatch(int begin, int end) {
+    float dT = m_dT;
+    for (int i = begin; i < end; i++) {
+        glm::vec3 pos = m_prevPositions[i];
+        glm::vec3 vel = m_velocities[i];
+        std::uint32_t &rng = m_rngStates[i];
+
+        glm::vec3 toPlayer = m_playerPos - pos;
+        if (glm::length(toPlayer) > m_despawnRadius) {
+            // Left behind, or fell out of the world. Tried again next
+            // tick if there's no ground at the chosen spot.
+            glm::vec3 p;
+            if (findSpawnPoint(m_playerPos, m_spawnRadius, rng, &p)) {
+                m_positions[i] = p;
+                m_velocities[i] = glm::vec3(0.f);
+            }
+            continue;
+        }
+
+        // Wander in a random direction for a few seconds at a time
+        m_wanderTimers[i] -= dT;
+        if (m_wanderTimers[i] <= 0.f) {
+            float angle = nextRandom(rng) * 6.2831853f;
+            float speed = nextRandom(rng) < IDLE_CHANCE ? 0.f : WALK_SPEED * (0.5f + 0.5f * nextRandom(rng));
+            m_wander[i] = glm::vec2(glm::cos(angle), glm::sin(angle)) * speed;
+            m_wanderTimers[i] = 2.f + 4.f * nextRandom(rng);
+        }
+        glm::vec2 desired = m_wander[i];
+        glm::vec2 home(toPlayer.x, toPlayer.z);
+        if (glm::length(home) > m_spawnRadius) {
+            desired = glm::normalize(home) * WALK_SPEED;
+        }
+
+        // Push away from the mobs that are too close
+        glm::vec2 push(0.f);
+        m_neighbors.forEachNear(m_prevPositions, pos, SEPARATION_RADIUS, [&](int j) {
+            glm::vec2 d(pos.x - m_prevPositions[j].x, pos.z - m_prevPositions[j].z);
+            float len = glm::length(d);
+            if (j != i && len > 1e-4f) {
+                push += d / len * (1.f - len / SEPARATION_RADIUS);
+            }
+        });
+        desired += push * SEPARATION_SPEED;
+
+        float steer = glm::min(1.f, STEER_RATE * dT);
+        vel.x += (desired.x - vel.x) * steer;
+        vel.z += (desired.y - vel.z) * steer;
+        vel.y = glm::max(vel.y + GRAVITY * dT, MAX_FALL_SPEED);
+        // Hop onto whatever it walked into
+        if (m_grounded[i] && m_blockedSideways[i]) {
+            vel.y = JUMP_VELOCITY;
+        }
+
+        SweepResult r = sweepAABB(mobBox(pos), vel * dT, mcr_terrain);
+        m_grounded[i] = r.blocked.y && vel.y < 0.f;
+        m_blockedSideways[i] = r.blocked.x || r.blocked.z;
+        for (int axis = 0; axis < 3; axis++) {
+            if (r.blocked[axis]) {
+                vel[axis] = 0.f;
+            }
+        }
+        m_positions[i] = pos + r.moved;
+        m_velocities[i] = vel;
+    }
+}
+
+void MobSystem::getInstances(float alpha, const Frustum &frustum,
+                             std::vector<glm::vec3> *offsets, std::vector<glm::vec3> *colors) const {
+    offsets->clear();
+    colors->clear();
+    for (int i = 0; i < count(); i++) {
+        glm::vec3 p = m_positions[i];
+        if (glm::distance(m_prevPositions[i], p) < TELEPORT_DISTANCE) {
+            p = glm::mix(m_prevPositions[i], p, alpha);
+        }
+        AABB box = mobBox(p);
+        if (frustum.intersectsAABB(box.min, box.max)) {
+            offsets->push_back(box.min);
+            colors->push_back(m_colors[i]);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "glm_includes.h"
+#include "spatialhash.h"
+#include "collision.h"
+#include "frustum.h"
+#include <cstdint>
+#include <vector>
+
+class Terrain;
+
+// Every wandering mob in the world. Unlike the Player, mobs aren't
+// Entities: each of their components lives in its own array indexed by
+// mob, so one tick streams through contiguous memory, and the tick is
+// split into batches of mobs that run in parallel through parallelFor.
+// Mobs steer away from each other through a SpatialHash and move
+// through the Terrain with the same sweepAABB as the Player.
+class MobSystem {
+public:
+    // Mobs are SIZE x SIZE x SIZE boxes, positioned by the center of
+    // their bottom face. Must match MOB_SIZE in mob.vert.glsl.
+    static constexpr float SIZE = 0.8f;
+    // See setSimulationDistance
+    static constexpr float DEFAULT_SIMULATION_DISTANCE = 96.f;
+    // Mobs processed by one worker at a time
+    static constexpr int BATCH_SIZE = 256;
+
+private:
+    const Terrain &mcr_terrain;
+
+    // Components, one element per mob
+    std::vector<glm::vec3> m_positions;
+    // Positions before the last tick(), which the tick reads neighbors
+    // from while it writes m_positions, and rendering interpolates from
+    std::vector<glm::vec3> m_prevPositions;
+    std::vector<glm::vec3> m_velocities;
+    // Horizontal direction and speed the mob currently wants to walk at
+    std::vector<glm::vec2> m_wander;
+    // Seconds until the mob picks a new direction
+    std::vector<float> m_wanderTimers;
+    // Set when the mob stood on a block or walked into one last tick
+    std::vector<unsigned char> m_grounded;
+    std::vector<unsigned char> m_blockedSideways;
+    std::vector<std::uint32_t> m_rngStates;
+    std::vector<glm::vec3> m_colors;
+
+    // Buckets m_prevPositions during a tick
+    SpatialHash m_neighbors;
+    // What the running tick() was called with
+    glm::vec3 m_playerPos;
+    float m_dT;
+    // Mobs are placed within m_spawnRadius of the Player, and walk back
+    // towards it once they're further away. Mobs m_despawnRadius away
+    // are moved back near it.
+    float m_spawnRadius, m_despawnRadius;
+
+    // Finds a place on the surface within radius of center, or returns
+    // false if the Chunk there isn't loaded or has no ground
+    bool findSpawnPoint(glm::vec3 center, float radius, std::uint32_t &rng, glm::vec3 *out) const;
+
+public:
+    MobSystem(const Terrain &terrain);
+
+    // Places count more mobs on the surface around center
+    void spawn(glm::vec3 center, int count, float radius);
+    void clear();
+    int count() const;
+
+    // Mobs are kept within distance blocks of the Player, and
+    // spawned within half of it
+    void setSimulationDistance(float distance);
+    float getSpawnRadius() const;
+
+    // Advances every mob by dT seconds: wandering, keeping near
+    // playerPos, avoiding neighbors, gravity and collisions
+    void tick(float dT, glm::vec3 playerPos);
+    // Runs the tick for mobs [begin, end). Batches only write to their
+    // own mobs, so they can run on any thread at the same time.
+    void tickBatch(int begin, int end);
+
+    // The bottom corner and color of every mob that intersects frustum,
+    // alpha of the way from its position before the last tick to its
+    // current one
+    void getInstances(float alpha, const Frustum &frustum,
+                      std::vector<glm::vec3> *offsets, std::vector<glm::vec3> *colors) const;
+};
@@ -0,0 +1,78 @@
+#include "parallelfor.h"
+#include "smartpointerhelp.h"
+#include <QRunnable>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace {
+// One parallelFor call split into batches. Every thread working on it
+// takes batches until none are left.
+class BatchJob {
+private:
+    const std::function<void(int, int)> *mp_f;
+    int m_count;
+    int m_batchSize;
+    int m_batches;
+    std::atomic<int> m_next;
+    std::atomic<int> m_done;
+
+public:
+    BatchJob(const std::function<void(int, int)> *f, int count, int batchSize)
+        : mp_f(f), m_count(count), m_batchSize(batchSize),
+          m_batches((count + batchSize - 1) / batchSize), m_next(0), m_done(0)
+    {}
+
+    int batches() const {
+        return m_batches;
+    }
+
+    void run() {
+        for (int b = m_next.fetch_add(1); b < m_batches; b = m_next.fetch_add(1)) {
+            int begin = b * m_batchSize;
+            (*mp_f)(begin, std::min(begin + m_batchSize, m_count));
+            m_done.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    // Returns once every batch has finished. Only batches other threads
+    // already started are waited on, so this never waits long.
+    void wait() {
+        while (m_done.load(std::memory_order_acquire) < m_batches) {
+            std::this_thread::yield();
+        }
+    }
+};
+
+// Helps with a BatchJob on the worker pool. A worker that starts after
+// the job's batches are all taken does nothing, so it never calls f
+// after parallelFor returned.
+class BatchWorker : public QRunnable {
+private:
+    sPtr<BatchJob> mp_job;
+
+public:
+    BatchWorker(sPtr<BatchJob> job) : mp_job(job) {}
+    void run() override {
+        mp_job->run();
+    }
+};
+}
+
+void parallelFor(int count, int batchSize, const std::function<void(int, int)> &f) {
+    if (count <= 0) {
+        return;
+    }
+    sPtr<BatchJob> job = mkS<BatchJob>(&f, count, std::max(batchSize, 1));
+    QThreadPool *pool = QThreadPool::globalInstance();
+    for (int i = 1; i < job->batches(); i++) {
+        BatchWorker *worker = new BatchWorker(job);
+        if (!pool->tryStart(worker)) {
+            delete worker;
+            break;
+        }
+    }
+    job->run();
+    job->wait();
+}
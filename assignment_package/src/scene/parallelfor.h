@@ -0,0 +1,10 @@
+#pragma once
+#include <functional>
+
+// Calls f(begin, end) over [0, count) in batches of at most batchSize.
+// Batches are taken by the calling thread and by QThreadPool threads
+// that are idle right now, so the call never queues behind long pool
+// tasks such as terrain generation. Returns once every batch has
+// finished. Batches run at the same time, so f must only write to
+// what its own range owns.
+void parallelFor(int count, int batchSize, const std::function<void(int, int)> &f);
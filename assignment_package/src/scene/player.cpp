@@ -4,6 +4,7 @@
 Player::Player(glm::vec3 pos, Terrain &terrain)
     : Entity(pos), m_velocity(0,0,0), m_acceleration(0,0,0),
       m_camera(pos + glm::vec3(0, 1.5, 0)),
+      m_cameraPosPrev(pos + glm::vec3(0, 1.5, 0)),
       m_cameraOrientation(glm::vec2(0, 0)),
       mcr_terrain(terrain),
       m_maxVelocity(glm::vec3(15)), m_minVelocity(glm::vec3(-15)),
@@ -28,10 +29,41 @@ Player::~Player()
 
 void Player::tick(float dT, InputBundle &input) {
     mcr_posPrev = mcr_position;
+    m_cameraPosPrev = m_camera.mcr_position;
+    if (input.flightToggled) {
+        changeFlightMode();
+    }
+    if (input.leftClicked) {
+        removeBlock();
+    }
+    if (input.rightClicked) {
+        placeBlock();
+    }
     processInputs(input);
     computePhysics(dT, mcr_terrain);
 }
 
+Camera Player::getInterpolatedCamera(float alpha) const {
+    Camera camera(m_camera);
+    camera.moveAlongVector((alpha - 1.f) * (m_camera.mcr_position - m_cameraPosPrev));
+    return camera;
+}
+
+void Player::setPose(glm::vec3 eye, glm::vec2 orientation) {
+    moveAlongVector(eye - m_camera.mcr_position);
+    // Level the camera so the turn is about the world's up axis, then tilt it again
+    orientation.y = glm::clamp(orientation.y, -89.9999f, 89.9999f);
+    rotateOnRightLocal(-m_cameraOrientation.y);
+    rotateOnUpGlobal(orientation.x - m_cameraOrientation.x);
+    rotateOnRightLocal(orientation.y);
+    m_cameraOrientation = orientation;
+    m_velocity = glm::vec3(0);
+    m_acceleration = glm::vec3(0);
+    // Nothing to interpolate from
+    mcr_posPrev = m_position;
+    m_cameraPosPrev = m_camera.mcr_position;
+}
+
 
 float clamp(float n, float lower, float upper) {
   return std::max(lower, std::min(n, upper));
@@ -90,15 +122,13 @@ void Player::processInputs(InputBundle &inputs) {
 
     m_acceleration = inputDirection * Acceleration;
 
-    if (mcr_terrain.hasChunkAt(m_position.x, m_position.z)) {
-        BlockType currentBlockType = mcr_terrain.getBlockAt(m_position);
-        if (currentBlockType == ICE) {
-            m_acceleration *= 1.2;
-        } else if (currentBlockType == WATER) {
-            m_acceleration *= 0.6;
-        } else if (currentBlockType == SNOW) {
-            m_acceleration *= 0.8;
-        }
+    BlockType currentBlockType = mcr_terrain.tryGetBlockAt(m_position);
+    if (currentBlockType == ICE) {
+        m_acceleration *= 1.2;
+    } else if (currentBlockType == WATER) {
+        m_acceleration *= 0.6;
+    } else if (currentBlockType == SNOW) {
+        m_acceleration *= 0.8;
     }
 
     for (int i = 0; i < 3; i++) {
@@ -171,40 +201,18 @@ void Player::moveAlongVector(glm::vec3 dir) {
     m_camera.moveAlongVector(dir);
 }
 
-void Player::moveAlongVectorWithCollisions(glm::vec3 dir) {
-    std::array<glm::vec3, 12> rayOrigins = {
-        m_position + glm::vec3(0.5, 0, 0.5),
-        m_position + glm::vec3(0.5, 0, -0.5),
-        m_position + glm::vec3(-0.5, 0, -0.5),
-        m_position + glm::vec3(-0.5, 0, 0.5),
-        m_position + glm::vec3(0.5, 1, 0.5),
-        m_position + glm::vec3(0.5, 1, -0.5),
-        m_position + glm::vec3(-0.5, 1, -0.5),
-        m_position + glm::vec3(-0.5, 1, 0.5),
-        m_position + glm::vec3(0.5, 2, 0.5),
-        m_position + glm::vec3(0.5, 2, -0.5),
-        m_position + glm::vec3(-0.5, 2, -0.5),
-        m_position + glm::vec3(-0.5, 2, 0.5)
-    };
+AABB Player::getBoundingBox() const {
+    return AABB(m_position + glm::vec3(-0.5f, 0.f, -0.5f), m_position + glm::vec3(0.5f, 2.f, 0.5f));
+}
 
-    for (glm::vec3 rayOrigin : rayOrigins) {
-        for (int axis = 0; axis < 3; axis++) {
-            glm::vec3 rayDirection = glm::vec3(0);
-            rayDirection[axis] = dir[axis];
-            float outdist;
-            glm::ivec3 out_blockHit, prevCell;
-            bool isBlocked = gridMarch(rayOrigin, rayDirection, mcr_terrain, &outdist, &out_blockHit, &prevCell);
-            if (isBlocked) {
-                if (outdist > 0.001f) {
-                    dir[axis] = glm::sign(dir[axis]) * (std::fmax(glm::min(glm::abs(dir[axis]), outdist) - 0.0001f, 0));
-                } else {
-                    dir[axis] = 0;
-                }
-                m_velocity[axis] = 0;
-            }
+void Player::moveAlongVectorWithCollisions(glm::vec3 dir) {
+    SweepResult sweep = sweepAABB(getBoundingBox(), dir, mcr_terrain);
+    for (int axis = 0; axis < 3; axis++) {
+        if (sweep.blocked[axis]) {
+            m_velocity[axis] = 0;
         }
     }
-    moveAlongVector(dir);
+    moveAlongVector(sweep.moved);
 }
 
 void Player::moveForwardLocal(float amount) {
@@ -281,82 +289,30 @@ void Player::changeFlightMode() {
     }
 }
 
+RayHit Player::pickBlock(float maxDistance) const {
+    return raycast(Ray(m_camera.mcr_position, m_forward, maxDistance), mcr_terrain);
+}
+
 void Player::removeBlock() {
-    float outdist;
-    glm::ivec3 out_blockHit, prevCell;
-    bool isBlocked = gridMarch(m_camera.mcr_position, 3.f * m_forward, mcr_terrain, &outdist, &out_blockHit, &prevCell);
-    if (isBlocked) {
-        mcr_terrain.setBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z, EMPTY);
-        const uPtr<Chunk> &c = mcr_terrain.getChunkAt(out_blockHit.x, out_blockHit.z);
-        c->destroyVBOdata();
+    RayHit hit = pickBlock(3.f);
+    if (hit.hit && mcr_terrain.trySetBlockAt(hit.block.x, hit.block.y, hit.block.z, EMPTY)) {
+        Chunk *c = mcr_terrain.findChunkAt(hit.block.x, hit.block.z);
         c->createVBOdata();
-        c->create(c->m_vboData.m_vboDataOpaque, c->m_vboData.m_idxDataOpaque,
-                  c->m_vboData.m_vboDataTransparent, c->m_vboData.m_idxDataTransparent);
+        c->create(c->m_vboData);
     }
 }
 
 void Player::placeBlock() {
-    float outdist;
-    glm::ivec3 out_blockHit, prevCell;
-    bool isBlocked = gridMarch(m_camera.mcr_position, 3.f * m_forward, mcr_terrain, &outdist, &out_blockHit, &prevCell);
-    if (isBlocked) {
-        mcr_terrain.setBlockAt(prevCell.x, prevCell.y, prevCell.z, STONE);
-        const uPtr<Chunk> &c = mcr_terrain.getChunkAt(prevCell.x, prevCell.z);
-        c->destroyVBOdata();
-        c->createVBOdata();
-        c->create(c->m_vboData.m_vboDataOpaque, c->m_vboData.m_idxDataOpaque,
-                  c->m_vboData.m_vboDataTransparent, c->m_vboData.m_idxDataTransparent);
+    RayHit hit = pickBlock(3.f);
+    // A zero normal means the camera is inside the block
+    if (!hit.hit || hit.normal == glm::ivec3(0)) {
+        return;
     }
-}
-
-// prevCell is the cell adjacent to the out_blockHit
-bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit, glm::ivec3 *prevCell) {
-    float maxLen = glm::length(rayDirection); // Farthest we search
-    glm::ivec3 currCell = glm::ivec3(glm::floor(rayOrigin));
-    *prevCell = currCell;
-    rayDirection = glm::normalize(rayDirection); // Now all t values represent world dist.
-
-    float curr_t = 0.f;
-    while(curr_t < maxLen) {
-        float min_t = glm::sqrt(3.f);
-        float interfaceAxis = -1; // Track axis for which t is smallest
-        for(int i = 0; i < 3; ++i) { // Iterate over the three axes
-            if(rayDirection[i] != 0) { // Is ray parallel to axis i?
-                float offset = glm::max(0.f, glm::sign(rayDirection[i])); // See slide 5
-                // If the player is *exactly* on an interface then
-                // they'll never move if they're looking in a negative direction
-                if(currCell[i] == rayOrigin[i] && offset == 0.f) {
-                    offset = -1.f;
-                }
-                int nextIntercept = currCell[i] + offset;
-                float axis_t = (nextIntercept - rayOrigin[i]) / rayDirection[i];
-                axis_t = glm::min(axis_t, maxLen); // Clamp to max len to avoid super out of bounds errors
-                if(axis_t < min_t) {
-                    min_t = axis_t;
-                    interfaceAxis = i;
-                }
-            }
-        }
-        if(interfaceAxis == -1) {
-            throw std::out_of_range("interfaceAxis was -1 after the for loop in gridMarch!");
-        }
-        curr_t += min_t; // min_t is declared in slide 7 algorithm
-        rayOrigin += rayDirection * min_t;
-        glm::ivec3 offset = glm::ivec3(0,0,0);
-        // Sets it to 0 if sign is +, -1 if sign is -
-        offset[interfaceAxis] = glm::min(0.f, glm::sign(rayDirection[interfaceAxis]));
-        *prevCell = currCell;
-        currCell = glm::ivec3(glm::floor(rayOrigin)) + offset;
-        // If currCell contains something other than EMPTY, return
-        // curr_t
-        BlockType cellType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z);
-        if(cellType != EMPTY && cellType != WATER && cellType != LAVA) {
-            *out_blockHit = currCell;
-            *out_dist = glm::min(maxLen, curr_t);
-            return true;
-        }
+    glm::ivec3 cell = hit.block + hit.normal;
+    if (mcr_terrain.trySetBlockAt(cell.x, cell.y, cell.z, STONE)) {
+        Chunk *c = mcr_terrain.findChunkAt(cell.x, cell.z);
+        c->createVBOdata();
+        c->create(c->m_vboData);
     }
-    *out_dist = glm::min(maxLen, curr_t);
-    return false;
 }
 
@@ -2,12 +2,16 @@
 #include "entity.h"
 #include "camera.h"
 #include "terrain.h"
+#include "collision.h"
+#include "raycast.h"
 #include <QSoundEffect>
 
 class Player : public Entity {
 private:
     glm::vec3 m_velocity, m_acceleration;
     Camera m_camera;
+    // Where the camera was before the last tick(), for interpolation
+    glm::vec3 m_cameraPosPrev;
     glm::vec2 m_cameraOrientation;
     Terrain &mcr_terrain;
     glm::vec3 m_maxVelocity, m_minVelocity;
@@ -39,11 +43,24 @@ public:
 
     void tick(float dT, InputBundle &input) override;
 
+    // A copy of the camera placed alpha of the way from its position
+    // before the last tick() to its current one. Rendering uses this so
+    // motion stays smooth when frames fall between simulation steps.
+    Camera getInterpolatedCamera(float alpha) const;
+    // Moves the Player so its camera is at eye, turned by orientation
+    // (degrees around the world's up axis, then up from the horizon) as
+    // the mouse would turn it, and stops it. Used to fly scripted paths.
+    void setPose(glm::vec3 eye, glm::vec2 orientation);
+
     // Player overrides all of Entity's movement
     // functions so that it transforms its camera
     // by the same amount as it transforms itself.
     void moveAlongVector(glm::vec3 dir) override;
+    // Moves the Player's bounding box as far along dir as the
+    // Terrain allows, stopping its velocity on blocked axes
     void moveAlongVectorWithCollisions(glm::vec3 dir);
+    // The 1 x 2 x 1 block box the Player collides with, feet at its bottom
+    AABB getBoundingBox() const;
     void moveForwardLocal(float amount) override;
     void moveRightLocal(float amount) override;
     void moveUpLocal(float amount) override;
@@ -65,8 +82,9 @@ public:
     QString lookAsQString() const;
 
     void changeFlightMode();
+    // The first solid block within maxDistance of the camera, along
+    // the direction it faces
+    RayHit pickBlock(float maxDistance) const;
     void removeBlock();
     void placeBlock();
 };
-
-bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit, glm::ivec3 *prevCell);
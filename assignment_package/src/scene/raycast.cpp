@@ -0,0 +1,197 @@
+#include "raycast.h"
+#include "collision.h"
+#include "terrain.h"
+#include <limits>
+
+RayHit::RayHit()
+    : hit(false), unloaded(false), distance(0.f), block(0), type(EMPTY), normal(0)
+{}
+
+namespace {
+const float NEVER = std::numeric_limits<float>::max();
+
+// Remembers the last Chunk looked up. A ray crosses every section of a
+// column before moving on, and rays cast together tend to share Chunks.
+class ChunkCache {
+private:
+    const Terrain &mr_terrain;
+    const Chunk *mp_chunk;
+    glm::ivec2 m_column;
+    bool m_valid;
+
+public:
+    ChunkCache(const Terrain &terrain)
+        : mr_terrain(terrain), mp_chunk(nullptr), m_column(0, 0), m_valid(false)
+    {}
+
+    // column is in Chunk units
+    const Chunk* get(glm::ivec2 column) {
+        if (!m_valid || column != m_column) {
+            mp_chunk = mr_terrain.findChunkAt(16 * column.x, 16 * column.y);
+            m_column = column;
+            m_valid = true;
+        }
+        return mp_chunk;
+    }
+};
+
+// Walks one ray through three nested grids: Chunk columns, the 16 block
+// tall sections of a column, and the blocks of a section. Each level only
+// descends into the cells the one above can't rule out. Every boundary
+// distance is measured from the ray's origin, so the levels agree on
+// where the ray crosses from one cell into the next.
+class RayWalker {
+private:
+    ChunkCache &mr_chunks;
+    glm::vec3 m_origin, m_dir, m_invDir;
+    glm::ivec3 m_step;
+    float m_maxDistance;
+    RayHit m_result;
+
+    glm::vec3 at(float t) const {
+        return m_origin + m_dir * t;
+    }
+
+    // Distance along the ray to where it leaves cell of a grid with the
+    // given cell size on one axis
+    float exitDistance(int axis, int cell, int size) const {
+        if (m_step[axis] == 0) {
+            return NEVER;
+        }
+        int boundary = (m_step[axis] > 0 ? cell + 1 : cell) * size;
+        return (boundary - m_origin[axis]) * m_invDir[axis];
+    }
+
+    // Whether the ray is outside the world's height at t and moving away
+    bool leftWorld(float t) const {
+        float y = at(t).y;
+        return (y >= 256.f && m_step.y >= 0) || (y < 0.f && m_step.y <= 0);
+    }
+
+    bool castSection(const Chunk &c, glm::ivec3 section, float tStart, float tEnd, int enterAxis) {
+        glm::ivec3 base = 16 * section;
+        // Clamped, since the ray's entry point can round into a neighbor
+        glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(at(tStart))), base, base + 15);
+        float t = tStart;
+        int axis = enterAxis;
+        while (true) {
+            BlockType type = c.getBlockAt(cell.x - base.x, cell.y, cell.z - base.z);
+            if (blocksMovement(type)) {
+                m_result.hit = true;
+                m_result.distance = t;
+                m_result.block = cell;
+                m_result.type = type;
+                m_result.normal = glm::ivec3(0);
+                if (axis >= 0) {
+                    m_result.normal[axis] = -m_step[axis];
+                }
+                return true;
+            }
+            glm::vec3 exits(exitDistance(0, cell.x, 1), exitDistance(1, cell.y, 1), exitDistance(2, cell.z, 1));
+            axis = exits.x < exits.y ? (exits.x < exits.z ? 0 : 2) : (exits.y < exits.z ? 1 : 2);
+            if (exits[axis] > tEnd) {
+                return false;
+            }
+            cell[axis] += m_step[axis];
+            if (cell[axis] < base[axis] || cell[axis] > base[axis] + 15) {
+                return false;
+            }
+            t = glm::max(t, exits[axis]);
+        }
+    }
+
+    bool castColumn(const Chunk &c, glm::ivec2 column, float tStart, float tEnd, int enterAxis) {
+        // Skip the whole Chunk if the ray passes above its highest block
+        float yStart = at(tStart).y, yEnd = at(tEnd).y;
+        int lowest = int(glm::floor(glm::min(yStart, yEnd)));
+        int highest = int(glm::floor(glm::max(yStart, yEnd)));
+        if (highest < 0 || lowest >= 16 * c.getTopSection()) {
+            return false;
+        }
+        int section = int(glm::floor(yStart / 16.f));
+        float t = tStart;
+        int axis = enterAxis;
+        while (true) {
+            float exitY = exitDistance(1, section, 16);
+            if (section >= 0 && section < CHUNK_SECTIONS && c.getSectionBlockCount(section) > 0 &&
+                castSection(c, glm::ivec3(column.x, section, column.y), t, glm::min(exitY, tEnd), axis)) {
+                return true;
+            }
+            if (exitY >= tEnd) {
+                return false;
+            }
+            section += m_step.y;
+            if ((section < 0 && m_step.y < 0) || (section >= CHUNK_SECTIONS && m_step.y > 0)) {
+                return false;
+            }
+            axis = 1;
+            t = glm::max(t, exitY);
+        }
+    }
+
+public:
+    RayWalker(const Ray &ray, ChunkCache &chunks)
+        : mr_chunks(chunks), m_origin(ray.origin), m_dir(glm::normalize(ray.direction)),
+          m_invDir(1.f / m_dir), m_step(glm::sign(m_dir)), m_maxDistance(ray.maxDistance), m_result()
+    {}
+
+    RayHit run() {
+        glm::ivec2 column(glm::floor(glm::vec2(m_origin.x, m_origin.z) / 16.f));
+        float t = 0.f;
+        int enterAxis = -1;
+        while (!leftWorld(t)) {
+            float exitX = exitDistance(0, column.x, 16);
+            float exitZ = exitDistance(2, column.y, 16);
+            float tEnd = glm::min(glm::min(exitX, exitZ), m_maxDistance);
+            const Chunk *c = mr_chunks.get(column);
+            if (c == nullptr) {
+                m_result.unloaded = true;
+                m_result.distance = t;
+                return m_result;
+            }
+            if (castColumn(*c, column, t, tEnd, enterAxis)) {
+                return m_result;
+            }
+            if (tEnd >= m_maxDistance) {
+                break;
+            }
+            if (exitX < exitZ) {
+                column.x += m_step.x;
+                enterAxis = 0;
+            } else {
+                column.y += m_step.z;
+                enterAxis = 2;
+            }
+            t = glm::max(t, tEnd);
+        }
+        m_result.distance = m_maxDistance;
+        return m_result;
+    }
+};
+}
+
+RayHit raycast(const Ray &ray, const Terrain &terrain) {
+    if (ray.direction == glm::vec3(0.f)) {
+        return RayHit();
+    }
+    ChunkCache chunks(terrain);
+    return RayWalker(ray, chunks).run();
+}
+
+void raycastBatch(const std::vector<Ray> &rays, const Terrain &terrain, std::vector<RayHit> *out) {
+    ChunkCache chunks(terrain);
+    out->clear();
+    out->reserve(rays.size());
+    for (const Ray &ray : rays) {
+        out->push_back(ray.direction == glm::vec3(0.f) ? RayHit() : RayWalker(ray, chunks).run());
+    }
+}
+
+bool lineOfSight(glm::vec3 from, glm::vec3 to, const Terrain &terrain) {
+    float distance = glm::distance(from, to);
+    if (distance == 0.f) {
+        return true;
+    }
+    RayHit hit = raycast(Ray(from, to - from, distance), terrain);
+    return !hit.hit && !hit.unloaded;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "glm_includes.h"
+#include "chunkhelpers.h"
+#include <vector>
+
+class Terrain;
+
+// A ray from origin along direction, which doesn't need to be
+// normalized, for up to maxDistance blocks
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float maxDistance;
+
+    Ray(glm::vec3 origin, glm::vec3 direction, float maxDistance)
+        : origin(origin), direction(direction), maxDistance(maxDistance) {}
+};
+
+// Where a ray stopped
+struct RayHit {
+    bool hit;
+    // The ray reached a Chunk that isn't loaded before hitting anything
+    bool unloaded;
+    // Distance along the ray to the hit block or the unloaded Chunk,
+    // maxDistance if the ray stopped at neither
+    float distance;
+    glm::ivec3 block;
+    BlockType type;
+    // Normal of the face the ray entered block through, so block + normal
+    // is the cell in front of it. Zero if the ray started inside block.
+    glm::ivec3 normal;
+
+    RayHit();
+};
+
+// Finds the first block along the ray that blocksMovement. The ray steps
+// over whole Chunks whose blocks all lie below its path and over empty
+// 16 x 16 x 16 sections, and only walks block by block through sections
+// that hold something, so long rays over open terrain stay cheap.
+// Stops at the first Chunk that isn't loaded.
+RayHit raycast(const Ray &ray, const Terrain &terrain);
+
+// Casts every ray in rays into out, in the same order. Chunk lookups are
+// shared between the rays, which helps when they start near each other.
+void raycastBatch(const std::vector<Ray> &rays, const Terrain &terrain, std::vector<RayHit> *out);
+
+// Whether nothing that blocksMovement lies between the two points. Only
+// true if every Chunk along the way is loaded.
+bool lineOfSight(glm::vec3 from, glm::vec3 to, const Terrain &terrain);
@@ -0,0 +1,46 @@
+#include "spatialhash.h"
+
+SpatialHash::SpatialHash(float cellSize)
+    : m_cellSize(cellSize), m_bucketStart(), m_entries(), m_pointBuckets(), m_bucketMask(0)
+{}
+
+glm::ivec3 SpatialHash::cellOf(glm::vec3 p) const {
+    return glm::ivec3(glm::floor(p / m_cellSize));
+}
+
+int SpatialHash::bucketOf(glm::ivec3 cell) const {
+    unsigned int h = static_cast<unsigned int>(cell.x) * 73856093u ^
+                     static_cast<unsigned int>(cell.y) * 19349663u ^
+                     static_cast<unsigned int>(cell.z) * 83492791u;
+    return static_cast<int>(h & static_cast<unsigned int>(m_bucketMask));
+}
+
+void SpatialHash::build(const std::vector<glm::vec3> &points) {
+    // About two buckets per point keeps collisions rare
+    int buckets = 64;
+    while (buckets < 2 * static_cast<int>(points.size())) {
+        buckets *= 2;
+    }
+    m_bucketMask = buckets - 1;
+    m_bucketStart.assign(buckets + 1, 0);
+    m_pointBuckets.resize(points.size());
+    m_entries.resize(points.size());
+
+    // Counting sort of the point indices by bucket
+    for (size_t i = 0; i < points.size(); i++) {
+        m_pointBuckets[i] = bucketOf(cellOf(points[i]));
+        m_bucketStart[m_pointBuckets[i] + 1]++;
+    }
+    for (int b = 0; b < buckets; b++) {
+        m_bucketStart[b + 1] += m_bucketStart[b];
+    }
+    for (size_t i = 0; i < points.size(); i++) {
+        int b = m_pointBuckets[i];
+        // m_bucketStart[b] is used as the insertion point and restored below
+        m_entries[m_bucketStart[b]++] = static_cast<int>(i);
+    }
+    for (int b = buckets; b > 0; b--) {
+        m_bucketStart[b] = m_bucketStart[b - 1];
+    }
+    m_bucketStart[0] = 0;
+}
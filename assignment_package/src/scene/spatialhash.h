@@ -0,0 +1,65 @@
+#pragma once
+#include "glm_includes.h"
+#include <vector>
+
+// Buckets points by the cubic cell of side cellSize they fall in, for
+// finding the points near a position without testing all of them.
+// Cells are hashed into about two buckets per point, so the grid covers
+// all of space; cells sharing a bucket only cost a comparison per point.
+// build() sorts the point indices by bucket in linear time, so the whole
+// structure is two flat arrays and is rebuilt from scratch when the
+// points move.
+class SpatialHash {
+private:
+    float m_cellSize;
+    // Points of bucket b are m_entries[m_bucketStart[b], m_bucketStart[b + 1])
+    std::vector<int> m_bucketStart;
+    std::vector<int> m_entries;
+    // Bucket of each point, kept between builds to avoid reallocating
+    std::vector<int> m_pointBuckets;
+    int m_bucketMask;
+
+    glm::ivec3 cellOf(glm::vec3 p) const;
+    int bucketOf(glm::ivec3 cell) const;
+
+public:
+    SpatialHash(float cellSize);
+
+    // Replaces the contents with points, whose indices are
+    // what forEachNear reports
+    void build(const std::vector<glm::vec3> &points);
+
+    // Calls f(index) for every point of the last build() within radius
+    // of p, each exactly once. points must be the vector that was built.
+    template <typename F>
+    void forEachNear(const std::vector<glm::vec3> &points, glm::vec3 p, float radius, F f) const;
+};
+
+template <typename F>
+void SpatialHash::forEachNear(const std::vector<glm::vec3> &points, glm::vec3 p, float radius, F f) const {
+    if (m_entries.empty()) {
+        return;
+    }
+    glm::ivec3 lo = cellOf(p - radius), hi = cellOf(p + radius);
+    float radius2 = radius * radius;
+    glm::ivec3 cell;
+    for (cell.x = lo.x; cell.x <= hi.x; cell.x++) {
+        for (cell.y = lo.y; cell.y <= hi.y; cell.y++) {
+            for (cell.z = lo.z; cell.z <= hi.z; cell.z++) {
+                int bucket = bucketOf(cell);
+                for (int e = m_bucketStart[bucket]; e < m_bucketStart[bucket + 1]; e++) {
+                    int index = m_entries[e];
+                    // Points of other cells sharing the bucket are skipped,
+                    // so a bucket read for two cells reports nothing twice
+                    if (cellOf(points[index]) != cell) {
+                        continue;
+                    }
+                    glm::vec3 d = points[index] - p;
+                    if (glm::dot(d, d) <= radius2) {
+                        f(index);
+                    }
+                }
+            }
+        }
+    }
+}
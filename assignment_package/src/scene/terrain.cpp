@@ -2,14 +2,29 @@
 #include "cube.h"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <tuple>
 #include "noise_functions.h"
 #include "chunkworkers.h"
+#include "chunkstore.h"
+#include "frustum.h"
+#include "parallelfor.h"
+#include "heightmapimport.h"
 
 Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(), m_generatedTerrain(), mp_context(context), m_chunkCreated(0), m_tryExpansionTimer(0.f)
+    : m_arena(context), m_chunks(), m_generatedTerrain(), mp_context(context), m_zoneStages(), m_zonesInProgress(),
+      m_zonesPendingStages(), m_currentZone(0, 0), m_rangeDistance(DEFAULT_RENDER_DISTANCE), m_expanded(false),
+      m_renderDistance(DEFAULT_RENDER_DISTANCE), m_renderOffsets(), m_generateOffsets(), m_zoneJobs(),
+      m_modifiedZones(), m_pendingUploads(), m_tryExpansionTimer(0.f),
+      m_biomeBlend(), m_seed(0), m_store(nullptr), mp_import(nullptr), m_importedZones(), m_chunksVisible(0), m_chunksInRange(0),
+      m_sectionsVisible(0), m_sectionsInRange(0), m_opaqueDraws(), m_transparentDraws()
 {}
 
-Terrain::~Terrain() {}
+Terrain::~Terrain() {
+    if (mp_import != nullptr) {
+        mp_import->cancel();
+    }
+}
 
 // Combine two 32-bit ints into one 64-bit int
 // where the upper 32 bits are X and the lower 32 bits are Z
@@ -43,79 +58,164 @@ glm::ivec2 toCoords(int64_t k) {
     return glm::ivec2(x, z);
 }
 
+// Rounds a world-space x or z down to the corner of its Chunk. Unlike
+// 16 * floor(v / 16.f) this stays exact for coordinates of any size.
+static int chunkCorner(int v) {
+    return v & ~15;
+}
+
+namespace {
+// Zones this many zones past the generated ones are unloaded, so
+// walking back and forth over a zone edge doesn't reload any
+const int EVICT_MARGIN = 2;
+// Mesh uploads per frame are enough to upload every Chunk within the
+// render distance in about UPLOAD_FRAMES frames, and at least
+// MIN_UPLOADS_PER_FRAME
+const int UPLOAD_FRAMES = 60;
+const int MIN_UPLOADS_PER_FRAME = 8;
+
+int zoneCorner(int v) {
+    return v & ~63;
+}
+
+// Zones count as within distance Chunks of the Player's zone if their
+// center is, with half a zone of slack: at 8 Chunks those are the zones
+// up to (2, 1) zones away, but not (2, 2)
+bool zoneOffsetInRange(glm::ivec2 offset, int distance) {
+    int64_t reach = 16 * distance + 32;
+    return 4096 * (int64_t(offset.x) * offset.x + int64_t(offset.y) * offset.y) <= reach * reach;
+}
+
+// The offsets of the zones within distance, nearest first, and of those
+// and every zone next to one of them
+void rangeOffsets(int distance, std::vector<glm::ivec2> *render, std::vector<glm::ivec2> *generate) {
+    render->clear();
+    generate->clear();
+    int r = distance / 4 + 2;
+    for (int x = -r; x <= r; x++) {
+        for (int z = -r; z <= r; z++) {
+            glm::ivec2 offset(x, z);
+            bool nearRange = false;
+            for (int dx = -1; dx <= 1; dx++) {
+                for (int dz = -1; dz <= 1; dz++) {
+                    nearRange |= zoneOffsetInRange(offset + glm::ivec2(dx, dz), distance);
+                }
+            }
+            if (zoneOffsetInRange(offset, distance)) {
+                render->push_back(offset);
+            }
+            if (nearRange) {
+                generate->push_back(offset);
+            }
+        }
+    }
+    auto nearer = [](glm::ivec2 a, glm::ivec2 b) {
+        return a.x * a.x + a.y * a.y < b.x * b.x + b.y * b.y;
+    };
+    std::stable_sort(render->begin(), render->end(), nearer);
+    std::stable_sort(generate->begin(), generate->end(), nearer);
+}
+}
+
+static std::out_of_range noChunkError(int x, int y, int z) {
+    return std::out_of_range("Coordinates " + std::to_string(x) +
+                             " " + std::to_string(y) + " " +
+                             std::to_string(z) + " have no Chunk!");
+}
+
 // Surround calls to this with try-catch if you don't know whether
-// the coordinates at x, y, z have a corresponding Chunk
+// the coordinates at x, y, z have a corresponding Chunk. Code that
+// runs every frame should use tryGetBlockAt instead.
 BlockType Terrain::getBlockAt(int x, int y, int z) const
 {
-    if(hasChunkAt(x, z)) {
-        // Just disallow action below or above min/max height,
-        // but don't crash the game over it.
-        if(y < 0 || y >= 256) {
-            return EMPTY;
-        }
-        const uPtr<Chunk> &c = getChunkAt(x, z);
-        glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
-        return c->getBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
-                             static_cast<unsigned int>(y),
-                             static_cast<unsigned int>(z - chunkOrigin.y));
-    }
-    else {
-        throw std::out_of_range("Coordinates " + std::to_string(x) +
-                                " " + std::to_string(y) + " " +
-                                std::to_string(z) + " have no Chunk!");
+    BlockType t = tryGetBlockAt(x, y, z);
+    if (t == UNLOADED) {
+        throw noChunkError(x, y, z);
     }
+    return t;
 }
 
 BlockType Terrain::getBlockAt(glm::vec3 p) const {
-    return getBlockAt(p.x, p.y, p.z);
+    BlockType t = tryGetBlockAt(p);
+    if (t == UNLOADED) {
+        glm::ivec3 cell(glm::floor(p));
+        throw noChunkError(cell.x, cell.y, cell.z);
+    }
+    return t;
+}
+
+const Chunk* Terrain::findChunkAt(int x, int z) const noexcept {
+    auto it = m_chunks.find(toKey(chunkCorner(x), chunkCorner(z)));
+    return it == m_chunks.end() ? nullptr : it->second.get();
+}
+
+Chunk* Terrain::findChunkAt(int x, int z) noexcept {
+    auto it = m_chunks.find(toKey(chunkCorner(x), chunkCorner(z)));
+    return it == m_chunks.end() ? nullptr : it->second.get();
+}
+
+BlockType Terrain::tryGetBlockAt(int x, int y, int z) const noexcept {
+    const Chunk *c = findChunkAt(x, z);
+    if (c == nullptr) {
+        return UNLOADED;
+    }
+    // Just disallow action below or above min/max height,
+    // but don't crash the game over it.
+    if (y < 0 || y >= 256) {
+        return EMPTY;
+    }
+    return c->getBlockAt(x - chunkCorner(x), y, z - chunkCorner(z));
+}
+
+BlockType Terrain::tryGetBlockAt(glm::vec3 p) const noexcept {
+    // Floor rather than truncate, so -0.5 lands in cell -1
+    glm::ivec3 cell(glm::floor(p));
+    return tryGetBlockAt(cell.x, cell.y, cell.z);
 }
 
 bool Terrain::hasChunkAt(int x, int z) const {
-    // Map x and z to their nearest Chunk corner
-    // By flooring x and z, then multiplying by 16,
-    // we clamp (x, z) to its nearest Chunk-space corner,
-    // then scale back to a world-space location.
-    // Note that floor() lets us handle negative numbers
-    // correctly, as floor(-1 / 16.f) gives us -1, as
-    // opposed to (int)(-1 / 16.f) giving us 0 (incorrect!).
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks.find(toKey(16 * xFloor, 16 * zFloor)) != m_chunks.end();
+    return findChunkAt(x, z) != nullptr;
 }
 
 
 uPtr<Chunk>& Terrain::getChunkAt(int x, int z) {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks[toKey(16 * xFloor, 16 * zFloor)];
+    return m_chunks[toKey(chunkCorner(x), chunkCorner(z))];
 }
 
 
 const uPtr<Chunk>& Terrain::getChunkAt(int x, int z) const {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks.at(toKey(16 * xFloor, 16 * zFloor));
+    return m_chunks.at(toKey(chunkCorner(x), chunkCorner(z)));
 }
 
 void Terrain::setBlockAt(int x, int y, int z, BlockType t)
 {
-    if(hasChunkAt(x, z)) {
-        uPtr<Chunk> &c = getChunkAt(x, z);
-        glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
-        c->setBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
-                      static_cast<unsigned int>(y),
-                      static_cast<unsigned int>(z - chunkOrigin.y),
-                      t);
+    Chunk *c = findChunkAt(x, z);
+    if (c == nullptr) {
+        throw noChunkError(x, y, z);
     }
-    else {
-        throw std::out_of_range("Coordinates " + std::to_string(x) +
-                                " " + std::to_string(y) + " " +
-                                std::to_string(z) + " have no Chunk!");
+    m_modifiedZones.insert(toKey(zoneCorner(x), zoneCorner(z)));
+    // Chunk::setBlockAt rejects y outside the world itself
+    c->setBlockAt(static_cast<unsigned int>(x - chunkCorner(x)),
+                  static_cast<unsigned int>(y),
+                  static_cast<unsigned int>(z - chunkCorner(z)),
+                  t);
+}
+
+bool Terrain::trySetBlockAt(int x, int y, int z, BlockType t) noexcept {
+    Chunk *c = findChunkAt(x, z);
+    if (c == nullptr || y < 0 || y >= 256) {
+        return false;
     }
+    m_modifiedZones.insert(toKey(zoneCorner(x), zoneCorner(z)));
+    c->setBlockAt(static_cast<unsigned int>(x - chunkCorner(x)),
+                  static_cast<unsigned int>(y),
+                  static_cast<unsigned int>(z - chunkCorner(z)),
+                  t);
+    return true;
 }
 
 Chunk* Terrain::instantiateChunkAt(int x, int z) {
-    uPtr<Chunk> chunk = mkU<Chunk>(mp_context, x, z);
+    uPtr<Chunk> chunk = mkU<Chunk>(mp_context, x, z, m_seed, &m_arena);
     Chunk *cPtr = chunk.get();
     m_chunks[toKey(x, z)] = move(chunk);
     // Set the neighbor pointers of itself and its neighbors
@@ -141,23 +241,235 @@ Chunk* Terrain::instantiateChunkAt(int x, int z) {
 // TODO: When you make Chunk inherit from Drawable, change this code so
 // it draws each Chunk with the given ShaderProgram, remembering to set the
 // model matrix to the proper X and Z translation!
-void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram) {
-    for (int x = minX; x < maxX; x += 16) {
-        for (int z = minZ; z < maxZ; z += 16) {
-            // Insert a new Chunk into its map and set up its VBOs for rendering
-            const uPtr<Chunk> &chunk = getChunkAt(x, z);
-            shaderProgram->setModelMatrix(glm::translate(glm::mat4(), glm::vec3(x, 0, z)));
-            shaderProgram->drawInterleaved(*chunk, true);
+// Breadth-first search over sections from the camera's section. A section
+// is entered through one face and left through another only if the two are
+// connected through non-opaque blocks, and the search never turns back
+// against a direction it has already moved in. Sections it doesn't reach
+// are hidden behind opaque blocks (or outside the frustum).
+void Terrain::findVisibleSections(const std::vector<Chunk*> &chunks, glm::ivec2 origin, glm::ivec2 size,
+                                  const Frustum &frustum, glm::vec3 eye, std::vector<bool> &visible) const {
+    static const glm::ivec3 offsets[6] = {
+        glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0), glm::ivec3(0, 1, 0),
+        glm::ivec3(0, -1, 0), glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+    };
+    struct Step {
+        glm::ivec3 section;  // Chunk offset from origin in x and z, section in y
+        int enteredFrom;     // Face we came in through, -1 at the camera
+        unsigned char moved; // Directions moved in so far
+    };
+    auto index = [&](glm::ivec3 s) {
+        return (s.x * size.y + s.z) * CHUNK_SECTIONS + s.y;
+    };
+    auto inFrustum = [&](glm::ivec3 s) {
+        glm::vec3 min(origin.x + 16 * s.x, 16 * s.y, origin.y + 16 * s.z);
+        return frustum.intersectsAABB(min, min + glm::vec3(16.f));
+    };
+
+    std::vector<Step> queue;
+    glm::ivec3 start(glm::floor((eye.x - origin.x) / 16.f), glm::floor(eye.y / 16.f),
+                     glm::floor((eye.z - origin.y) / 16.f));
+    if (start.x < 0 || start.x >= size.x || start.z < 0 || start.z >= size.y ||
+            chunks[start.x * size.y + start.z] == nullptr) {
+        // No connectivity data around the camera: fall back to the frustum
+        for (int x = 0; x < size.x; x++) {
+            for (int z = 0; z < size.y; z++) {
+                for (int y = 0; y < CHUNK_SECTIONS && chunks[x * size.y + z] != nullptr; y++) {
+                    visible[index(glm::ivec3(x, y, z))] = inFrustum(glm::ivec3(x, y, z));
+                }
+            }
+        }
+        return;
+    } else if (start.y >= CHUNK_SECTIONS || start.y < 0) {
+        // Above or below the world: start from every top or bottom section
+        bool above = start.y >= CHUNK_SECTIONS;
+        int y = above ? CHUNK_SECTIONS - 1 : 0;
+        for (int x = 0; x < size.x; x++) {
+            for (int z = 0; z < size.y; z++) {
+                glm::ivec3 s(x, y, z);
+                if (chunks[x * size.y + z] != nullptr && inFrustum(s)) {
+                    visible[index(s)] = true;
+                    queue.push_back({s, above ? YPOS : YNEG, static_cast<unsigned char>(1 << (above ? YNEG : YPOS))});
+                }
+            }
+        }
+    } else {
+        visible[index(start)] = true;
+        queue.push_back({start, -1, 0});
+    }
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        Step step = queue[head];
+        const Chunk *c = chunks[step.section.x * size.y + step.section.z];
+        unsigned short connectivity = c->getSectionConnectivity(step.section.y);
+        for (int d = 0; d < 6; d++) {
+            // Never move against a direction already moved in
+            if (step.moved & (1 << (d ^ 1))) {
+                continue;
+            }
+            if (step.enteredFrom >= 0 &&
+                    !facesConnected(connectivity, Direction(step.enteredFrom), Direction(d))) {
+                continue;
+            }
+            glm::ivec3 next = step.section + offsets[d];
+            if (next.x < 0 || next.x >= size.x || next.z < 0 || next.z >= size.y ||
+                    next.y < 0 || next.y >= CHUNK_SECTIONS ||
+                    chunks[next.x * size.y + next.z] == nullptr || visible[index(next)] || !inFrustum(next)) {
+                continue;
+            }
+            visible[index(next)] = true;
+            // Opposite directions differ only in their lowest bit
+            queue.push_back({next, d ^ 1, static_cast<unsigned char>(step.moved | (1 << d))});
+        }
+    }
+}
+
+void Terrain::draw(ShaderProgram *shaderProgram, const Frustum &frustum, glm::vec3 eye) {
+    // Only zones in range are meshed, so the box around them holds every
+    // Chunk to draw
+    int reach = 0;
+    for (glm::ivec2 offset : m_renderOffsets) {
+        reach = std::max({reach, std::abs(offset.x), std::abs(offset.y)});
+    }
+    int minX = m_currentZone.x - 64 * reach, minZ = m_currentZone.y - 64 * reach;
+    // Meshed Chunks in range, by offset from (minX, minZ) in Chunks
+    glm::ivec2 origin(minX, minZ);
+    glm::ivec2 size(8 * reach + 4);
+    std::vector<Chunk*> chunks(size.x * size.y, nullptr);
+    m_chunksInRange = 0;
+    for (int x = 0; x < size.x; x++) {
+        for (int z = 0; z < size.y; z++) {
+            // Chunks still going through generation have no VBOs yet
+            if (!hasChunkAt(minX + 16 * x, minZ + 16 * z)) {
+                continue;
+            }
+            Chunk *chunk = getChunkAt(minX + 16 * x, minZ + 16 * z).get();
+            if (chunk->elemCount() >= 0) {
+                chunks[x * size.y + z] = chunk;
+                m_chunksInRange++;
+            }
         }
     }
-    for (int x = minX; x < maxX; x += 16) {
-        for (int z = minZ; z < maxZ; z += 16) {
-            // Insert a new Chunk into its map and set up its VBOs for rendering
-            const uPtr<Chunk> &chunk = getChunkAt(x, z);
-            shaderProgram->setModelMatrix(glm::translate(glm::mat4(), glm::vec3(x, 0, z)));
-            shaderProgram->drawInterleaved(*chunk, false);
+    std::vector<bool> visible(chunks.size() * CHUNK_SECTIONS, false);
+    findVisibleSections(chunks, origin, size, frustum, eye, visible);
+
+    // Collect the visible sections of each Chunk, merging adjacent ones
+    // into one index range, and draw all of them in one call per pass
+    m_opaqueDraws.clear();
+    m_transparentDraws.clear();
+    // Transparent sections are drawn back to front, after sorting
+    std::vector<std::tuple<float, const ArenaAllocation*, glm::ivec2>> transparentSections;
+    m_chunksVisible = 0;
+    m_sectionsVisible = 0;
+    m_sectionsInRange = m_chunksInRange * CHUNK_SECTIONS;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (chunks[i] == nullptr) {
+            continue;
+        }
+        size_t drawsBefore = m_opaqueDraws.size() + transparentSections.size();
+        for (int y = 0; y < CHUNK_SECTIONS; y++) {
+            if (!visible[i * CHUNK_SECTIONS + y]) {
+                continue;
+            }
+            m_sectionsVisible++;
+            for (bool isOpaque : {true, false}) {
+                glm::ivec2 r = chunks[i]->getSectionIndexRange(y, isOpaque);
+                if (r.x == r.y) {
+                    continue;
+                }
+                if (isOpaque) {
+                    m_opaqueDraws.add(chunks[i]->getAllocation(true), r);
+                } else {
+                    glm::ivec2 pos = chunks[i]->getPos();
+                    glm::vec3 d = glm::vec3(pos.x + 8, 16 * y + 8, pos.y + 8) - eye;
+                    transparentSections.emplace_back(glm::dot(d, d), &chunks[i]->getAllocation(false), r);
+                }
+            }
+        }
+        if (m_opaqueDraws.size() + transparentSections.size() > drawsBefore) {
+            m_chunksVisible++;
         }
     }
+    std::sort(transparentSections.begin(), transparentSections.end(),
+              [](const auto &a, const auto &b) { return std::get<0>(a) > std::get<0>(b); });
+    for (const auto &section : transparentSections) {
+        m_transparentDraws.add(*std::get<1>(section), std::get<2>(section));
+    }
+    // Vertex positions are already in world space
+    shaderProgram->setModelMatrix(glm::mat4());
+    shaderProgram->drawMultiInterleaved(m_arena, m_opaqueDraws.m_counts, m_opaqueDraws.m_offsets, m_opaqueDraws.m_baseVertices);
+}
+
+void Terrain::drawTransparent(ShaderProgram *shaderProgram) {
+    shaderProgram->setModelMatrix(glm::mat4());
+    shaderProgram->drawMultiInterleaved(m_arena, m_transparentDraws.m_counts, m_transparentDraws.m_offsets, m_transparentDraws.m_baseVertices);
+}
+
+void Terrain::MultiDraw::clear() {
+    m_counts.clear();
+    m_offsets.clear();
+    m_baseVertices.clear();
+    m_lastEnd = -1;
+}
+
+void Terrain::MultiDraw::add(const ArenaAllocation &a, glm::ivec2 range) {
+    int first = a.firstIndex + range.x;
+    // Extend the previous draw if this range continues it
+    if (first == m_lastEnd && m_baseVertices.back() == a.firstVertex) {
+        m_counts.back() += range.y - range.x;
+    } else {
+        m_counts.push_back(range.y - range.x);
+        m_offsets.push_back(reinterpret_cast<const void*>(static_cast<size_t>(first) * sizeof(GLuint)));
+        m_baseVertices.push_back(a.firstVertex);
+    }
+    m_lastEnd = a.firstIndex + range.y;
+}
+
+size_t Terrain::MultiDraw::size() const {
+    return m_counts.size();
+}
+
+void Terrain::sortTransparentFaces(glm::vec3 eye) {
+    m_transparentSortsLock.lock();
+    for (const TransparentSortData &sort : m_transparentSorts) {
+        sort.mp_chunk->finishTransparentSort(sort);
+        addZoneJobs(sort.mp_chunk->getPos(), false, -1);
+    }
+    m_transparentSorts.clear();
+    m_transparentSortsLock.unlock();
+
+    for (auto &kv : m_chunks) {
+        Chunk *chunk = kv.second.get();
+        if (chunk->needsTransparentSort(eye)) {
+            addZoneJobs(chunk->getPos(), false, 1);
+            QThreadPool::globalInstance()->start(new TransparentSortWorker(chunk->beginTransparentSort(eye),
+                                                                           &m_transparentSorts,
+                                                                           &m_transparentSortsLock));
+        }
+    }
+}
+
+void Terrain::createArena() {
+    m_arena.createVBOdata();
+}
+
+const ChunkArena& Terrain::getArena() const {
+    return m_arena;
+}
+
+int Terrain::getChunksVisible() const {
+    return m_chunksVisible;
+}
+
+int Terrain::getChunksInRange() const {
+    return m_chunksInRange;
+}
+
+int Terrain::getSectionsVisible() const {
+    return m_sectionsVisible;
+}
+
+int Terrain::getSectionsInRange() const {
+    return m_sectionsInRange;
 }
 
 // unused in ms2
@@ -188,13 +500,22 @@ void Terrain::CreateTestScene()
     // Create the Chunks that will
     // store the blocks for our
     // initial world space
+    std::vector<Chunk*> chunks;
     for(int x = 0; x < 64; x += 16) {
         for(int z = 0; z < 64; z += 16) {
-            Chunk* c = instantiateChunkAt(x, z);
-            c->fillChunk();
-            c->createVBOdata();
+            chunks.push_back(instantiateChunkAt(x, z));
         }
     }
+    // Every Chunk must finish a stage before any Chunk starts the next,
+    // as DECORATION reads and writes its neighbors
+    for (int stage = HEIGHTFIELD; stage <= FLUIDS; stage++) {
+        for (Chunk* c : chunks) {
+            c->runGenerationStage(static_cast<GenerationStage>(stage), m_biomeBlend);
+        }
+    }
+    for (Chunk* c : chunks) {
+        c->createVBOdata();
+    }
     // Tell our existing terrain set that
     // the "generated terrain zone" at (0,0)
     // now exists.
@@ -202,11 +523,21 @@ void Terrain::CreateTestScene()
 }
 
 void Terrain::spawnVBOWorker(Chunk* chunkNeedingVBOData) {
+    addZoneJobs(chunkNeedingVBOData->getPos(), true, 1);
     VBOWorker* worker = new VBOWorker(chunkNeedingVBOData, &m_chunksThatHaveVBOs, &m_chunksThatHaveVBOsLock);
     QThreadPool::globalInstance()->start(worker);
 }
 
-void Terrain::spawnFBMWorker(int64_t zone) {
+void Terrain::spawnZoneVBOWorkers(int64_t zone) {
+    ivec2 coord = toCoords(zone);
+    for (int x = coord.x; x < coord.x + 64; x += 16) {
+        for (int z = coord.y; z < coord.y + 64; z += 16) {
+            spawnVBOWorker(getChunkAt(x, z).get());
+        }
+    }
+}
+
+void Terrain::spawnFBMWorker(int64_t zone, GenerationStage firstStage, GenerationStage lastStage) {
     // For every terrain generation zone in this radius that does not yet exist in
     // Terrain's m_generatedTerrain, you will spawn a thread to fill that zone's
     // Chunks with procedural height field BlockType data.
@@ -215,216 +546,482 @@ void Terrain::spawnFBMWorker(int64_t zone) {
     std::vector<Chunk*> chunksToFill;
     for(int x = coord.x; x < coord.x + 64; x += 16) {
         for(int z = coord.y; z < coord.y + 64; z += 16) {
-            Chunk* c = instantiateChunkAt(x, z);
-            chunksToFill.push_back(c);
+            if (firstStage == HEIGHTFIELD) {
+                chunksToFill.push_back(instantiateChunkAt(x, z));
+            } else {
+                chunksToFill.push_back(getChunkAt(x, z).get());
+            }
         }
     }
-    FBMWorker* worker = new FBMWorker(coord.x, coord.y, chunksToFill, &m_chunksThatHaveBlockData, &m_chunksThatHaveBlockDataLock);
+    FBMWorker* worker = new FBMWorker(zone, chunksToFill, firstStage, lastStage, m_biomeBlend,
+                                      &m_zonesThatFinishedStages, &m_zonesThatFinishedStagesLock, m_store.get());
+    m_zonesInProgress.insert(zone);
     QThreadPool::globalInstance()->start(worker);
     m_generatedTerrain.insert(zone);
 }
 
-void Terrain::spawnVBOWorkers(const std::unordered_set<Chunk*> &chunksNeedingVBOs) {
-    for (Chunk* c: chunksNeedingVBOs) {
-        spawnVBOWorker(c);
+GenerationStage Terrain::zoneStage(int64_t zone) const {
+    auto it = m_zoneStages.find(zone);
+    return it == m_zoneStages.end() ? UNGENERATED : it->second;
+}
+
+bool Terrain::zoneDecorating(int64_t zone) const {
+    return m_zonesInProgress.count(zone) && zoneStage(zone) == SURFACE;
+}
+
+// A zone's structures may reach into its +X, +Z and +X+Z neighbors,
+// so those must have their surface and no workers reading them, and no
+// zone whose structures could write into the same Chunks may be
+// decorating at the same time
+bool Terrain::canDecorateZone(int64_t zone) const {
+    ivec2 coord = toCoords(zone);
+    for (int dx = 0; dx <= 64; dx += 64) {
+        for (int dz = 0; dz <= 64; dz += 64) {
+            int64_t target = toKey(coord.x + dx, coord.y + dz);
+            if (zoneStage(target) < SURFACE || m_zoneJobs.count(target)) {
+                return false;
+            }
+        }
     }
+    for (int dx = -64; dx <= 64; dx += 64) {
+        for (int dz = -64; dz <= 64; dz += 64) {
+            if ((dx != 0 || dz != 0) && zoneDecorating(toKey(coord.x + dx, coord.y + dz))) {
+                return false;
+            }
+        }
+    }
+    return true;
 }
 
-void Terrain::spawnFBMWorkers(const QSet<int64_t> &zonesToGenerate) {
-    // Spawn worker threads to generate more Chunks
-    for (int64_t zone : zonesToGenerate) {
-        spawnFBMWorker(zone);
+// Fluids only fill EMPTY blocks, so every structure that could reach
+// into this zone (its own and those of its -X, -Z and -X-Z neighbors)
+// must already be placed
+bool Terrain::canFillZoneFluids(int64_t zone) const {
+    ivec2 coord = toCoords(zone);
+    for (int dx = -64; dx <= 0; dx += 64) {
+        for (int dz = -64; dz <= 0; dz += 64) {
+            if (zoneStage(toKey(coord.x + dx, coord.y + dz)) < DECORATION) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Starts the next stage on every zone whose dependencies are satisfied.
+// A zone's neighbors finishing a stage can unblock it, so zones stay
+// pending until they reach FLUIDS.
+void Terrain::advanceGenerationStages() {
+    std::vector<int64_t> finished;
+    for (int64_t zone : m_zonesPendingStages) {
+        if (m_zonesInProgress.count(zone)) {
+            continue;
+        }
+        GenerationStage stage = zoneStage(zone);
+        if (stage == SURFACE && canDecorateZone(zone)) {
+            spawnFBMWorker(zone, DECORATION, DECORATION);
+        } else if (stage == DECORATION && canFillZoneFluids(zone)) {
+            spawnFBMWorker(zone, FLUIDS, FLUIDS);
+        } else if (stage == FLUIDS) {
+            finished.push_back(zone);
+        }
+    }
+    for (int64_t zone : finished) {
+        m_zonesPendingStages.erase(zone);
     }
 }
 
 void Terrain::checkThreadResults() {
-    // Send Chunks that have been processed by FBMWorkers
-    // to VBOWorkers for VBO data
-    m_chunksThatHaveBlockDataLock.lock();
-    spawnVBOWorkers(m_chunksThatHaveBlockData);
-    m_chunksThatHaveBlockData.clear();
-    m_chunksThatHaveBlockDataLock.unlock();
-
-    // Collect the Chunks that have been given VBO data
-    // by VBOWorkers and send that VBO data to the GPU
+    // Record the stages FBMWorkers have finished. Zones that are done
+    // generating and within the render distance are sent to VBOWorkers.
+    m_zonesThatFinishedStagesLock.lock();
+    for (auto &zs : m_zonesThatFinishedStages) {
+        m_zoneStages[zs.first] = zs.second;
+        m_zonesInProgress.erase(zs.first);
+        if (zs.second == FLUIDS && zoneInRenderRange(zs.first)) {
+            spawnZoneVBOWorkers(zs.first);
+        }
+    }
+    m_zonesThatFinishedStages.clear();
+    m_zonesThatFinishedStagesLock.unlock();
+    advanceGenerationStages();
+}
+
+void Terrain::uploadChunkVBOs() {
+    // Collect the Chunks that have been given VBO data by VBOWorkers
     m_chunksThatHaveVBOsLock.lock();
     for (ChunkVBOData &cd : m_chunksThatHaveVBOs) {
-        cd.mp_chunk->create(cd.m_vboDataOpaque, cd.m_idxDataOpaque,
-                            cd.m_vboDataTransparent, cd.m_idxDataTransparent);
-    }
-    if (m_chunkCreated < 25 * 4 * 4) {
-        m_chunkCreated += m_chunksThatHaveVBOs.size();
+        m_pendingUploads.push_back(std::move(cd));
     }
     m_chunksThatHaveVBOs.clear();
     m_chunksThatHaveVBOsLock.unlock();
+
+    // and send some of that VBO data to the GPU, so a burst of finished
+    // zones is spread over several frames
+    int budget = std::max(MIN_UPLOADS_PER_FRAME, static_cast<int>(16 * m_renderOffsets.size()) / UPLOAD_FRAMES);
+    while (!m_pendingUploads.empty() && budget > 0) {
+        ChunkVBOData &cd = m_pendingUploads.front();
+        glm::ivec2 pos = cd.mp_chunk->getPos();
+        // The Chunk may have left the render distance since
+        if (zoneInRenderRange(toKey(zoneCorner(pos.x), zoneCorner(pos.y)))) {
+            cd.mp_chunk->create(cd);
+            budget--;
+        }
+        addZoneJobs(pos, true, -1);
+        m_pendingUploads.pop_front();
+    }
 }
 
-QSet<int64_t> Terrain::terrainZonesBorderingZone(glm::ivec2 zone, unsigned int radius, bool onlyCircumference) const {
-    int radiusInZoneScale = static_cast<int>(radius) * 64;
-    QSet<int64_t> result;
-    // Only want to look at terrain zones exactly at our radius
-    if (onlyCircumference) {
-        for (int i = - radiusInZoneScale; i < radiusInZoneScale; i += 64) {
-            // Nx1 to the right
-            result.insert(toKey(zone.x + radiusInZoneScale, zone.y + i));
-            // Nx1 to the left
-            result.insert(toKey(zone.x - radiusInZoneScale, zone.y + i));
-            // Nx1 above
-            result.insert(toKey(zone.x + i, zone.y + radiusInZoneScale));
-            // Nx1 below
-            result.insert(toKey(zone.x + i, zone.y - radiusInZoneScale));
+void Terrain::addZoneJobs(glm::ivec2 pos, bool meshing, int n) {
+    std::array<int64_t, 5> zones;
+    int count = 0;
+    auto add = [&](int x, int z) {
+        int64_t zone = toKey(zoneCorner(x), zoneCorner(z));
+        if (std::find(zones.begin(), zones.begin() + count, zone) == zones.begin() + count) {
+            zones[count++] = zone;
         }
-    } else {
-        for (int i = -radiusInZoneScale; i <= radiusInZoneScale; i += 64) {
-            for (int j = -radiusInZoneScale; j <= radiusInZoneScale; j += 64) {
-                result.insert(toKey(zone.x + i, zone.y + j));
-            }
+    };
+    add(pos.x, pos.y);
+    // Meshing reads the blocks along the neighbors' edges
+    if (meshing) {
+        add(pos.x - 16, pos.y);
+        add(pos.x + 16, pos.y);
+        add(pos.x, pos.y - 16);
+        add(pos.x, pos.y + 16);
+    }
+    for (int i = 0; i < count; i++) {
+        if ((m_zoneJobs[zones[i]] += n) == 0) {
+            m_zoneJobs.erase(zones[i]);
         }
     }
-    return result;
 }
 
 bool Terrain::terrainZoneExists(int64_t id) const {
     return m_generatedTerrain.count(id);
 }
 
-void Terrain::tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev) {
-    // Find the player's position relative
-    // to their current terrain gen zone
-    ivec2 currZone(64.f * glm::floor(playerPos.x / 64.f), 64.f * glm::floor(playerPos.z / 64.f));
-    ivec2 prevZone(64.f * glm::floor(playerPosPrev.x / 64.f), 64.f * glm::floor(playerPosPrev.z / 64.f));
-    // Determine which terrain zones border our currect position and our previoius position
-    // This *will* include un-generated terrain zones, so we can compare them to our gl...
-    // and know to generate them
-    QSet<int64_t> terrainZonesBorderingCurrPos = terrainZonesBorderingZone(currZone, TERRAIN_CREATE_RADIUS, false);
-    QSet<int64_t> terrainZonesBorderingPrevPos = terrainZonesBorderingZone(prevZone, TERRAIN_CREATE_RADIUS, false);
-    // Check which terrain zones need to be destroy()ed
-    // by determining which terrain zones were previously in our radius and are not not
-    for (auto id : terrainZonesBorderingPrevPos) {
-        if (!terrainZonesBorderingCurrPos.contains(id)) {
-            ivec2 coord = toCoords(id);
-            for (int x = coord.x; x < coord.x + 64; x += 16) {
-                for (int z = coord.y; z < coord.y + 64; z += 16) {
-                    auto& chunk = getChunkAt(x, z);
+bool Terrain::zoneInRenderRange(int64_t zone) const {
+    return m_expanded && zoneOffsetInRange((toCoords(zone) - m_currentZone) / 64, m_rangeDistance);
+}
+
+void Terrain::tryExpansion(glm::vec3 playerPos) {
+    // Find the player's current terrain gen zone. The zones in range
+    // only change when it or the render distance does.
+    ivec2 currZone(zoneCorner(static_cast<int>(glm::floor(playerPos.x))),
+                   zoneCorner(static_cast<int>(glm::floor(playerPos.z))));
+    if (m_expanded && currZone == m_currentZone && m_rangeDistance == m_renderDistance) {
+        return;
+    }
+    ivec2 prevZone = m_currentZone;
+    int prevDistance = m_rangeDistance;
+    bool wasExpanded = m_expanded;
+    std::vector<ivec2> prevOffsets = m_renderOffsets;
+    if (!m_expanded || m_rangeDistance != m_renderDistance) {
+        rangeOffsets(m_renderDistance, &m_renderOffsets, &m_generateOffsets);
+    }
+    m_currentZone = currZone;
+    m_rangeDistance = m_renderDistance;
+    m_expanded = true;
+
+    // Zones that were in range and are not anymore lose their meshes
+    for (ivec2 offset : prevOffsets) {
+        int64_t id = toKey(prevZone.x + 64 * offset.x, prevZone.y + 64 * offset.y);
+        if (zoneInRenderRange(id) || !terrainZoneExists(id)) {
+            continue;
+        }
+        ivec2 coord = toCoords(id);
+        for (int x = coord.x; x < coord.x + 64; x += 16) {
+            for (int z = coord.y; z < coord.y + 64; z += 16) {
+                if (Chunk *chunk = findChunkAt(x, z)) {
                     chunk->destroyVBOdata();
                 }
             }
         }
     }
-    // Determine if any terrain zones around our current position need VBO data
-    // Send these to VBOWorkers
-    // DO NOT send zones to workers if they do not exist in our global map
-    // Instead, send these to FBMWorkers.
-    for (auto id : terrainZonesBorderingCurrPos) {
-        // If it exists already AND IS NOT IN PREV SET, send it to a VBOWorker
-        // If it's in the prev set, then it's already been sent to a VBOWorker
-        // at some point, and may even already have VBOs
-        if (terrainZoneExists(id)) {
-            // For every terrain generation zone in this radius that does exist in m_generatedTerrain
-            // check each Chunk it contains and see if it already has VBO data
-            if (!terrainZonesBorderingPrevPos.contains(id)) {
-                // If it does not, then you will spawn another thread
-                // we will designate a VBOWorker to compute the interleaved buffer and index buffer data for that Chunk.
-                ivec2 coord = toCoords(id);
-                for (int x = coord.x; x < coord.x + 64; x += 16) {
-                    for (int z = coord.y; z < coord.y + 64; z += 16) {
-                        auto & chunk = getChunkAt(x, z);
-                        spawnVBOWorker(chunk.get());
-                    }
+    // Zones in range that have finished generating and were not in it
+    // before need their VBO data computed by VBOWorkers.
+    // Zones that are still generating are sent to VBOWorkers by
+    // checkThreadResults once they reach FLUIDS.
+    for (ivec2 offset : m_renderOffsets) {
+        ivec2 coord = currZone + 64 * offset;
+        bool wasInRange = wasExpanded && zoneOffsetInRange((coord - prevZone) / 64, prevDistance);
+        if (!wasInRange && zoneStage(toKey(coord.x, coord.y)) == FLUIDS) {
+            spawnZoneVBOWorkers(toKey(coord.x, coord.y));
+        }
+    }
+    // Zones next to the ones in range are generated through SURFACE too:
+    // structures and fluids in a zone depend on the neighboring zones, so
+    // the zones in range can only finish generating with that margin.
+    // Nearer zones are queued first. This also adds them to the set of
+    // generated terrain zones so we don't try to repeatedly generate them.
+    for (ivec2 offset : m_generateOffsets) {
+        int64_t id = toKey(currZone.x + 64 * offset.x, currZone.y + 64 * offset.y);
+        if (!terrainZoneExists(id)) {
+            spawnFBMWorker(id, HEIGHTFIELD, SURFACE);
+            m_zonesPendingStages.insert(id);
+        }
+    }
+}
+
+bool Terrain::canEvictZone(int64_t zone, int evictDistance) const {
+    ivec2 coord = toCoords(zone);
+    if (zoneOffsetInRange((coord - m_currentZone) / 64, evictDistance) || m_zoneJobs.count(zone)) {
+        return false;
+    }
+    // Decorating a zone writes into its neighbors, and meshing a
+    // neighbor's Chunks reads this zone's edges
+    for (int dx = -64; dx <= 64; dx += 64) {
+        for (int dz = -64; dz <= 64; dz += 64) {
+            int64_t neighbor = toKey(coord.x + dx, coord.y + dz);
+            if (m_zonesInProgress.count(neighbor) || m_zoneJobs.count(neighbor)) {
+                return false;
+            }
+        }
+    }
+    // The -X, -Z and -X-Z neighbors' structures reach into this zone, and
+    // would be missing if it were generated again while they stay loaded.
+    // This zone's reach into its +X, +Z and +X+Z neighbors, and would be
+    // placed in them a second time if it were loaded from the ChunkStore
+    // while they stay loaded. No structure crosses the other diagonals.
+    for (int dx = -64; dx <= 64; dx += 64) {
+        for (int dz = -64; dz <= 64; dz += 64) {
+            ivec2 neighbor(coord.x + dx, coord.y + dz);
+            if (dx != -dz && terrainZoneExists(toKey(neighbor.x, neighbor.y)) &&
+                zoneOffsetInRange((neighbor - m_currentZone) / 64, evictDistance)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Terrain::evictZones() {
+    if (!m_expanded) {
+        return;
+    }
+    // In Chunks, past the zones generated for the render distance
+    int evictDistance = m_rangeDistance + 4 * (1 + EVICT_MARGIN);
+    std::vector<int64_t> evicted;
+    for (int64_t zone : m_generatedTerrain) {
+        if (canEvictZone(zone, evictDistance)) {
+            evicted.push_back(zone);
+        }
+    }
+    for (int64_t zone : evicted) {
+        ivec2 coord = toCoords(zone);
+        std::vector<Chunk*> chunks;
+        for (int x = coord.x; x < coord.x + 64; x += 16) {
+            for (int z = coord.y; z < coord.y + 64; z += 16) {
+                if (Chunk *c = findChunkAt(x, z)) {
+                    chunks.push_back(c);
                 }
             }
-        } else {
-            // If it does not yet exist, send it to an FBMWorker
-            // This also adds it to the set of generated terrain zones
-            // so we don't try to repeatedly generate it
-            spawnFBMWorker(id);
         }
+        // The Player's changes are saved to be loaded again later. Without
+        // a world directory the zone has to stay loaded to keep them.
+        if (m_modifiedZones.count(zone)) {
+            if (m_store == nullptr || zoneStage(zone) != FLUIDS ||
+                !m_store->saveZone(zone, std::vector<const Chunk*>(chunks.begin(), chunks.end()))) {
+                continue;
+            }
+            m_modifiedZones.erase(zone);
+        }
+        for (Chunk *c : chunks) {
+            glm::ivec2 pos = c->getPos();
+            c->destroyVBOdata();
+            c->unlinkNeighbors();
+            m_chunks.erase(toKey(pos.x, pos.y));
+        }
+        m_generatedTerrain.erase(zone);
+        m_zoneStages.erase(zone);
+        m_zonesPendingStages.erase(zone);
     }
 }
 
-void Terrain::multithreadedWork(glm::vec3 playerPos, glm::vec3 playerPosPrev, float dT) {
+void Terrain::multithreadedWork(glm::vec3 playerPos, float dT) {
+    applyImportedZones();
+    uploadChunkVBOs();
     m_tryExpansionTimer += dT;
     // Only check for terrain expansion every 0.5 second of real time or so
     if (m_tryExpansionTimer < 0.5f) {
         return;
     }
-    tryExpansion(playerPos, playerPosPrev);
+    tryExpansion(playerPos);
     checkThreadResults();
+    evictZones();
     m_tryExpansionTimer = 0.f;
 }
 
 bool Terrain::initialTerrainDoneLoading() {
-    return m_chunkCreated >= 25 * 4 * 4;
-}
-
-void Terrain::updategrayscaleHeights(int playerX, int playerZ, std::vector<std::vector<float>> newHeights) {
-    int w = newHeights.size();
-    int h = newHeights[0].size();
-    int minX = playerX - w / 2.f;
-    int minZ = playerZ - h / 2.f;
-    for (int x = 0; x < w; x++) {
-        for (int z = 0; z < h; z++) {
-            int xx = minX + x;
-            int zz = minZ + z;
-            if (!hasChunkAt(xx, zz)) {
-                createChunkAt(xx, zz);
-            }
-            float height = newHeights[x][z];
-            for (int y = 0; y < 256; y++) {
-                if (y < height) {
-                    if (y == ceil(height) - 1) {
-                        setBlockAt(xx, y, zz, GRASS);
-                    } else if (y >= 128) {
-                        setBlockAt(xx, y, zz, DIRT);
-                    } else {
-                        setBlockAt(xx, y, zz, STONE);
-                    }
-                } else {
-                    setBlockAt(xx, y, zz, EMPTY);
+    if (!m_expanded) {
+        return false;
+    }
+    // Only the zones around the player's: at long render distances the
+    // rest can take a while
+    for (ivec2 offset : m_renderOffsets) {
+        if (std::abs(offset.x) > 1 || std::abs(offset.y) > 1) {
+            continue;
+        }
+        ivec2 coord = m_currentZone + 64 * offset;
+        for (int x = coord.x; x < coord.x + 64; x += 16) {
+            for (int z = coord.y; z < coord.y + 64; z += 16) {
+                Chunk *c = findChunkAt(x, z);
+                if (c == nullptr || c->elemCount() < 0) {
+                    return false;
                 }
             }
         }
     }
-    for (int i = 0; i <= w / 16; i++) {
-        for (int j = 0; j <= h / 16; j++) {
-            const uPtr<Chunk> &c = getChunkAt(minX + i * 16, minZ + j * 16);
-            c->destroyVBOdata();
-            c->createVBOdata();
-            c->create(c->m_vboData.m_vboDataOpaque, c->m_vboData.m_idxDataOpaque,
-                      c->m_vboData.m_vboDataTransparent, c->m_vboData.m_idxDataTransparent);
+    return true;
+}
+
+void Terrain::setRenderDistance(int distance) {
+    m_renderDistance = glm::clamp(distance, MIN_RENDER_DISTANCE, MAX_RENDER_DISTANCE);
+}
+
+int Terrain::getRenderDistance() const {
+    return m_renderDistance;
+}
+
+int Terrain::getZonesLoaded() const {
+    return static_cast<int>(m_generatedTerrain.size());
+}
+
+void Terrain::setBiomeBlend(const BiomeBlend &blend) {
+    m_biomeBlend = blend;
+}
+
+const BiomeBlend& Terrain::getBiomeBlend() const {
+    return m_biomeBlend;
+}
+
+void Terrain::setSeed(unsigned int seed) {
+    m_seed = seed;
+}
+
+unsigned int Terrain::getSeed() const {
+    return m_seed;
+}
+
+void Terrain::setWorldDirectory(const QString &directory) {
+    m_store = mkU<ChunkStore>(directory, m_seed);
+}
+
+bool Terrain::hasWorldDirectory() const {
+    return m_store != nullptr;
+}
+
+void Terrain::importColumns(int minX, int minZ, int w, int h, const std::vector<ImportedColumn> &columns) {
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+    // Chunks are instantiated here since that links them to their neighbors
+    std::vector<Chunk*> chunks;
+    for (int x = chunkCorner(minX); x < minX + w; x += 16) {
+        for (int z = chunkCorner(minZ); z < minZ + h; z += 16) {
+            createChunkAt(x, z);
+            chunks.push_back(findChunkAt(x, z));
         }
     }
+    // One task per Chunk, each only writing its own blocks
+    parallelFor(static_cast<int>(chunks.size()), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            Chunk *c = chunks[i];
+            glm::ivec2 corner = c->getPos();
+            int xEnd = std::min(minX + w, corner.x + 16), zEnd = std::min(minZ + h, corner.y + 16);
+            for (int x = std::max(minX, corner.x); x < xEnd; x++) {
+                for (int z = std::max(minZ, corner.y); z < zEnd; z++) {
+                    const ImportedColumn &col = columns[(x - minX) * h + (z - minZ)];
+                    int height = glm::clamp(col.height, 0, 256);
+                    int lx = x - corner.x, lz = z - corner.y;
+                    c->fillColumn(lx, lz, 0, std::min(height - 1, 128), col.lower);
+                    c->fillColumn(lx, lz, 128, height - 1, col.upper);
+                    c->fillColumn(lx, lz, height - 1, height, col.top);
+                    c->fillColumn(lx, lz, height, 256, EMPTY);
+                }
+            }
+        }
+    });
+    remeshArea(minX, minZ, w, h);
 }
 
-void Terrain::updateColorHeights(int playerX, int playerZ, std::vector<std::vector<std::pair<float, BlockType>>> newBlocks) {
-    int w = newBlocks.size();
-    int h = newBlocks[0].size();
-    int minX = playerX - w / 2.f;
-    int minZ = playerZ - h / 2.f;
-    for (int x = 0; x < w; x++) {
-        for (int z = 0; z < h; z++) {
-            int xx = minX + x;
-            int zz = minZ + z;
-            if (!hasChunkAt(xx, zz)) {
-                createChunkAt(xx, zz);
+void Terrain::remeshArea(int minX, int minZ, int w, int h) {
+    // The neighbors' faces along the area's edge may have changed too.
+    // Those still being generated get their mesh once they're done.
+    for (int x = chunkCorner(minX) - 16; x < minX + w + 16; x += 16) {
+        for (int z = chunkCorner(minZ) - 16; z < minZ + h + 16; z += 16) {
+            Chunk *c = findChunkAt(x, z);
+            bool inside = x >= chunkCorner(minX) && x < minX + w && z >= chunkCorner(minZ) && z < minZ + h;
+            int64_t zone = toKey(x & ~63, z & ~63);
+            if (c != nullptr && (inside || (zoneStage(zone) == FLUIDS && !m_zonesInProgress.count(zone)))) {
+                spawnVBOWorker(c);
             }
-            float height = newBlocks[x][z].first;
-            for (int y = 0; y < 256; y++) {
-                if (y < height) {
-                    setBlockAt(xx, y, zz, newBlocks[x][z].second);
-                } else {
-                    setBlockAt(xx, y, zz, EMPTY);
+        }
+    }
+}
+
+bool Terrain::importHeightMap(const QString &path, glm::ivec2 center, QString *error) {
+    if (m_store == nullptr || !m_store->ensureDirectory()) {
+        *error = "There is no world directory to import into.";
+        return false;
+    }
+    sPtr<HeightMapFile> file = mkS<HeightMapFile>();
+    if (!file->open(path, error)) {
+        return false;
+    }
+    if (mp_import != nullptr) {
+        mp_import->cancel();
+    }
+    m_importedZones.clear();
+    mp_import = mkS<HeightMapImport>(file, *m_store, m_seed, m_biomeBlend, center);
+    // Half of the pool is left to keep streaming terrain in
+    QThreadPool *pool = QThreadPool::globalInstance();
+    for (int i = 0; i < std::max(1, pool->maxThreadCount() / 2); i++) {
+        pool->start(new HeightMapImportWorker(mp_import));
+    }
+    std::cout << "Importing " << path.toStdString() << " (" << file->width() << " x " << file->height()
+              << ") as " << mp_import->zoneCount() << " zones" << std::endl;
+    return true;
+}
+
+void Terrain::applyImportedZones() {
+    if (mp_import == nullptr) {
+        return;
+    }
+    mp_import->takeFinishedZones(&m_importedZones);
+    // Each zone is a few milliseconds of work
+    const int zonesPerFrame = 4;
+    int applied = 0;
+    for (size_t i = 0; i < m_importedZones.size() && applied < zonesPerFrame;) {
+        int64_t zone = m_importedZones[i];
+        if (terrainZoneExists(zone) && (zoneStage(zone) != FLUIDS || m_zonesInProgress.count(zone))) {
+            // Overwritten once it has finished generating
+            i++;
+            continue;
+        }
+        // Zones that aren't loaded are streamed in from m_store as usual
+        if (terrainZoneExists(zone)) {
+            glm::ivec2 corner = toCoords(zone);
+            glm::ivec2 lo = glm::max(corner, mp_import->getOrigin());
+            glm::ivec2 hi = glm::min(corner + 64, mp_import->getOrigin() + mp_import->getSize());
+            std::vector<ImportedColumn> columns;
+            columns.reserve((hi.x - lo.x) * (hi.y - lo.y));
+            for (int x = lo.x; x < hi.x; x++) {
+                for (int z = lo.y; z < hi.y; z++) {
+                    columns.push_back(mp_import->column(x, z));
                 }
             }
+            importColumns(lo.x, lo.y, hi.x - lo.x, hi.y - lo.y, columns);
+            applied++;
         }
+        m_importedZones.erase(m_importedZones.begin() + i);
     }
-    for (int i = 0; i <= w / 16; i++) {
-        for (int j = 0; j <= h / 16; j++) {
-            const uPtr<Chunk> &c = getChunkAt(minX + i * 16, minZ + j * 16);
-            c->destroyVBOdata();
-            c->createVBOdata();
-            c->create(c->m_vboData.m_vboDataOpaque, c->m_vboData.m_idxDataOpaque,
-                      c->m_vboData.m_vboDataTransparent, c->m_vboData.m_idxDataTransparent);
+    if (m_importedZones.empty() && mp_import->zonesWritten() == mp_import->zoneCount()) {
+        if (mp_import->failed()) {
+            std::cerr << "Some imported zones couldn't be written to " << m_store->getDirectory().toStdString() << std::endl;
+        } else {
+            std::cout << "Imported " << mp_import->zoneCount() << " zones" << std::endl;
         }
+        mp_import = nullptr;
     }
 }
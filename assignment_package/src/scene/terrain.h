@@ -3,21 +3,33 @@
 #include "glm_includes.h"
 #include "chunk.h"
 #include <array>
+#include <deque>
 #include <unordered_map>
 #include <unordered_set>
 #include "shaderprogram.h"
 #include "cube.h"
 #include <QMutex>
 #include <QThreadPool>
+#include <QString>
 
-//using namespace std;
+class ChunkStore;
+class Frustum;
+class HeightMapImport;
 
-#define TERRAIN_CREATE_RADIUS 2
+//using namespace std;
 
 // Helper functions to convert (x, z) to and from hash map key
 int64_t toKey(int x, int z);
 glm::ivec2 toCoords(int64_t k);
 
+// One column of an imported height map: blocks [0, height) are filled,
+// the highest with top, the others from y = 128 up with upper and the
+// rest with lower. The blocks above are emptied.
+struct ImportedColumn {
+    int height;
+    BlockType top, upper, lower;
+};
+
 // The container class for all of the Chunks in the game.
 // Ultimately, while Terrain will always store all Chunks,
 // not all Chunks will be drawn at any given time as the world
@@ -29,6 +41,9 @@ private:
     // We combine the X and Z coordinates of the Chunk's corner into one 64-bit int
     // so that we can use them as a key for the map, as objects like std::pairs or
     // glm::ivec2s are not hashable by default, so they cannot be used as keys.
+    // Every Chunk's meshes are sub-allocated from this, so it is declared
+    // before m_chunks to outlive them
+    ChunkArena m_arena;
     std::unordered_map<int64_t, uPtr<Chunk>> m_chunks;
 
     // We will designate every 64 x 64 area of the world's x-z plane
@@ -56,24 +71,112 @@ private:
 
     OpenGLContext* mp_context;
 
-    // Passed to each worker thread so it can pass Chunks that need
-    // VBO data to the main thread
-    std::unordered_set<Chunk*> m_chunksThatHaveBlockData;
-    QMutex m_chunksThatHaveBlockDataLock;
+    // The last GenerationStage every Chunk of a terrain zone has completed.
+    // Zones are generated through SURFACE on their own; DECORATION and
+    // FLUIDS wait on their neighbors, see advanceGenerationStages.
+    std::unordered_map<int64_t, GenerationStage> m_zoneStages;
+    // Zones that currently have an FBMWorker running over them
+    std::unordered_set<int64_t> m_zonesInProgress;
+    // Zones that may be able to run their next stage
+    std::unordered_set<int64_t> m_zonesPendingStages;
+    // The zone the player was in at the last expansion check, and the
+    // render distance the loaded zones were chosen with then
+    glm::ivec2 m_currentZone;
+    int m_rangeDistance;
+    // Whether any zones have been loaded around m_currentZone yet
+    bool m_expanded;
+    // How far from the Player zones should be meshed and drawn, in Chunks.
+    // Takes effect at the next expansion check.
+    int m_renderDistance;
+    // Offsets, in zones, from m_currentZone of the zones within
+    // m_rangeDistance, nearest first, and of those one zone further
+    // which they need to finish generating
+    std::vector<glm::ivec2> m_renderOffsets, m_generateOffsets;
+    // Workers that hold pointers to a zone's Chunks, by zone. A zone
+    // can only be unloaded once it has none.
+    std::unordered_map<int64_t, int> m_zoneJobs;
+    // Zones the Player changed blocks in since they were loaded, which
+    // have to be saved before they can be unloaded
+    std::unordered_set<int64_t> m_modifiedZones;
+
+    // Passed to each worker thread so it can report the stages
+    // it finished back to the main thread
+    std::vector<std::pair<int64_t, GenerationStage>> m_zonesThatFinishedStages;
+    QMutex m_zonesThatFinishedStagesLock;
     std::vector<ChunkVBOData> m_chunksThatHaveVBOs;
     QMutex m_chunksThatHaveVBOsLock;
-    int m_chunkCreated;
+    // Meshes taken from m_chunksThatHaveVBOs, uploaded a few per frame
+    std::deque<ChunkVBOData> m_pendingUploads;
+    // Transparent face orderings finished by TransparentSortWorkers
+    std::vector<TransparentSortData> m_transparentSorts;
+    QMutex m_transparentSortsLock;
 
     float m_tryExpansionTimer;
 
+    // Thresholds used to blend biome height functions in newly generated Chunks
+    BiomeBlend m_biomeBlend;
+    // World seed handed to every Chunk this Terrain instantiates
+    unsigned int m_seed;
+    // Pregenerated zones are loaded from here instead of being generated
+    uPtr<ChunkStore> m_store;
+    // Writes a height map into m_store, if one is being imported
+    sPtr<HeightMapImport> mp_import;
+    // Zones mp_import has written that may be loaded, and
+    // need to be overwritten too
+    std::vector<int64_t> m_importedZones;
+    // Meshed Chunks and their sections considered and drawn
+    // by the last call to draw
+    int m_chunksVisible, m_chunksInRange;
+    int m_sectionsVisible, m_sectionsInRange;
+
+    // The arguments of one glMultiDrawElementsBaseVertex call,
+    // kept between frames to reuse their storage
+    struct MultiDraw {
+        std::vector<GLsizei> m_counts;
+        std::vector<const void*> m_offsets;
+        std::vector<GLint> m_baseVertices;
+        int m_lastEnd = -1;
+
+        void clear();
+        // Adds the index range [x, y) of a mesh in the arena
+        void add(const ArenaAllocation &a, glm::ivec2 range);
+        size_t size() const;
+    };
+    MultiDraw m_opaqueDraws, m_transparentDraws;
+
     void spawnVBOWorker(Chunk* c); // todo
-    void spawnVBOWorkers(const std::unordered_set<Chunk*> &chunksNeedingVBOs);
-    void spawnFBMWorkers(const QSet<int64_t> &zonesToGenerate);
-    void spawnFBMWorker(int64_t zone);
+    void spawnZoneVBOWorkers(int64_t zone);
+    void spawnFBMWorker(int64_t zone, GenerationStage firstStage, GenerationStage lastStage);
+    GenerationStage zoneStage(int64_t zone) const;
+    bool zoneDecorating(int64_t zone) const;
+    bool canDecorateZone(int64_t zone) const;
+    bool canFillZoneFluids(int64_t zone) const;
+    void advanceGenerationStages();
     void checkThreadResults();
-    void tryExpansion(glm::vec3 playerPos, glm::vec3 playerPosPrev);
-    QSet<int64_t> terrainZonesBorderingZone(glm::ivec2 zone, unsigned int radius, bool onlyCircumference) const;
+    // Uploads the meshes VBOWorkers have finished, up to a budget
+    // that grows with the render distance
+    void uploadChunkVBOs();
+    // Loads and meshes the zones within the render distance of the
+    // player's zone, and unmeshes those that have left it, when the
+    // player has moved to another zone or the distance has changed
+    void tryExpansion(glm::vec3 playerPos);
     bool terrainZoneExists(int64_t) const;
+    // Whether the zone is within the render distance of m_currentZone
+    bool zoneInRenderRange(int64_t zone) const;
+    // Adds n to the job counts of the zones a worker on the Chunk at pos
+    // holds pointers into: its own, and its neighbors' if it meshes it
+    void addZoneJobs(glm::ivec2 pos, bool meshing, int n);
+    // Unloads the zones far enough outside the render distance
+    // that nothing near the player depends on them
+    void evictZones();
+    bool canEvictZone(int64_t zone, int evictDistance) const;
+    // Remeshes the Chunks in the area and the fully generated Chunks
+    // around it, once the area's blocks have changed
+    void remeshArea(int minX, int minZ, int w, int h);
+    // Overwrites the loaded zones the height map import has written
+    void applyImportedZones();
+    void findVisibleSections(const std::vector<Chunk*> &chunks, glm::ivec2 origin, glm::ivec2 size,
+                             const Frustum &frustum, glm::vec3 eye, std::vector<bool> &visible) const;
 
 public:
     Terrain(OpenGLContext *context);
@@ -101,10 +204,43 @@ public:
     // given type.
     void setBlockAt(int x, int y, int z, BlockType t);
 
-    // Draws every Chunk that falls within the bounding box
-    // described by the min and max coords, using the provided
-    // ShaderProgram
-    void draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram);
+    // Non-throwing versions of the above for per-frame callers, which
+    // regularly query the edge of the loaded Terrain.
+    // The Chunk containing these world-space coordinates, or
+    // nullptr if it isn't loaded
+    const Chunk* findChunkAt(int x, int z) const noexcept;
+    Chunk* findChunkAt(int x, int z) noexcept;
+    // UNLOADED if the block's Chunk doesn't exist, EMPTY above
+    // or below the world
+    BlockType tryGetBlockAt(int x, int y, int z) const noexcept;
+    BlockType tryGetBlockAt(glm::vec3 p) const noexcept;
+    // Returns false, changing nothing, if the block's Chunk
+    // doesn't exist or y is outside the world
+    bool trySetBlockAt(int x, int y, int z, BlockType t) noexcept;
+
+    // Uploads the transparent face orderings workers have finished and
+    // starts new sorts for meshed Chunks the camera has moved relative to
+    void sortTransparentFaces(glm::vec3 eye);
+
+    // Allocates the GPU buffers every Chunk's meshes are uploaded into.
+    // Must be called with a current OpenGL context before any Chunk
+    // is given VBOs.
+    void createArena();
+    const ChunkArena& getArena() const;
+
+    // Draws the sections of every Chunk within the render distance
+    // that intersect the frustum and can be seen from eye through
+    // non-opaque blocks, using the provided ShaderProgram.
+    // Only opaque faces are drawn; the transparent ones are kept for
+    // drawTransparent so anything behind them can be drawn in between.
+    void draw(ShaderProgram *shaderProgram, const Frustum &frustum, glm::vec3 eye);
+    // Draws the transparent faces of the sections the last draw() found
+    // visible, back to front
+    void drawTransparent(ShaderProgram *shaderProgram);
+    int getChunksVisible() const;
+    int getChunksInRange() const;
+    int getSectionsVisible() const;
+    int getSectionsInRange() const;
 
     // Checks whether a new Chunk should be added to the Terrain
     // based on the Player's proximity to the edge of a Chunk without a neighbor in a particular direction.
@@ -117,9 +253,42 @@ public:
     // see when the base code is run.
     void CreateTestScene();
     bool initialTerrainDoneLoading();
-    void multithreadedWork(glm::vec3 playerPos, glm::vec3 playerPosPrev, float dT);
+    // Only affects Chunks generated after the call
+    void setBiomeBlend(const BiomeBlend &blend);
+    const BiomeBlend& getBiomeBlend() const;
+    // Only affects Chunks instantiated after the call
+    void setSeed(unsigned int seed);
+    unsigned int getSeed() const;
+    // Streams zones from a world directory written by the pregen tool,
+    // falling back to generating zones it doesn't have (or that were
+    // made with another seed). Call after setSeed.
+    void setWorldDirectory(const QString &directory);
+    bool hasWorldDirectory() const;
+    void multithreadedWork(glm::vec3 playerPos, float dT);
+
+    static constexpr int MIN_RENDER_DISTANCE = 2;
+    static constexpr int DEFAULT_RENDER_DISTANCE = 8;
+    // Keeps the farthest zone inside the Camera's far clip plane
+    static constexpr int MAX_RENDER_DISTANCE = 48;
+    // Zones within distance Chunks of the Player's zone are meshed and
+    // drawn, those a zone further are generated, and those more than
+    // EVICT_MARGIN zones past that are unloaded. Clamped to
+    // [MIN_RENDER_DISTANCE, MAX_RENDER_DISTANCE].
+    void setRenderDistance(int distance);
+    int getRenderDistance() const;
+    // Number of zones in memory
+    int getZonesLoaded() const;
 
-    // For height map feature
-    void updategrayscaleHeights(int playerX, int playerZ, std::vector<std::vector<float>> newHeights);
-    void updateColorHeights(int playerX, int playerZ, std::vector<std::vector<std::pair<float, BlockType>>> newHeights);
+    // Replaces the columns of the w x h area with corner (minX, minZ),
+    // column (x, z) of the area being columns[x * h + z]. Every Chunk the
+    // area touches is filled by its own parallel task, then remeshed with
+    // its neighbors by VBOWorkers.
+    void importColumns(int minX, int minZ, int w, int h, const std::vector<ImportedColumn> &columns);
+    // Imports the height map in path (see HeightMapFile) with its center
+    // at center, replacing any import still running. Zones are written
+    // to the world directory by worker threads, and the loaded ones are
+    // overwritten as they're done; the rest stream in from the directory
+    // when the Player comes near. Returns false, setting error, if there's
+    // no world directory or the file can't be read.
+    bool importHeightMap(const QString &path, glm::ivec2 center, QString *error);
 };
@@ -10,11 +10,12 @@ ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
       attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1),attrAnim(-1),
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1),unifSampler(-1), unifTime(-1),
-      unifCase(-1),
+      unifDimensions(-1), unifEye(-1), unifSkyViewProj(-1), unifFogDistance(-1),
+      m_model(), m_viewProj(), m_color(), m_sampler(), m_time(),
       context(context)
 {}
 
-void ShaderProgram::create(const char *vertfile, const char *fragfile)
+void ShaderProgram::create(const char *vertfile, const char *fragfile, const QString &fragDefines)
 {
     // Allocate space on our GPU for a vertex shader and a fragment shader and a shader program to manage the two
     vertShader = context->glCreateShader(GL_VERTEX_SHADER);
@@ -23,6 +24,11 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     // Get the body of text stored in our two .glsl files
     QString qVertSource = qTextFileRead(vertfile);
     QString qFragSource = qTextFileRead(fragfile);
+    // Both stages get the shared FrameData block after their #version line.
+    // #line restores the file's own numbering for compile errors.
+    QString frameDataSource = qTextFileRead(":/glsl/framedata.glsl") % "#line 2\n";
+    qVertSource.insert(qVertSource.indexOf('\n') + 1, frameDataSource);
+    qFragSource.insert(qFragSource.indexOf('\n') + 1, fragDefines % frameDataSource);
 
     char* vertSource = new char[qVertSource.size()+1];
     strcpy(vertSource, qVertSource.toStdString().c_str());
@@ -76,19 +82,30 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     unifColor      = context->glGetUniformLocation(prog, "u_Color");
     unifSampler = context->glGetUniformLocation(prog, "u_Texture");
     unifTime = context->glGetUniformLocation(prog, "u_Time");
-    unifCase = context->glGetUniformLocation(prog, "u_Case");
     // Sky
     unifDimensions = context->glGetUniformLocation(prog, "u_Dimensions");
     unifEye = context->glGetUniformLocation(prog, "u_Eye");
+    unifSkyViewProj = context->glGetUniformLocation(prog, "u_SkyViewProj");
+    unifFogDistance = context->glGetUniformLocation(prog, "u_FogDistance");
+
+    // Read the per-frame values from the shared uniform buffer
+    GLuint frameData = context->glGetUniformBlockIndex(prog, "FrameData");
+    if (frameData != GL_INVALID_INDEX) {
+        context->glUniformBlockBinding(prog, frameData, FRAME_DATA_BINDING);
+    }
 }
 
 void ShaderProgram::useMe()
 {
-    context->glUseProgram(prog);
+    context->useProgram(prog);
 }
 
 void ShaderProgram::setModelMatrix(const glm::mat4 &model)
 {
+    if (m_model == model) {
+        return;
+    }
+    m_model = model;
     useMe();
 
     if (unifModel != -1) {
@@ -104,7 +121,16 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
     }
 
     if (unifModelInvTr != -1) {
-        glm::mat4 modelinvtr = glm::inverse(glm::transpose(model));
+        glm::mat4 modelinvtr;
+        if (glm::mat3(model) == glm::mat3()) {
+            // Translation by t: the inverse transpose is the
+            // identity with -t along the bottom row
+            modelinvtr[0][3] = -model[3][0];
+            modelinvtr[1][3] = -model[3][1];
+            modelinvtr[2][3] = -model[3][2];
+        } else {
+            modelinvtr = glm::inverse(glm::transpose(model));
+        }
         // Pass a 4x4 matrix into a uniform variable in our shader
                         // Handle to the matrix variable on the GPU
         context->glUniformMatrix4fv(unifModelInvTr,
@@ -120,7 +146,8 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
 void ShaderProgram::setSampler(GLuint sampler) {
     useMe();
     context->glActiveTexture(GL_TEXTURE0);
-    if (unifSampler != -1) {
+    if (unifSampler != -1 && m_sampler != static_cast<int>(sampler)) {
+        m_sampler = sampler;
         context->glUniform1i(unifSampler, sampler);
     }
 }
@@ -130,16 +157,25 @@ void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
     // Tell OpenGL to use this shader program for subsequent function calls
     useMe();
 
-    if(unifViewProj != -1) {
-    // Pass a 4x4 matrix into a uniform variable in our shader
-                    // Handle to the matrix variable on the GPU
-    context->glUniformMatrix4fv(unifViewProj,
-                    // How many matrices to pass
-                       1,
-                    // Transpose the matrix? OpenGL uses column-major, so no.
-                       GL_FALSE,
-                    // Pointer to the first element of the matrix
-                       &vp[0][0]);
+    if(unifViewProj != -1 && m_viewProj != vp) {
+        m_viewProj = vp;
+        // Pass a 4x4 matrix into a uniform variable in our shader
+                        // Handle to the matrix variable on the GPU
+        context->glUniformMatrix4fv(unifViewProj,
+                        // How many matrices to pass
+                           1,
+                        // Transpose the matrix? OpenGL uses column-major, so no.
+                           GL_FALSE,
+                        // Pointer to the first element of the matrix
+                           &vp[0][0]);
+    }
+}
+
+void ShaderProgram::setSkyViewProjMatrix(const glm::mat4 &vp)
+{
+    useMe();
+    if (unifSkyViewProj != -1) {
+        context->glUniformMatrix4fv(unifSkyViewProj, 1, GL_FALSE, &vp[0][0]);
     }
 }
 
@@ -147,15 +183,17 @@ void ShaderProgram::setGeometryColor(glm::vec4 color)
 {
     useMe();
 
-    if(unifColor != -1)
+    if(unifColor != -1 && m_color != color)
     {
+        m_color = color;
         context->glUniform4fv(unifColor, 1, &color[0]);
     }
 }
 
 void ShaderProgram::setTime(int time) {
     useMe();
-    if (unifTime != -1) {
+    if (unifTime != -1 && m_time != time) {
+        m_time = time;
         context->glUniform1i(unifTime, time);
     }
 }
@@ -197,6 +235,7 @@ void ShaderProgram::draw(Drawable &d)
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
+    context->countDraw(d.drawMode(), d.elemCount());
 
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
@@ -209,7 +248,10 @@ void ShaderProgram::draw(Drawable &d, int textureSlot) {
     useMe();
 
     // Set our "renderedTexture" sampler to user Texture Unit 0
-    context->glUniform1i(unifSampler, textureSlot);
+    if (unifSampler != -1 && m_sampler != textureSlot) {
+        m_sampler = textureSlot;
+        context->glUniform1i(unifSampler, textureSlot);
+    }
 
     // Each of the following blocks checks that:
     //   * This shader has this attribute, and
@@ -229,6 +271,7 @@ void ShaderProgram::draw(Drawable &d, int textureSlot) {
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
     context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
+    context->countDraw(d.drawMode(), d.elemCount());
 
     if (attrPos != -1) {
         context->glDisableVertexAttribArray(attrPos);
@@ -285,84 +328,68 @@ void ShaderProgram::drawInstanced(InstancedDrawable &d)
     // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
     context->glDrawElementsInstanced(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0, d.instanceCount());
+    context->countDraw(d.drawMode(), qint64(d.elemCount()) * d.instanceCount());
     context->printGLErrorLog();
 
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
-    if (attrPosOffset != -1) context->glDisableVertexAttribArray(attrPosOffset);
-
+    // The divisors are VAO state, and other programs may use the same
+    // attribute locations for per-vertex data
+    if (attrCol != -1) {
+        context->glVertexAttribDivisor(attrCol, 0);
+        context->glDisableVertexAttribArray(attrCol);
+    }
+    if (attrPosOffset != -1) {
+        context->glVertexAttribDivisor(attrPosOffset, 0);
+        context->glDisableVertexAttribArray(attrPosOffset);
+    }
 }
 
 // Draw the given chunk object to our screen using interleaved VBOs
-void ShaderProgram::drawInterleaved(Chunk &c, bool drawOpaque) {
+void ShaderProgram::drawMultiInterleaved(ChunkArena &arena, const std::vector<GLsizei> &counts,
+                                         const std::vector<const void*> &offsets,
+                                         const std::vector<GLint> &baseVertices) {
     useMe();
 
-    if (drawOpaque) {
-        if (c.elemCount() < 0) {
-            throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(c.elemCount()) + "!");
-        }
-
-        if (c.bindPos()) {
-            if (attrPos != -1) {
-                context->glEnableVertexAttribArray(attrPos);
-                context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*) 0);
-            }
-
-            if (attrNor != -1) {
-                context->glEnableVertexAttribArray(attrNor);
-                context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*) (sizeof(glm::vec4)));
-            }
-
-            if (attrUV != -1) {
-                context->glEnableVertexAttribArray(attrUV);
-                context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*) (2 * sizeof(glm::vec4)));
-            }
+    if (counts.empty()) {
+        return;
+    }
+    if (arena.elemCount() < 0) {
+        throw std::out_of_range("Attempting to draw from a ChunkArena whose buffers were not created!");
+    }
 
-            if (attrAnim != -1) {
-                context->glEnableVertexAttribArray(attrAnim);
-                context->glVertexAttribPointer(attrAnim, 1, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void *) (10 * sizeof(float)));
-            }
+    // The attribute layout and index buffer are stored in the arena's
+    // VAO and only need to be specified when it changes
+    if (arena.bindVAO(prog) && arena.bindPos()) {
+        if (attrPos != -1) {
+            context->glEnableVertexAttribArray(attrPos);
+            context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, ChunkArena::VERTEX_SIZE, (void*) 0);
         }
 
-        // Bind the index buffer and then draw shapes from it.
-        // This invokes the shader program, which accesses the vertex buffers.
-        c.bindIdx();
-        context->glDrawElements(c.drawMode(), c.elemCount(), GL_UNSIGNED_INT, 0);
-    } else {
-        if (c.elemCount2() < 0) {
-            throw std::out_of_range("Attempting to draw a drawable with m_count2 of " + std::to_string(c.elemCount2()) + "!");
+        if (attrNor != -1) {
+            context->glEnableVertexAttribArray(attrNor);
+            context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, ChunkArena::VERTEX_SIZE, (void*) (sizeof(glm::vec4)));
         }
 
-        if (c.bindPos2()) {
-            if (attrPos != -1) {
-                context->glEnableVertexAttribArray(attrPos);
-                context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*) 0);
-            }
-
-            if (attrNor != -1) {
-                context->glEnableVertexAttribArray(attrNor);
-                context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*) (sizeof(glm::vec4)));
-            }
-
-            if (attrUV != -1) {
-                context->glEnableVertexAttribArray(attrUV);
-                context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void*) (2 * sizeof(glm::vec4)));
-            }
+        if (attrUV != -1) {
+            context->glEnableVertexAttribArray(attrUV);
+            context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, ChunkArena::VERTEX_SIZE, (void*) (2 * sizeof(glm::vec4)));
+        }
 
-            if (attrAnim != -1) {
-                context->glEnableVertexAttribArray(attrAnim);
-                context->glVertexAttribPointer(attrAnim, 1, GL_FLOAT, false, 3 * sizeof(glm::vec4), (void *) (10 * sizeof(float)));
-            }
+        if (attrAnim != -1) {
+            context->glEnableVertexAttribArray(attrAnim);
+            context->glVertexAttribPointer(attrAnim, 1, GL_FLOAT, false, ChunkArena::VERTEX_SIZE, (void *) (10 * sizeof(float)));
         }
 
-        // Bind the index buffer and then draw shapes from it.
-        // This invokes the shader program, which accesses the vertex buffers.
-        c.bindIdx2();
-        context->glDrawElements(c.drawMode(), c.elemCount2(), GL_UNSIGNED_INT, 0);
+        if (arena.bindIdx()) {
+            arena.setVAOConfigured(prog);
+        }
     }
 
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
+    // Every Chunk's index ranges come from the same index buffer,
+    // so the whole pass is a single draw call
+    context->multiDrawElementsBaseVertex(arena.drawMode(), counts.data(), GL_UNSIGNED_INT, offsets.data(),
+                                         counts.size(), baseVertices.data());
 
     context->printGLErrorLog();
 }
@@ -389,10 +416,11 @@ char* ShaderProgram::textFileRead(const char* fileName) {
     return text;
 }
 
-void ShaderProgram::setUCase(int Ucase) {
+void ShaderProgram::setFogDistance(float distance) {
     useMe();
-    if (unifCase != -1) {
-        context->glUniform1i(unifCase, Ucase);
+    if (unifFogDistance != -1 && m_fogDistance != distance) {
+        m_fogDistance = distance;
+        context->glUniform1f(unifFogDistance, distance);
     }
 }
 
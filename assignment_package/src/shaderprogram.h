@@ -7,7 +7,19 @@
 #include <glm/glm.hpp>
 
 #include "drawable.h"
+#include <optional>
 
+// Mirrors the std140 FrameData uniform block of glsl/framedata.glsl.
+// MyGL uploads it once per frame into a uniform buffer bound at
+// FRAME_DATA_BINDING, which every ShaderProgram reads from.
+struct FrameData {
+    glm::mat4 viewProj;
+    glm::mat4 invViewProj;
+    glm::vec3 eye;
+    int time;
+};
+static_assert(sizeof(FrameData) == 144, "FrameData must match the std140 layout of glsl/framedata.glsl");
+#define FRAME_DATA_BINDING 0
 
 class ShaderProgram
 {
@@ -31,8 +43,6 @@ public:
 
     int unifSampler; // A handle for the "uniform" GLuint representing sampler
     int unifTime;    // A handle for the "uniform" GLuint representing time
-    int unifCase; // A handle for the "uniform" int representing the post render
-                  // type 0 no post 1 water 2 lava;
     int unifSampler2D; // A handle to the "uniform" sampler2D that will be used
                        // to
                        // read the texture containing the scene render
@@ -40,31 +50,56 @@ public:
     // Sky demo
     int unifDimensions;
     int unifEye;
+    int unifSkyViewProj; // View-projection the cached sky was rendered with
+    int unifFogDistance; // Distance at which the terrain fades into the sky
+
+private:
+    // The last values uploaded to this program's uniforms, so the
+    // setters can skip uploads that wouldn't change anything
+    std::optional<glm::mat4> m_model, m_viewProj;
+    std::optional<glm::vec4> m_color;
+    std::optional<int> m_sampler, m_time;
+    std::optional<float> m_fogDistance;
 
 public:
     ShaderProgram(OpenGLContext* context);
-    // Sets up the requisite GL data and shaders from the given .glsl files
-    void create(const char *vertfile, const char *fragfile);
-    // Tells our OpenGL context to use this shader to draw things
+    // Sets up the requisite GL data and shaders from the given .glsl files.
+    // Both shaders' first line must be their #version. glsl/framedata.glsl
+    // is inserted after it, and fragDefines, e.g. "#define LAVA\n", is
+    // inserted after it in the fragment shader.
+    void create(const char *vertfile, const char *fragfile, const QString &fragDefines = QString());
+    // Tells our OpenGL context to use this shader to draw things.
+    // Does nothing if it is already in use.
     void useMe();
-    // Pass the given model matrix to this shader on the GPU
+    // Pass the given model matrix to this shader on the GPU.
+    // The inverse transpose of a pure translation is built directly
+    // instead of inverting the matrix.
     void setModelMatrix(const glm::mat4 &model);
     // Pass the given Projection * View matrix to this shader on the GPU
     void setViewProjMatrix(const glm::mat4 &vp);
+    // Pass the view-projection matrix the sky texture being upsampled
+    // was rendered with to this shader on the GPU
+    void setSkyViewProjMatrix(const glm::mat4 &vp);
     // Pass the given color to this shader on the GPU
     void setGeometryColor(glm::vec4 color);
     // Draw the given object to our screen using this ShaderProgram's shaders
     void draw(Drawable &d);
     void draw(Drawable &d, int textureSlot);
-    void setUCase(int Ucase);
+    // Pass the distance, in blocks, at which the distance fog
+    // is opaque to this shader on the GPU
+    void setFogDistance(float distance);
     // Pass the given sampler to this shader on the GPU
     void setSampler(GLuint sampler);
     // Update uniform time
     void setTime(int time);
     // Draw the given object to our screen multiple times using instanced rendering
     void drawInstanced(InstancedDrawable &d);
-    // Draw the given object to our screen using interleaved VBOs
-    void drawInterleaved(Chunk &c, bool drawOpaque);
+    // Draw several meshes out of the given ChunkArena with one call. Draw i
+    // reads counts[i] indices starting at byte offset offsets[i] of the
+    // arena's index buffer, each added to baseVertices[i].
+    // Leaves the arena's VAO bound.
+    void drawMultiInterleaved(ChunkArena &arena, const std::vector<GLsizei> &counts,
+                              const std::vector<const void*> &offsets, const std::vector<GLint> &baseVertices);
     // Utility function used in create()
     char* textFileRead(const char*);
     // Utility function that prints any shader compilation errors to the console
@@ -3,12 +3,28 @@ DEPENDPATH += $$PWD
 
 SOURCES += \
     $$PWD/framebuffer.cpp \
+    $$PWD/framegraph.cpp \
+    $$PWD/frameprofiler.cpp \
+    $$PWD/inputrecording.cpp \
     $$PWD/main.cpp \
     $$PWD/mainwindow.cpp \
     $$PWD/mygl.cpp \
     $$PWD/noise_functions.cpp \
+    $$PWD/postchain.cpp \
+    $$PWD/renderbenchmark.cpp \
+    $$PWD/scene/cameraspline.cpp \
     $$PWD/scene/chunkworkers.cpp \
+    $$PWD/scene/chunkarena.cpp \
+    $$PWD/scene/chunkstore.cpp \
+    $$PWD/scene/collision.cpp \
+    $$PWD/scene/frustum.cpp \
+    $$PWD/scene/heightmapfile.cpp \
+    $$PWD/scene/heightmapimport.cpp \
+    $$PWD/scene/mobsystem.cpp \
+    $$PWD/scene/parallelfor.cpp \
     $$PWD/scene/quad.cpp \
+    $$PWD/scene/raycast.cpp \
+    $$PWD/scene/spatialhash.cpp \
     $$PWD/shaderprogram.cpp \
     $$PWD/drawable.cpp \
     $$PWD/cameracontrolshelp.cpp \
@@ -24,12 +40,28 @@ SOURCES += \
 
 HEADERS += \
     $$PWD/framebuffer.h \
+    $$PWD/framegraph.h \
+    $$PWD/frameprofiler.h \
+    $$PWD/inputrecording.h \
     $$PWD/mainwindow.h \
     $$PWD/mygl.h \
     $$PWD/noise_functions.h \
+    $$PWD/postchain.h \
+    $$PWD/renderbenchmark.h \
+    $$PWD/scene/cameraspline.h \
     $$PWD/scene/chunkhelpers.h \
     $$PWD/scene/chunkworkers.h \
+    $$PWD/scene/chunkarena.h \
+    $$PWD/scene/chunkstore.h \
+    $$PWD/scene/collision.h \
+    $$PWD/scene/frustum.h \
+    $$PWD/scene/heightmapfile.h \
+    $$PWD/scene/heightmapimport.h \
+    $$PWD/scene/mobsystem.h \
+    $$PWD/scene/parallelfor.h \
     $$PWD/scene/quad.h \
+    $$PWD/scene/raycast.h \
+    $$PWD/scene/spatialhash.h \
     $$PWD/shaderprogram.h \
     $$PWD/drawable.h \
     $$PWD/cameracontrolshelp.h \
@@ -0,0 +1,14 @@
+# Randomized test and benchmark of sweepAABB. Build with
+#   qmake tools/collisionfuzz/collisionfuzz.pro && make
+# and run `collisionfuzz --help` for its options. Exits with a nonzero
+# status if any check fails.
+TARGET = collisionfuzz
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += release
+
+include(../common/terraincore.pri)
+
+SOURCES += \
+    $$PWD/main.cpp
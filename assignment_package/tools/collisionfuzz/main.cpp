@@ -0,0 +1,211 @@
+#include "collision.h"
+#include "raycast.h"
+#include "terrain.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// The blocks are scattered over a 60 x 60 area inside the 4 x 4 Chunks
+// loaded around the origin, so every box and move below stays inside
+// the loaded Terrain
+static const int AREA = 30;
+static const int FLOOR_Y = 60;
+
+// Whether box overlaps a solid block, ignoring faces that only touch one
+static bool overlapsSolid(const AABB &box, const Terrain &terrain) {
+    const float eps = 1e-4f;
+    for (int x = int(glm::floor(box.min.x + eps)); x <= int(glm::floor(box.max.x - eps)); x++) {
+        for (int y = int(glm::floor(box.min.y + eps)); y <= int(glm::floor(box.max.y - eps)); y++) {
+            for (int z = int(glm::floor(box.min.z + eps)); z <= int(glm::floor(box.max.z - eps)); z++) {
+                if (blocksMovement(terrain.getBlockAt(x, y, z))) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+struct FuzzStats {
+    int boxes = 0;
+    // The box overlapped a solid block somewhere along its path
+    int overlaps = 0;
+    // An axis was reported blocked with no solid block just ahead of it
+    int falseStops = 0;
+    // An axis moved farther than asked, or backwards
+    int overshoots = 0;
+};
+
+// Sweeps random boxes by random displacements through blocks scattered
+// above the floor, and replays every move in small steps to check it
+static FuzzStats fuzz(const Terrain &terrain, std::mt19937 &rng, int count) {
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    FuzzStats stats;
+    while (stats.boxes < count) {
+        glm::vec3 pos(u(rng) * 40.f - 20.f, FLOOR_Y + 40.f + u(rng) * 28.f, u(rng) * 40.f - 20.f);
+        glm::vec3 size(0.3f + u(rng) * 2.f, 0.3f + u(rng) * 2.5f, 0.3f + u(rng) * 2.f);
+        AABB box(pos, pos + size);
+        if (overlapsSolid(box, terrain)) {
+            continue;
+        }
+        stats.boxes++;
+        glm::vec3 d((u(rng) - 0.5f) * 6.f, (u(rng) - 0.5f) * 6.f, (u(rng) - 0.5f) * 6.f);
+        SweepResult r = sweepAABB(box, d, terrain);
+
+        AABB moving = box;
+        for (int axis : {1, 0, 2}) {
+            if (glm::abs(r.moved[axis]) > glm::abs(d[axis]) + 1e-6f || r.moved[axis] * d[axis] < 0.f) {
+                stats.overshoots++;
+            }
+            const int steps = 200;
+            bool overlapped = false;
+            for (int s = 1; s <= steps && !overlapped; s++) {
+                glm::vec3 offset(0.f);
+                offset[axis] = r.moved[axis] * s / steps;
+                overlapped = overlapsSolid(moving.translated(offset), terrain);
+            }
+            if (overlapped) {
+                stats.overlaps++;
+                break;
+            }
+            moving.min[axis] += r.moved[axis];
+            moving.max[axis] += r.moved[axis];
+            if (r.blocked[axis]) {
+                glm::vec3 nudge(0.f);
+                nudge[axis] = glm::sign(d[axis]) * 3e-4f;
+                if (!overlapsSolid(moving.translated(nudge), terrain)) {
+                    stats.falseStops++;
+                }
+            }
+        }
+    }
+    return stats;
+}
+
+// What Player::moveAlongVectorWithCollisions did before sweepAABB: a ray
+// along each axis of the move from each of the 12 corners of its box
+// at heights 0, 1 and 2, clamping that axis to the nearest hit
+static glm::vec3 cornerRayMove(glm::vec3 pos, glm::vec3 dir, const Terrain &terrain) {
+    for (float y : {0.f, 1.f, 2.f}) {
+        for (glm::vec2 corner : {glm::vec2(0.5f, 0.5f), glm::vec2(0.5f, -0.5f),
+                                 glm::vec2(-0.5f, -0.5f), glm::vec2(-0.5f, 0.5f)}) {
+            glm::vec3 origin = pos + glm::vec3(corner.x, y, corner.y);
+            for (int axis = 0; axis < 3; axis++) {
+                if (dir[axis] == 0.f) {
+                    continue;
+                }
+                glm::vec3 direction(0.f);
+                direction[axis] = dir[axis];
+                RayHit hit = raycast(Ray(origin, direction, glm::abs(dir[axis])), terrain);
+                if (hit.hit) {
+                    dir[axis] = hit.distance > 0.001f
+                            ? glm::sign(dir[axis]) * glm::max(glm::min(glm::abs(dir[axis]), hit.distance) - 0.0001f, 0.f)
+                            : 0.f;
+                }
+            }
+        }
+    }
+    return dir;
+}
+
+// Times single-tick walking moves of the Player's 1 x 2 x 1 box standing
+// on the floor, through sweepAABB and through the corner rays, and
+// reports the time per move of each
+static void benchmarkWalking(const Terrain &terrain, std::mt19937 &rng, int count) {
+    std::uniform_real_distribution<float> u(0.f, 1.f);
+    std::vector<glm::vec3> positions, moves;
+    for (int i = 0; i < count; i++) {
+        positions.push_back(glm::vec3(u(rng) * 40.f - 20.f, FLOOR_Y + 1.0001f, u(rng) * 40.f - 20.f));
+        moves.push_back(glm::vec3((u(rng) - 0.5f) * 0.5f, -0.1f, (u(rng) - 0.5f) * 0.5f));
+    }
+
+    // Sum the results so the calls can't be optimized away
+    float sink = 0.f;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; i++) {
+        glm::vec3 p = positions[i];
+        sink += sweepAABB(AABB(p + glm::vec3(-0.5f, 0.f, -0.5f), p + glm::vec3(0.5f, 2.f, 0.5f)), moves[i], terrain).moved.x;
+    }
+    double sweepNs = static_cast<double>(timer.nsecsElapsed()) / count;
+    timer.restart();
+    for (int i = 0; i < count; i++) {
+        sink += cornerRayMove(positions[i], moves[i], terrain).x;
+    }
+    double raysNs = static_cast<double>(timer.nsecsElapsed()) / count;
+
+    printf("\nWalking moves (%d moves)\n", count);
+    printf("  %-14s %10.1f ns/move\n", "sweepAABB", sweepNs);
+    printf("  %-14s %10.1f ns/move\n", "corner rays", raysNs);
+    printf("  (checksum %g)\n", sink);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("collisionfuzz");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Checks sweepAABB against random boxes and moves, and times it against per-corner rays.");
+    parser.addHelpOption();
+    QCommandLineOption seedOption("seed", "Random seed.", "seed", "1");
+    QCommandLineOption boxesOption("boxes", "Number of random boxes to sweep.", "n", "100000");
+    QCommandLineOption blocksOption("blocks", "Number of random blocks to scatter.", "n", "6000");
+    QCommandLineOption movesOption("moves", "Number of walking moves to time, 0 to skip.", "n", "20000");
+    parser.addOptions({seedOption, boxesOption, blocksOption, movesOption});
+    parser.process(a);
+
+    unsigned int seed = parser.value(seedOption).toUInt();
+    int boxes = std::max(0, parser.value(boxesOption).toInt());
+    int blocks = std::max(0, parser.value(blocksOption).toInt());
+    int moves = std::max(0, parser.value(movesOption).toInt());
+
+    // No GL context: the Chunks only hold blocks
+    Terrain terrain(nullptr);
+    for (int x = -32; x < 32; x += 16) {
+        for (int z = -32; z < 32; z += 16) {
+            terrain.instantiateChunkAt(x, z);
+        }
+    }
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> coord(-AREA, AREA - 1), height(FLOOR_Y + 40, FLOOR_Y + 70);
+    for (int i = 0; i < blocks; i++) {
+        terrain.setBlockAt(coord(rng), height(rng), coord(rng), STONE);
+    }
+    for (int x = -AREA; x < AREA; x++) {
+        for (int z = -AREA; z < AREA; z++) {
+            terrain.setBlockAt(x, FLOOR_Y, z, STONE);
+        }
+    }
+
+    FuzzStats stats = fuzz(terrain, rng, boxes);
+    printf("Seed %u, %d blocks\n", seed, blocks);
+    printf("Swept %d boxes: %d overlapped a block, %d stopped with no block ahead, %d moved too far\n",
+           stats.boxes, stats.overlaps, stats.falseStops, stats.overshoots);
+
+    // A box resting on the floor slides along it, and a one-block wall
+    // stops a move much longer than the box
+    AABB resting(glm::vec3(0.2f, FLOOR_Y + 1, 0.2f), glm::vec3(1.2f, FLOOR_Y + 3, 1.2f));
+    SweepResult slide = sweepAABB(resting, glm::vec3(5.f, -1.f, 3.f), terrain);
+    bool slid = slide.moved.x == 5.f && slide.moved.z == 3.f && slide.blocked.y && !slide.blocked.x && !slide.blocked.z;
+    printf("Sliding along the floor: moved (%g, %g, %g), %s\n",
+           slide.moved.x, slide.moved.y, slide.moved.z, slid ? "ok" : "FAILED");
+    for (int y = FLOOR_Y + 1; y < FLOOR_Y + 6; y++) {
+        for (int z = -5; z < 5; z++) {
+            terrain.setBlockAt(5, y, z, STONE);
+        }
+    }
+    SweepResult wall = sweepAABB(resting, glm::vec3(20.f, 0.f, 0.f), terrain);
+    bool stopped = wall.blocked.x && wall.moved.x < 5.f - resting.max.x + 1e-3f;
+    printf("Moving 20 blocks into a wall: moved %g, %s\n", wall.moved.x, stopped ? "ok" : "FAILED");
+
+    if (moves > 0) {
+        benchmarkWalking(terrain, rng, moves);
+    }
+
+    bool ok = stats.overlaps == 0 && stats.falseStops == 0 && stats.overshoots == 0 && slid && stopped;
+    return ok ? 0 : 1;
+}
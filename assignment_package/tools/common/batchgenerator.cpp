@@ -0,0 +1,108 @@
+#include "batchgenerator.h"
+#include <QElapsedTimer>
+
+BatchGenerator::BatchGenerator(Terrain &terrain, int threads)
+    : m_terrain(terrain), m_pool()
+{
+    m_pool.setMaxThreadCount(threads);
+}
+
+double BatchGenerator::runPhase(const std::vector<int64_t> &zones, const std::function<void(int64_t)> &task) {
+    QElapsedTimer timer;
+    timer.start();
+    for (int64_t zone : zones) {
+        m_pool.start([&task, zone]() { task(zone); });
+    }
+    m_pool.waitForDone();
+    return timer.nsecsElapsed() * 1e-9;
+}
+
+Chunk* BatchGenerator::chunkAt(int x, int z) const {
+    const Terrain &terrain = m_terrain;
+    return terrain.getChunkAt(x, z).get();
+}
+
+void BatchGenerator::runStage(int64_t zone, GenerationStage stage) {
+    glm::ivec2 coord = toCoords(zone);
+    for (int x = coord.x; x < coord.x + 64; x += 16) {
+        for (int z = coord.y; z < coord.y + 64; z += 16) {
+            chunkAt(x, z)->runGenerationStage(stage, m_terrain.getBiomeBlend());
+        }
+    }
+}
+
+std::vector<int64_t> BatchGenerator::generate(glm::ivec2 centerZone, int radius, bool mesh, BatchStats *stats) {
+    return generate(centerZone - glm::ivec2(64 * radius), centerZone + glm::ivec2(64 * radius), mesh, stats);
+}
+
+std::vector<int64_t> BatchGenerator::generate(glm::ivec2 minZone, glm::ivec2 maxZone, bool mesh, BatchStats *stats) {
+    BatchStats result;
+    QElapsedTimer total;
+    total.start();
+
+    // Zones that get their surface, the ones that get decorated
+    // (those whose +X and +Z neighbors exist) and the ones that are completed
+    std::vector<int64_t> outer, decorated, inner;
+    for (int x = minZone.x - 64; x <= maxZone.x + 64; x += 64) {
+        for (int z = minZone.y - 64; z <= maxZone.y + 64; z += 64) {
+            int64_t zone = toKey(x, z);
+            outer.push_back(zone);
+            if (x <= maxZone.x && z <= maxZone.y) {
+                decorated.push_back(zone);
+            }
+            if (x >= minZone.x && z >= minZone.y && x <= maxZone.x && z <= maxZone.y) {
+                inner.push_back(zone);
+            }
+        }
+    }
+
+    // Chunks are created on this thread, as Terrain's map isn't thread safe
+    for (int64_t zone : outer) {
+        glm::ivec2 coord = toCoords(zone);
+        for (int x = coord.x; x < coord.x + 64; x += 16) {
+            for (int z = coord.y; z < coord.y + 64; z += 16) {
+                m_terrain.instantiateChunkAt(x, z);
+            }
+        }
+    }
+
+    for (int stage = HEIGHTFIELD; stage <= SURFACE; stage++) {
+        result.stageSeconds[stage] = runPhase(outer, [this, stage](int64_t zone) {
+            runStage(zone, static_cast<GenerationStage>(stage));
+        });
+    }
+    for (int parity = 0; parity < 4; parity++) {
+        std::vector<int64_t> pass;
+        for (int64_t zone : decorated) {
+            glm::ivec2 coord = toCoords(zone) / 64;
+            if (((coord.x & 1) | ((coord.y & 1) << 1)) == parity) {
+                pass.push_back(zone);
+            }
+        }
+        result.stageSeconds[DECORATION] += runPhase(pass, [this](int64_t zone) {
+            runStage(zone, DECORATION);
+        });
+    }
+    result.stageSeconds[FLUIDS] = runPhase(inner, [this](int64_t zone) {
+        runStage(zone, FLUIDS);
+    });
+
+    if (mesh) {
+        result.meshSeconds = runPhase(inner, [this](int64_t zone) {
+            glm::ivec2 coord = toCoords(zone);
+            for (int x = coord.x; x < coord.x + 64; x += 16) {
+                for (int z = coord.y; z < coord.y + 64; z += 16) {
+                    chunkAt(x, z)->createVBOdata();
+                }
+            }
+        });
+    }
+
+    result.totalSeconds = total.nsecsElapsed() * 1e-9;
+    result.zones = static_cast<int>(inner.size());
+    result.chunks = result.zones * 16;
+    if (stats != nullptr) {
+        *stats = result;
+    }
+    return inner;
+}
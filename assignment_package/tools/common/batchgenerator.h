@@ -0,0 +1,51 @@
+#pragma once
+#include "terrain.h"
+#include <QThreadPool>
+#include <array>
+#include <functional>
+#include <vector>
+
+// Wall-clock time spent in each phase of one BatchGenerator::generate call
+struct BatchStats {
+    // Indexed by GenerationStage; UNGENERATED is unused
+    std::array<double, FLUIDS + 1> stageSeconds;
+    double meshSeconds;
+    double totalSeconds;
+    // Zones and Chunks that were generated through FLUIDS
+    int zones;
+    int chunks;
+
+    BatchStats()
+        : stageSeconds(), meshSeconds(0.0), totalSeconds(0.0), zones(0), chunks(0)
+    {}
+};
+
+// Generates a square region of terrain zones without the game loop.
+// Unlike Terrain's incremental pipeline, every stage runs over the whole
+// region before the next one starts, so the stages can be timed on their
+// own. DECORATION is split into four passes by zone parity, as zones two
+// apart never write into the same Chunks.
+class BatchGenerator {
+private:
+    Terrain &m_terrain;
+    QThreadPool m_pool;
+
+    // Runs task once per zone on the pool and waits for all of them
+    double runPhase(const std::vector<int64_t> &zones, const std::function<void(int64_t)> &task);
+    void runStage(int64_t zone, GenerationStage stage);
+    // Read-only lookup that is safe to call from the pool's threads
+    Chunk* chunkAt(int x, int z) const;
+
+public:
+    BatchGenerator(Terrain &terrain, int threads);
+
+    // Generates every zone whose corner lies in [minZone, maxZone] (in
+    // world space, both corners included) through FLUIDS, and the ring of
+    // zones just outside it through SURFACE, as the inner zones'
+    // structures depend on it. If mesh is set the inner zones' VBO data
+    // is also computed (on the CPU only).
+    // Returns the zones that were completed.
+    std::vector<int64_t> generate(glm::ivec2 minZone, glm::ivec2 maxZone, bool mesh, BatchStats *stats);
+    // Same, for the zones within radius zones of centerZone
+    std::vector<int64_t> generate(glm::ivec2 centerZone, int radius, bool mesh, BatchStats *stats);
+};
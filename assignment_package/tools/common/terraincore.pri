@@ -0,0 +1,52 @@
+# The game's world generation code, without the window, camera or player.
+# Shared by the console tools; none of them create an OpenGL context, but
+# Chunk is a Drawable so the GL wrapper classes still have to be linked.
+QT += core gui widgets opengl openglwidgets
+
+CONFIG += c++1z
+
+SRC = $$PWD/../../src
+
+INCLUDEPATH += $$PWD/../../include $$SRC $$SRC/scene $$PWD
+DEPENDPATH += $$SRC $$SRC/scene $$PWD
+
+SOURCES += \
+    $$SRC/noise_functions.cpp \
+    $$SRC/drawable.cpp \
+    $$SRC/shaderprogram.cpp \
+    $$SRC/openglcontext.cpp \
+    $$SRC/scene/chunk.cpp \
+    $$SRC/scene/chunkworkers.cpp \
+    $$SRC/scene/chunkarena.cpp \
+    $$SRC/scene/chunkstore.cpp \
+    $$SRC/scene/collision.cpp \
+    $$SRC/scene/frustum.cpp \
+    $$SRC/scene/heightmapfile.cpp \
+    $$SRC/scene/heightmapimport.cpp \
+    $$SRC/scene/parallelfor.cpp \
+    $$SRC/scene/raycast.cpp \
+    $$SRC/scene/cube.cpp \
+    $$SRC/scene/terrain.cpp \
+    $$PWD/batchgenerator.cpp
+
+HEADERS += \
+    $$SRC/noise_functions.h \
+    $$SRC/drawable.h \
+    $$SRC/shaderprogram.h \
+    $$SRC/openglcontext.h \
+    $$SRC/smartpointerhelp.h \
+    $$SRC/glm_includes.h \
+    $$SRC/scene/chunkhelpers.h \
+    $$SRC/scene/chunk.h \
+    $$SRC/scene/chunkworkers.h \
+    $$SRC/scene/chunkarena.h \
+    $$SRC/scene/chunkstore.h \
+    $$SRC/scene/collision.h \
+    $$SRC/scene/frustum.h \
+    $$SRC/scene/heightmapfile.h \
+    $$SRC/scene/heightmapimport.h \
+    $$SRC/scene/parallelfor.h \
+    $$SRC/scene/raycast.h \
+    $$SRC/scene/cube.h \
+    $$SRC/scene/terrain.h \
+    $$PWD/batchgenerator.h
@@ -0,0 +1,170 @@
+#include "batchgenerator.h"
+#include "chunkstore.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QThread>
+#include <cstdio>
+#include <vector>
+
+// Checks that a Chunk's VBO data is well formed: whole faces of
+// (pos, nor, uv) vertices, positions inside the Chunk, axis-aligned unit
+// normals and indices that stay inside the vertex buffer
+static bool validateMesh(glm::ivec2 origin, const std::vector<glm::vec4> &vbo, const std::vector<GLuint> &idx) {
+    if (vbo.size() % 12 != 0 || idx.size() % 6 != 0 || idx.size() / 6 != vbo.size() / 12) {
+        return false;
+    }
+    for (size_t v = 0; v < vbo.size(); v += 3) {
+        glm::vec4 pos = vbo[v] - glm::vec4(origin.x, 0, origin.y, 0);
+        const glm::vec4 &nor = vbo[v + 1];
+        if (pos.x < 0.f || pos.x > 16.f || pos.y < 0.f || pos.y > 256.f ||
+                pos.z < 0.f || pos.z > 16.f || pos.w != 1.f) {
+            return false;
+        }
+        if (glm::abs(nor.x) + glm::abs(nor.y) + glm::abs(nor.z) != 1.f || nor.w != 0.f) {
+            return false;
+        }
+    }
+    GLuint vertexCount = vbo.size() / 3;
+    for (GLuint i : idx) {
+        if (i >= vertexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static QString formatDuration(double seconds) {
+    int s = static_cast<int>(seconds);
+    return QString("%1:%2:%3").arg(s / 3600).arg((s / 60) % 60, 2, 10, QChar('0')).arg(s % 60, 2, 10, QChar('0'));
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("pregen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates, validates and saves a region of the world ahead of time.\n"
+                                     "Zones that already exist in the world directory are skipped, so an\n"
+                                     "interrupted run can be resumed by running the same command again.");
+    parser.addHelpOption();
+    QCommandLineOption worldOption("world", "World directory to write the zones to.", "dir");
+    QCommandLineOption seedOption("seed", "World seed.", "seed", "0");
+    QCommandLineOption radiusOption("radius", "Generate the zones within <n> zones of the origin.", "n", "8");
+    QCommandLineOption rectOption("rect", "Generate the zones covering the block rectangle x0,z0,x1,z1 instead.",
+                                  "x0,z0,x1,z1");
+    QCommandLineOption threadsOption("threads", "Number of worker threads.", "n",
+                                     QString::number(QThread::idealThreadCount()));
+    QCommandLineOption tileOption("tile", "Generate <n> x <n> zones at a time.", "n", "8");
+    parser.addOptions({worldOption, seedOption, radiusOption, rectOption, threadsOption, tileOption});
+    parser.process(a);
+
+    if (!parser.isSet(worldOption)) {
+        fprintf(stderr, "pregen: --world is required\n");
+        parser.showHelp(1);
+    }
+    unsigned int seed = parser.value(seedOption).toUInt();
+    int threads = std::max(1, parser.value(threadsOption).toInt());
+    int tile = std::max(1, parser.value(tileOption).toInt());
+
+    // Zone corners covered, in world space
+    glm::ivec2 minZone, maxZone;
+    if (parser.isSet(rectOption)) {
+        QStringList r = parser.value(rectOption).split(',');
+        if (r.size() != 4) {
+            fprintf(stderr, "pregen: --rect takes x0,z0,x1,z1\n");
+            return 1;
+        }
+        glm::ivec2 p0(r[0].toInt(), r[1].toInt());
+        glm::ivec2 p1(r[2].toInt(), r[3].toInt());
+        minZone = glm::ivec2(64.f * glm::floor(glm::vec2(glm::min(p0, p1)) / 64.f));
+        maxZone = glm::ivec2(64.f * glm::floor(glm::vec2(glm::max(p0, p1)) / 64.f));
+    } else {
+        int radius = std::max(0, parser.value(radiusOption).toInt());
+        minZone = glm::ivec2(-64 * radius);
+        maxZone = glm::ivec2(64 * radius);
+    }
+
+    ChunkStore store(parser.value(worldOption), seed);
+    if (!store.ensureDirectory()) {
+        fprintf(stderr, "pregen: can't create %s\n", qPrintable(store.getDirectory()));
+        return 1;
+    }
+
+    int zonesX = (maxZone.x - minZone.x) / 64 + 1;
+    int zonesZ = (maxZone.y - minZone.y) / 64 + 1;
+    int totalZones = zonesX * zonesZ;
+    int doneZones = 0, generatedZones = 0, failedZones = 0;
+    printf("Seed %u, zones (%d, %d) to (%d, %d): %d zones, %d threads\n",
+           seed, minZone.x, minZone.y, maxZone.x, maxZone.y, totalZones, threads);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int tx = minZone.x; tx <= maxZone.x; tx += 64 * tile) {
+        for (int tz = minZone.y; tz <= maxZone.y; tz += 64 * tile) {
+            glm::ivec2 tileMin(tx, tz);
+            glm::ivec2 tileMax(std::min(tx + 64 * (tile - 1), maxZone.x), std::min(tz + 64 * (tile - 1), maxZone.y));
+            int tileZones = ((tileMax.x - tileMin.x) / 64 + 1) * ((tileMax.y - tileMin.y) / 64 + 1);
+
+            // Resume: skip tiles that were already written
+            bool complete = true;
+            for (int x = tileMin.x; x <= tileMax.x && complete; x += 64) {
+                for (int z = tileMin.y; z <= tileMax.y && complete; z += 64) {
+                    complete = store.hasZone(toKey(x, z));
+                }
+            }
+            if (complete) {
+                doneZones += tileZones;
+                continue;
+            }
+
+            // A fresh Terrain per tile keeps memory bounded
+            Terrain terrain(nullptr);
+            terrain.setSeed(seed);
+            BatchGenerator generator(terrain, threads);
+            std::vector<int64_t> zones = generator.generate(tileMin, tileMax, true, nullptr);
+
+            const Terrain &constTerrain = terrain;
+            for (int64_t zone : zones) {
+                doneZones++;
+                if (store.hasZone(zone)) {
+                    continue;
+                }
+                glm::ivec2 coord = toCoords(zone);
+                std::vector<const Chunk*> chunks;
+                bool valid = true;
+                for (int x = coord.x; x < coord.x + 64; x += 16) {
+                    for (int z = coord.y; z < coord.y + 64; z += 16) {
+                        const Chunk *c = constTerrain.getChunkAt(x, z).get();
+                        valid = valid && validateMesh(c->getPos(), c->m_vboData.m_vboDataOpaque, c->m_vboData.m_idxDataOpaque)
+                                      && validateMesh(c->getPos(), c->m_vboData.m_vboDataTransparent, c->m_vboData.m_idxDataTransparent);
+                        chunks.push_back(c);
+                    }
+                }
+                if (!valid) {
+                    fprintf(stderr, "pregen: zone (%d, %d) failed mesh validation, not saved\n", coord.x, coord.y);
+                    failedZones++;
+                } else if (!store.saveZone(zone, chunks)) {
+                    fprintf(stderr, "pregen: couldn't write zone (%d, %d)\n", coord.x, coord.y);
+                    failedZones++;
+                } else {
+                    generatedZones++;
+                }
+            }
+
+            double elapsed = timer.nsecsElapsed() * 1e-9;
+            double rate = generatedZones / elapsed;
+            double eta = rate > 0.0 ? (totalZones - doneZones) / rate : 0.0;
+            printf("[%6d/%d zones] %5.1f%%  %.2f zones/s  elapsed %s  ETA %s\n",
+                   doneZones, totalZones, 100.0 * doneZones / totalZones, rate,
+                   qPrintable(formatDuration(elapsed)), qPrintable(formatDuration(eta)));
+            fflush(stdout);
+        }
+    }
+
+    printf("Done: %d zones generated, %d already present, %d failed in %s\n",
+           generatedZones, totalZones - generatedZones - failedZones, failedZones,
+           qPrintable(formatDuration(timer.nsecsElapsed() * 1e-9)));
+    return failedZones == 0 ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+# Offline world pregeneration. Build with
+#   qmake tools/pregen/pregen.pro && make
+# and run `pregen --help` for its options. Start the game with
+# `--world <dir> --seed <seed>` to stream the result from disk.
+TARGET = pregen
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += release
+
+include(../common/terraincore.pri)
+
+SOURCES += \
+    $$PWD/main.cpp
@@ -0,0 +1,185 @@
+#include "batchgenerator.h"
+#include "collision.h"
+#include "noise_functions.h"
+#include "raycast.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QThread>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+// Times f over a fixed grid of sample points and returns the nanoseconds
+// spent per sample. The results are summed into sink so the calls can't
+// be optimized away.
+static double timeNoise(const std::function<float(vec2)> &f, const std::vector<vec2> &points, float *sink) {
+    QElapsedTimer timer;
+    timer.start();
+    float sum = 0.f;
+    for (const vec2 &p : points) {
+        sum += f(p);
+    }
+    double ns = static_cast<double>(timer.nsecsElapsed()) / points.size();
+    *sink += sum;
+    return ns;
+}
+
+static void benchmarkNoise(unsigned int seed, int samples) {
+    // Spread the samples over world space the way Chunk samples it
+    std::vector<vec2> points;
+    points.reserve(samples);
+    vec2 origin(seedOffset(seed));
+    for (int i = 0; i < samples; i++) {
+        points.push_back(origin + vec2(i % 1024, i / 1024) * 3.f);
+    }
+
+    struct NoiseFunction {
+        const char *name;
+        std::function<float(vec2)> f;
+    };
+    std::vector<NoiseFunction> functions = {
+        {"random1", [](vec2 p) { return random1(p); }},
+        {"perlinNoise(vec2)", [](vec2 p) { return perlinNoise(p / 10.f); }},
+        {"perlinNoise(vec3)", [](vec2 p) { return perlinNoise(vec3(p.x, 64.f, p.y) / 10.f); }},
+        // Runtime octave counts next to the compile-time kernels
+        {"fbm(3)", [](vec2 p) { return fbm(p / 128.f, 3); }},
+        {"fbm<3>", [](vec2 p) { return fbm<3>(p / 128.f); }},
+        {"fractalPerlin(8)", [](vec2 p) { return fractalPerlin(p / 256.f, 8); }},
+        {"fractalPerlin<8>", [](vec2 p) { return fractalPerlin<8>(p / 256.f); }},
+        {"mountainSummedPerlin(6)", [](vec2 p) { return mountainSummedPerlin(p / 128.f, 6); }},
+        {"mountainSummedPerlin<6>", [](vec2 p) { return mountainSummedPerlin<6>(p / 128.f); }},
+        {"elevationValue", [](vec2 p) { return elevationValue(p / 128.f); }},
+        {"grasslandValue", [](vec2 p) { return grasslandValue(p); }},
+        {"mountainValue", [](vec2 p) { return mountainValue(p); }},
+        {"moisture", [](vec2 p) { return moisture(p / 1000.f); }},
+    };
+
+    float sink = 0.f;
+    printf("\nNoise functions (%d samples each)\n", samples);
+    for (const NoiseFunction &nf : functions) {
+        printf("  %-26s %10.1f ns/sample\n", nf.name, timeNoise(nf.f, points, &sink));
+    }
+    printf("  (checksum %g)\n", sink);
+}
+
+// Casts count rays of the given length in random directions from eye
+// height above random columns of the generated zones, the way block
+// picking and line of sight checks would, and reports the time per ray
+static void benchmarkRaycasts(const Terrain &terrain, int radius, int count, float length) {
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    std::mt19937 rng(1);
+    // Zone corners span [-radius, radius] zones of 64 blocks
+    std::uniform_real_distribution<float> coord(-64.f * radius, 64.f * (radius + 1));
+    std::normal_distribution<float> axis;
+    while (static_cast<int>(rays.size()) < count) {
+        glm::vec3 origin(coord(rng), 0.f, coord(rng));
+        glm::vec3 direction(axis(rng), axis(rng), axis(rng));
+        // Stand on the highest block of the column
+        int y = 255;
+        while (y >= 0 && !blocksMovement(terrain.tryGetBlockAt(glm::vec3(origin.x, y, origin.z)))) {
+            y--;
+        }
+        if (y < 0 || direction == glm::vec3(0.f)) {
+            continue;
+        }
+        origin.y = y + 2.6f;
+        rays.push_back(Ray(origin, direction, length));
+    }
+
+    std::vector<RayHit> hits;
+    QElapsedTimer timer;
+    timer.start();
+    raycastBatch(rays, terrain, &hits);
+    double ns = static_cast<double>(timer.nsecsElapsed()) / count;
+
+    int hit = 0, unloaded = 0;
+    for (const RayHit &h : hits) {
+        hit += h.hit;
+        unloaded += h.unloaded;
+    }
+    printf("\nRaycasts (%d rays of %g blocks)\n", count, length);
+    printf("  %10.1f ns/ray, %d hit, %d reached unloaded terrain\n", ns, hit, unloaded);
+}
+
+// FNV-1a over every block of the completed zones, so runs with the same
+// seed can be checked for identical output
+static unsigned long long worldChecksum(const Terrain &terrain, const std::vector<int64_t> &zones) {
+    unsigned long long h = 14695981039346656037ull;
+    for (int64_t zone : zones) {
+        glm::ivec2 coord = toCoords(zone);
+        for (int x = coord.x; x < coord.x + 64; x += 16) {
+            for (int z = coord.y; z < coord.y + 64; z += 16) {
+                const Chunk &c = *terrain.getChunkAt(x, z);
+                for (int k = 0; k < 16; k++) {
+                    for (int y = 0; y < 256; y++) {
+                        for (int i = 0; i < 16; i++) {
+                            h ^= static_cast<unsigned long long>(c.getBlockAt(i, y, k));
+                            h *= 1099511628211ull;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return h;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("terrainbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures terrain generation throughput without a window or GL context.");
+    parser.addHelpOption();
+    QCommandLineOption radiusOption("radius", "Generate the zones within <n> zones of the origin.", "n", "2");
+    QCommandLineOption threadsOption("threads", "Number of worker threads.", "n",
+                                     QString::number(QThread::idealThreadCount()));
+    QCommandLineOption seedOption("seed", "World seed.", "seed", "0");
+    QCommandLineOption samplesOption("noise-samples", "Samples per noise function, 0 to skip.", "n", "262144");
+    QCommandLineOption noMeshOption("no-mesh", "Skip computing the Chunks' VBO data.");
+    QCommandLineOption raysOption("rays", "Number of rays to cast through the generated zones, 0 to skip.", "n", "100000");
+    QCommandLineOption rayLengthOption("ray-length", "Length of each ray in blocks.", "blocks", "128");
+    parser.addOptions({radiusOption, threadsOption, seedOption, samplesOption, noMeshOption, raysOption, rayLengthOption});
+    parser.process(a);
+
+    int radius = std::max(0, parser.value(radiusOption).toInt());
+    int threads = std::max(1, parser.value(threadsOption).toInt());
+    unsigned int seed = parser.value(seedOption).toUInt();
+    int samples = std::max(0, parser.value(samplesOption).toInt());
+    bool mesh = !parser.isSet(noMeshOption);
+    int rays = std::max(0, parser.value(raysOption).toInt());
+    float rayLength = std::max(0.f, parser.value(rayLengthOption).toFloat());
+
+    // No GL context: Chunks are only given block and VBO data,
+    // nothing is ever sent to the GPU
+    Terrain terrain(nullptr);
+    terrain.setSeed(seed);
+    BatchGenerator generator(terrain, threads);
+    BatchStats stats;
+    std::vector<int64_t> zones = generator.generate(glm::ivec2(0, 0), radius, mesh, &stats);
+
+    printf("Seed %u, radius %d, %d threads\n", seed, radius, threads);
+    printf("Generated %d zones (%d chunks) in %.3f s: %.1f chunks/s\n",
+           stats.zones, stats.chunks, stats.totalSeconds, stats.chunks / stats.totalSeconds);
+    printf("\nStage timings (wall clock)\n");
+    const char *stageNames[] = {"", "heightfield", "caves", "surface", "decoration", "fluids"};
+    for (int stage = HEIGHTFIELD; stage <= FLUIDS; stage++) {
+        printf("  %-12s %9.3f s\n", stageNames[stage], stats.stageSeconds[stage]);
+    }
+    if (mesh) {
+        printf("  %-12s %9.3f s\n", "mesh", stats.meshSeconds);
+    }
+    printf("World checksum %016llx\n", worldChecksum(terrain, zones));
+
+    if (rays > 0) {
+        benchmarkRaycasts(terrain, radius, rays, rayLength);
+    }
+    if (samples > 0) {
+        benchmarkNoise(seed, samples);
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+# Headless terrain generation benchmark. Build with
+#   qmake tools/terrainbench/terrainbench.pro && make
+# and run `terrainbench --help` for its options.
+TARGET = terrainbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += release
+
+include(../common/terraincore.pri)
+
+SOURCES += \
+    $$PWD/main.cpp